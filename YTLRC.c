@@ -30,6 +30,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <limits.h>
+#ifdef _MSC_VER
+#include <intrin.h> // _BitScanForward
+#endif
 #include "cm256.h"
 #include "YTLRC.h"
 
@@ -41,19 +45,34 @@ typedef struct
 
     unsigned short numShards;
     CM256Block blocks[MAXSHARDS];
-    short horMissed[MAXSHARDS / MAXHORCOUNT]; // number of missed shards in each horizonal local groups of original data, ignore missed recovery shard(s)
-    short verMissed[MAXHORCOUNT];             // number of missed shards in each vertical local groups of original data, ignore missed recovery shard(s)
+    uint64_t existed[MAXSHARDS / 64];             // bit of each block that is collected or recovered, its pData is only valid then
+    uint64_t globalRows[MAXSHARDS / 64];          // bit of each block that the global decode may take as a recovery shard
+    uint64_t wanted[MAXSHARDS / 64];              // bit of each original shard wanted by a partial decode
+    uint32_t horExisted[MAXSHARDS / MAXHORCOUNT]; // bit x of horizonal local group y, the original shards collected or recovered
+    uint32_t verExisted[MAXHORCOUNT];             // bit y of vertical local group x, the original shards collected or recovered
+    uint32_t horFull[MAXSHARDS / MAXHORCOUNT];    // bits of the original shards in each horizonal local group, ignore padding
+    uint32_t verFull[MAXHORCOUNT];                // bits of the original shards in each vertical local group, ignore padding
     short globalMissed;                       // number of missed shards of original data, ignore missed recovery shard(s)
     short numGlobalRecovery;
     short totalGlobalRecovery; // count in global recovery shard from horizonal recovery shards and vertical recovery shards
     short numHorRecovery, numVerRecovery;
-
-    uint8_t *pBuffer; // Buffer for at most 4 shards: one for repair global recovery shard,
+    short numThreads; // Most threads for the global decode
+    bool bPartial;              // Only the wanted original shards are decoded
+    bool bWanted[MAXSHARDS];    // Original shards wanted by a partial decode
+    bool bBorrow;               // Original shards are left where LRC_Decode got them
+    uint8_t **pOutputs;         // Buffer of each original shard instead of pDecodedData, NULL if not given
+    short numSpare;             // Blocks of pDecodedData taken by originals without a buffer in pOutputs
+    uint8_t *pAccumulated;      // Progressive decode: copy of each global recovery shard, with the originals folded in
+    bool bFolding[MAXSHARDS];     // Copies that the originals are folded into, by order of global recovery shard
+    bool bAccumulated[MAXSHARDS]; // Copies that also hold their global recovery shard, ready for decoding
+    bool bEliminated[MAXSHARDS];  // Original shards folded into every copy that is folding
+
+    uint8_t *pBuffer; // Buffer for at most 3 shards: one for repair global recovery shard,
                       // one for additional global recovery shard from horizonal recovery shards,
-                      // one for additional global recovery shard from vertical recovery shard,
-                      // one for zero shard
+                      // one for additional global recovery shard from vertical recovery shard
 } DecoderLRC;
-#define SHARD_EXISTED(pDecoder, index) (NULL != pDecoder->blocks[index].pData)
+#define SHARD_EXISTED(pDecoder, index) (0 != (((pDecoder)->existed[(index) >> 6] >> ((index) & 63)) & 1))
+#define ONE_BIT(bits) (0 != (bits) && 0 == ((bits) & ((bits) - 1)))
 #define DECODE_MAGIC 0x59541224
 
 static short globalRecoveryCount = 10;
@@ -70,42 +89,274 @@ static inline uint8_t *GlobalFromVerBuf(DecoderLRC *pDecoder)
 {
     return pDecoder->pBuffer + 2 * (pDecoder->param.BlockBytes + 1);
 }
-static inline uint8_t *ZeroBuf(DecoderLRC *pDecoder)
+
+/*
+ * Number of original shards in a local group. Padding positions [OriginalCount, TotalOriginalCount)
+ * are zeros that are never stored or read, they are always the tail of the last horizonal group
+ * and of some vertical groups.
+ */
+static inline short HorGroupCount(const CM256LRC *pParam, short y)
+{
+    short n = pParam->OriginalCount - y * pParam->HorLocalCount;
+    return n < pParam->HorLocalCount ? n : pParam->HorLocalCount;
+}
+static inline short VerGroupCount(const CM256LRC *pParam, short x)
+{
+    return (pParam->OriginalCount - x + pParam->HorLocalCount - 1) / pParam->HorLocalCount;
+}
+
+/* Position of the lowest set bit, bits must not be zero */
+static inline short LowestBit(uint64_t bits)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    if (_BitScanForward(&i, (unsigned long)bits))
+        return (short)i;
+    _BitScanForward(&i, (unsigned long)(bits >> 32));
+    return (short)(i + 32);
+#else
+    return (short)__builtin_ctzll(bits);
+#endif
+}
+
+static inline short BitCount(uint32_t bits)
+{
+#ifdef _MSC_VER
+    return (short)__popcnt(bits);
+#else
+    return (short)__builtin_popcount(bits);
+#endif
+}
+
+/* Bits [first, last] of a block bitmap */
+static void SetBitRange(uint64_t *bits, short first, short last)
+{
+    for (; first <= last && first < MAXSHARDS; first++)
+        bits[first >> 6] |= (uint64_t)1 << (first & 63);
+}
+
+/* Block index is collected or recovered with its data at pData */
+static inline void SetShard(DecoderLRC *pDecoder, short index, uint8_t *pData)
+{
+    pDecoder->blocks[index].pData = pData;
+    pDecoder->existed[index >> 6] |= (uint64_t)1 << (index & 63);
+    if (index < pDecoder->param.OriginalCount)
+    {
+        short y = index / pDecoder->param.HorLocalCount;
+        short x = index % pDecoder->param.HorLocalCount;
+        pDecoder->horExisted[y] |= (uint32_t)1 << x;
+        pDecoder->verExisted[x] |= (uint32_t)1 << y;
+    }
+}
+
+/* Block index is missing again */
+static inline void ClearShard(DecoderLRC *pDecoder, short index)
+{
+    pDecoder->blocks[index].pData = NULL;
+    pDecoder->existed[index >> 6] &= ~((uint64_t)1 << (index & 63));
+    if (index < pDecoder->param.OriginalCount)
+    {
+        short y = index / pDecoder->param.HorLocalCount;
+        short x = index % pDecoder->param.HorLocalCount;
+        pDecoder->horExisted[y] &= ~((uint32_t)1 << x);
+        pDecoder->verExisted[x] &= ~((uint32_t)1 << y);
+    }
+}
+
+/*
+ * Where original shard i is decoded to. An original not wanted by a partial decode may have no buffer in
+ * pOutputs, it is only recovered by its local group for decoding others, and takes the next block of
+ * pDecodedData then. Each local group recovers one shard at most, HorLocalCount + VerLocalCount blocks in all
+ */
+static inline uint8_t *OutputBuf(DecoderLRC *pDecoder, short i)
+{
+    if (NULL == pDecoder->pOutputs)
+        return pDecoder->pDecodedData + i * pDecoder->param.BlockBytes;
+    if (NULL != pDecoder->pOutputs[i])
+        return pDecoder->pOutputs[i];
+    return pDecoder->pDecodedData + pDecoder->numSpare++ * pDecoder->param.BlockBytes;
+}
+
+/* Whether original shard i is only read where LRC_Decode got it, instead of being copied to its output */
+static inline bool BorrowShard(DecoderLRC *pDecoder, short i)
+{
+    return pDecoder->bBorrow || (pDecoder->bPartial && !pDecoder->bWanted[i]);
+}
+
+static inline uint8_t *AccumulatedBuf(DecoderLRC *pDecoder, short g)
+{
+    return pDecoder->pAccumulated + g * pDecoder->param.BlockBytes;
+}
+
+static inline cm256_encoder_params GlobalParams(const CM256LRC *pParam, short recoveryCount)
+{
+    cm256_encoder_params params;
+    params.BlockBytes = pParam->BlockBytes;
+    params.TotalOriginalCount = pParam->TotalOriginalCount;
+    params.FirstElement = 0;
+    params.OriginalCount = pParam->OriginalCount;
+    params.RecoveryCount = recoveryCount;
+    params.Step = 1;
+    return params;
+}
+
+/* Progressive decode: fold a collected or recovered original shard into the copies of global recovery shards */
+static void EliminateOriginal(DecoderLRC *pDecoder, short i)
 {
-    return pDecoder->pBuffer + 3 * (pDecoder->param.BlockBytes + 1);
+    short g, count = 0;
+    CM256LRC *pParam = &pDecoder->param;
+    CM256Block copies[MAXSHARDS];
+    CM256Block *rows[MAXSHARDS];
+    const CM256Block *pOriginal = &pDecoder->blocks[i];
+
+    if (NULL == pDecoder->pAccumulated || pDecoder->bEliminated[i])
+        return;
+    for (g = 0; g < pParam->GlobalRecoveryCount; g++)
+    {
+        if (!pDecoder->bFolding[g])
+            continue;
+        copies[count].pData = AccumulatedBuf(pDecoder, g);
+        copies[count].decodeIndex = GLOBAL_DECODE_INDEX(pParam, g);
+        rows[count] = &copies[count];
+        count++;
+    }
+
+    cm256_encoder_params params = GlobalParams(pParam, count);
+    cm256_eliminate(&params, rows, count, &pOriginal, 1);
+    pDecoder->bEliminated[i] = true;
+}
+
+/* Progressive decode: add an arrived global recovery shard to its copy, folding the originals so far into a new copy */
+static void AccumulateGlobal(DecoderLRC *pDecoder, short g, const uint8_t *pData)
+{
+    short i, count = 0;
+    CM256LRC *pParam = &pDecoder->param;
+    CM256Block copy;
+    CM256Block *pCopy = &copy;
+    const CM256Block *originals[MAXSHARDS];
+
+    if (NULL == pDecoder->pAccumulated)
+        return;
+    copy.pData = AccumulatedBuf(pDecoder, g);
+    copy.decodeIndex = GLOBAL_DECODE_INDEX(pParam, g);
+    if (pDecoder->bFolding[g])
+        gf256_add_mem(copy.pData, pData, pParam->BlockBytes);
+    else
+    {
+        for (i = 0; i < pParam->OriginalCount; i++)
+        {
+            if (pDecoder->bEliminated[i])
+                originals[count++] = &pDecoder->blocks[i];
+        }
+        memcpy(copy.pData, pData, pParam->BlockBytes);
+        cm256_encoder_params params = GlobalParams(pParam, 1);
+        cm256_eliminate(&params, &pCopy, 1, originals, count);
+        pDecoder->bFolding[g] = true;
+    }
+    pDecoder->bAccumulated[g] = true;
 }
 
+typedef enum
+{
+    UNKNOWN,
+    EXISTED,
+    LOST,
+    REQUEST
+} ShardStatus;
+
+typedef enum
+{
+    INIT_REBUILD,
+    HOR_REBUILD,
+    VER_REBUILD,
+    HOR_RECOVERY_REBUILD,
+    VER_RECOVERY_REBUILD,
+    GLOBAL_RECOVERY_REBUILD,
+    GLOBAL_REBUILD,
+    DONE_REBUILD,   // Rebuilt from the shards at hand, one of them is requested again to report it
+    HEDGED_REBUILD  // Local stages requested at once, the first one complete rebuilds
+} RebuildStage;
+
+/* Shards at hand for planning the global decode, originals by local groups as horExisted and verExisted of decoder */
+typedef struct
+{
+    uint32_t hor[32];
+    uint32_t ver[8];
+    bool recovery[MAXSHARDS]; // By recoveryIndex
+} ShardSet;
+
 typedef struct
 {
     unsigned long magic;
     short iLost;
     CM256LRC param;
     uint8_t *pRepairedData;
-    enum
-    {
-        INIT_REBUILD,
-        HOR_REBUILD,
-        VER_REBUILD,
-        HOR_RECOVERY_REBUILD,
-        VER_RECOVERY_REBUILD,
-        GLOBAL_RECOVERY_REBUILD,
-        GLOBAL_REBUILD
-    } stage;
-    enum
-    {
-        UNKNOWN,
-        EXISTED,
-        LOST,
-        REQUEST
-    } shardStatus[MAXSHARDS];
+    RebuildStage stage;
+    ShardStatus shardStatus[MAXSHARDS];
     short remainShards;               // Used for HOR_REBUILD, VER_REBUILD, HOR_RECOVERY_REBUILD,  VER_RECOVERY_REBUILD, GLOBAL_RECOVERY_REBUILD
     short numShards;                  // Number of existing shards
     const uint8_t *shards[MAXSHARDS]; // Existing shards
-    DecoderLRC *pDecoder;             // Used for GLOBAL_REBUILD
-    uint8_t *pDecodedData;            // Used for GLOBAL_REBUILD
+    ShardSet have;                    // Existing shards by local groups, for GLOBAL_REBUILD
+    short numOriginalsAtHand;         // Existing original shards
+    short numRecoveryAtHand;          // Existing recovery shards
+    uint32_t wanted[32];              // Originals the lost shard depends on, by horizonal groups
+    bool bCosts;                      // Request the cheapest shards by costs instead of the stages in fixed order
+    unsigned short costs[MAXSHARDS];  // Cost of fetching each shard, LRC_COST_UNAVAILABLE if it can not be fetched
+    uint8_t triedStages;              // Bit of each stage begun
+    bool bHedged;                     // Request the local stages at once and spare shards for the global decode
+    short numSpare;                   // Spare shards beyond the cheapest enough ones for the global decode
+    short numHedged;                  // Used for HEDGED_REBUILD, number of local stages requested
+    RebuildStage hedgedStages[2];     // Used for HEDGED_REBUILD, local stages requested
+    short hedgedRemain[2];            // Used for HEDGED_REBUILD, shards each local stage still waits for
+    uint8_t hedgedOf[MAXSHARDS];      // Used for HEDGED_REBUILD, bit of each local stage a shard belongs to
 } Rebuilder;
 #define REBUILD_MAGIC 0x59542019
 
+typedef struct
+{
+    unsigned long magic;
+    CM256LRC param;
+    ShardStatus shardStatus[MAXSHARDS];
+    const uint8_t *shards[MAXSHARDS]; // Collected shard of each order with index byte, NULL if not collected
+    uint8_t *pRepaired[MAXSHARDS];    // Buffer of each lost shard by order, NULL if it is not to rebuild
+    bool bRebuilt[MAXSHARDS];         // Lost shards already rebuilt
+    bool bFed[MAXSHARDS];             // Shards given to the global decode
+    short numLost, numRebuilt;
+    unsigned char lost[MAXSHARDS];    // Orders of lost shards
+    short numPlan;
+    unsigned char plan[MAXSHARDS];    // Lost shards rebuilt by local groups, each after the lost shards it is rebuilt from
+    bool bVer[MAXSHARDS];             // Lost original shard of the plan is rebuilt by vertical local group
+    DecoderLRC *pDecoder;             // Global decode of the lost shards that local groups do not rebuild, NULL before
+    uint8_t *pDecodedData;            // Used by pDecoder
+} MultiRebuilder;
+#define MULTI_REBUILD_MAGIC 0x59540522
+
+typedef struct
+{
+    unsigned long magic;
+    CM256EncodePlan plan;
+} EncodePlanLRC;
+#define ENCODE_PLAN_MAGIC 0x59540128
+
+typedef struct
+{
+    unsigned long magic;
+    CM256EncodePlan plan;
+    uint8_t *pRecoveryData;
+    int blockBytes;
+    short numShards;        // Number of original shards folded in
+    bool bAdded[MAXSHARDS]; // Original shards folded in
+} EncoderLRC;
+#define ENCODE_MAGIC 0x59540310
+
+typedef struct
+{
+    const CM256EncodePlan *pPlan;
+    const void **const *originalShards;
+    void *const *pRecoveryData;
+    int blockBytes;
+} EncodeBatch; // Stripes of a batch encode, shared by worker threads
+
 extern void InitialParam(CM256LRC *pParam, unsigned short originalCount, unsigned shardSize, bool bIndexByte);
 /*
  * Initialize
@@ -134,32 +385,240 @@ extern short LRC_Initial(short n)
  * return: number of recovery shards, <=0 fails
  */
 extern short LRC_Encode(const void *originalShards[], unsigned short originalCount, unsigned long shardSize, void *pRecoveryData)
+{
+    return LRC_EncodeParallel(originalShards, originalCount, shardSize, pRecoveryData, 1);
+}
+
+/*
+ * Encode original data with up to numThreads threads, output is the same as LRC_Encode
+ * numThreads: number of threads including the calling one, each one encodes a disjoint byte range of all shards
+ * return: number of recovery shards, <=0 fails
+ */
+extern short LRC_EncodeParallel(const void *originalShards[], unsigned short originalCount, unsigned long shardSize, void *pRecoveryData, short numThreads)
 {
     CM256LRC param;
+    CM256EncodePlan plan;
     CM256Block blocks[MAXSHARDS];
     short i;
-    uint8_t *pZeroData = NULL;
 
     if (NULL == originalShards || originalCount <= 0 || originalCount > 230 || shardSize <= 1 || NULL == pRecoveryData)
         return -1;
     InitialParam(&param, originalCount, shardSize, true);
+    if (cm256_plan_init(&plan, &param) != 0)
+        return -3;
     for (i = 0; i < originalCount; i++)
+        blocks[i].pData = (uint8_t *)originalShards[i] + 1; // Ignore the index byte, padding shards are not read by encoder
+
+    int ret = cm256_encode_plan_parallel(&plan, blocks, param.BlockBytes, pRecoveryData, numThreads);
+
+    return ret == 0 ? param.TotalRecoveryCount : -3;
+}
+
+/* Encode stripes [first, first + count) of a batch */
+static void EncodeBatchStripes(void *context, int first, int count)
+{
+    const EncodeBatch *pBatch = context;
+    CM256Block blocks[MAXSHARDS];
+    int i, j;
+
+    for (j = first; j < first + count; j++)
+    {
+        for (i = 0; i < pBatch->pPlan->Param.OriginalCount; i++)
+            blocks[i].pData = (uint8_t *)pBatch->originalShards[j][i] + 1; // Ignore the index byte
+        cm256_encode_plan(pBatch->pPlan, blocks, pBatch->blockBytes, pBatch->pRecoveryData[j]);
+    }
+}
+
+/*
+ * Encode a batch of stripes with the same originalCount and shardSize, output of each stripe is the same as LRC_Encode
+ * originalShards: stripeCount arrays of originalCount shards
+ * pRecoveryData: stripeCount buffers for recovery shards of each stripe, each one as in LRC_Encode
+ * numThreads: number of threads including the calling one, each one encodes a disjoint set of stripes
+ * return: number of recovery shards of each stripe, <=0 fails
+ */
+extern short LRC_EncodeBatch(const void **originalShards[], unsigned short stripeCount, unsigned short originalCount, unsigned long shardSize, void *pRecoveryData[], short numThreads)
+{
+    CM256LRC param;
+    CM256EncodePlan plan;
+    EncodeBatch batch;
+    short i, j;
+
+    if (NULL == originalShards || NULL == pRecoveryData || originalCount <= 0 || originalCount > 230 || shardSize <= 1)
+        return -1;
+    for (j = 0; j < stripeCount; j++)
+    {
+        if (NULL == originalShards[j] || NULL == pRecoveryData[j])
+            return -1;
+        for (i = 0; i < originalCount; i++)
+            if (NULL == originalShards[j][i])
+                return -1;
+    }
+    InitialParam(&param, originalCount, shardSize, true);
+    if (cm256_plan_init(&plan, &param) != 0)
+        return -3;
+
+    /* One plan for all stripes, worker threads take runs of whole stripes */
+    batch.pPlan = &plan;
+    batch.originalShards = originalShards;
+    batch.pRecoveryData = pRecoveryData;
+    batch.blockBytes = param.BlockBytes;
+    cm256_parallel_slices(EncodeBatchStripes, &batch, stripeCount, (CM256_MIN_THREAD_BYTES + param.BlockBytes - 1) / param.BlockBytes, 1, numThreads);
+
+    return param.TotalRecoveryCount;
+}
+
+/*
+ * Build an encode plan for stripes of originalCount shards
+ * originalCount: number of shards of original data
+ * return: handle of the plan, NULL fails. Free it by LRC_FreeHandle
+ */
+extern void *LRC_CreateEncodePlan(unsigned short originalCount)
+{
+    CM256LRC param;
+
+    if (originalCount <= 0 || originalCount > 230)
+        return NULL;
+    InitialParam(&param, originalCount, 2, true); // BlockBytes is given to each encode
+
+    EncodePlanLRC *pPlan = malloc(sizeof(EncodePlanLRC));
+    if (NULL == pPlan)
+        return NULL;
+    if (cm256_plan_init(&pPlan->plan, &param) != 0)
+    {
+        free(pPlan);
+        return NULL;
+    }
+    pPlan->magic = ENCODE_PLAN_MAGIC;
+
+    return pPlan;
+}
+
+/*
+ * Encode original data with a plan, output is the same as LRC_Encode
+ * hPlan: handle from LRC_CreateEncodePlan
+ * originalShards: the originalCount shards of the plan, 1st byte of each shard is its index
+ * shardSize: size of each shard
+ * pRecoveryData: required at least MAXRECOVERYSHARDS*shardSize space, return recovery shards after encoding
+ * return: number of recovery shards, <=0 fails
+ */
+extern short LRC_EncodeWithPlan(const void *hPlan, const void *originalShards[], unsigned long shardSize, void *pRecoveryData)
+{
+    return LRC_EncodeWithPlanParallel(hPlan, originalShards, shardSize, pRecoveryData, 1);
+}
+
+/*
+ * Encode original data with a plan and up to numThreads threads, output is the same as LRC_Encode
+ * return: number of recovery shards, <=0 fails
+ */
+extern short LRC_EncodeWithPlanParallel(const void *hPlan, const void *originalShards[], unsigned long shardSize, void *pRecoveryData, short numThreads)
+{
+    const EncodePlanLRC *pPlan = hPlan;
+    CM256Block blocks[MAXSHARDS];
+    short i;
+
+    if (NULL == pPlan || ENCODE_PLAN_MAGIC != pPlan->magic)
+        return -1;
+    if (NULL == originalShards || shardSize <= 1 || NULL == pRecoveryData)
+        return -1;
+    for (i = 0; i < pPlan->plan.Param.OriginalCount; i++)
         blocks[i].pData = (uint8_t *)originalShards[i] + 1; // Ignore the index byte
-    pZeroData = malloc(shardSize - 1 + 8);
-    if (NULL == pZeroData)
-        return -2;
-    memset(pZeroData, 0, shardSize - 1);
-    for (i = originalCount; i < param.TotalOriginalCount; i++)
+
+    int ret = cm256_encode_plan_parallel(&pPlan->plan, blocks, shardSize - 1, pRecoveryData, numThreads);
+
+    return ret == 0 ? pPlan->plan.Param.TotalRecoveryCount : -3;
+}
+
+/*
+ * Begin of new incremental encode process
+ * originalCount: number of shards of original data
+ * shardSize: size of each shard in byte including index byte
+ * pRecoveryData: required at least MAXRECOVERYSHARDS*shardSize space, return recovery shards when all original shards are encoded
+ * return: handle of this encode process, NULL fails
+ */
+extern void *LRC_BeginEncode(unsigned short originalCount, unsigned long shardSize, void *pRecoveryData)
+{
+    CM256LRC param;
+
+    if (originalCount <= 0 || originalCount > 230 || shardSize <= 1 || NULL == pRecoveryData)
+        return NULL;
+    InitialParam(&param, originalCount, shardSize, true);
+
+    EncoderLRC *pEncoder = malloc(sizeof(EncoderLRC));
+    if (NULL == pEncoder)
+        return NULL;
+    if (cm256_plan_init(&pEncoder->plan, &param) != 0 || cm256_encode_plan_begin(&pEncoder->plan, param.BlockBytes, pRecoveryData) != 0)
     {
-        blocks[i].pData = pZeroData;
-        blocks[i].lrcIndex = i;
-        blocks[i].decodeIndex = i;
+        free(pEncoder);
+        return NULL;
     }
+    pEncoder->magic = ENCODE_MAGIC;
+    pEncoder->pRecoveryData = pRecoveryData;
+    pEncoder->blockBytes = param.BlockBytes;
+    pEncoder->numShards = 0;
+    memset(pEncoder->bAdded, false, sizeof(pEncoder->bAdded));
 
-    int ret = cm256_encode(param, blocks, pRecoveryData);
+    return pEncoder;
+}
 
-    free(pZeroData);
-    return ret == 0 ? param.TotalRecoveryCount : -3;
+/*
+ * Encode one original shard for specific encode process. It is folded into all recovery shards at once,
+ * so the shard buffer can be released or reused as soon as this function returns
+ * handle: handle of encode process
+ * pShard: data of this shard, 1st byte is its index
+ * return: 0 if more original shards are required, >0 number of recovery shards when all original shards are encoded, <0 error
+ */
+extern short LRC_OneShardForEncode(void *handle, const void *pShard)
+{
+    if (NULL == handle || NULL == pShard)
+        return -1;
+    EncoderLRC *pEncoder = handle;
+    if (ENCODE_MAGIC != pEncoder->magic)
+        return -1;
+
+    const CM256LRC *pParam = &pEncoder->plan.Param;
+    const uint8_t *pData = pShard;
+    uint8_t index = pData[0];
+    if (index >= pParam->OriginalCount)
+        return -2;
+    if (pEncoder->bAdded[index])
+        return pEncoder->numShards < pParam->OriginalCount ? 0 : pParam->TotalRecoveryCount; // Already encoded
+
+    if (cm256_encode_plan_add(&pEncoder->plan, index, pData + 1, pEncoder->blockBytes, pEncoder->pRecoveryData) != 0)
+        return -3;
+    pEncoder->bAdded[index] = true;
+    pEncoder->numShards++;
+
+    return pEncoder->numShards < pParam->OriginalCount ? 0 : pParam->TotalRecoveryCount;
+}
+
+/*
+ * Update recovery shards in place after one original shard is rewritten
+ * originalCount: number of shards of original data
+ * shardSize: size of each shard
+ * pOldShard: old content of the shard, 1st byte is its index
+ * pNewShard: new content of the shard, 1st byte is its index
+ * pRecoveryData: recovery shards of the stripe from LRC_Encode, updated in place
+ * return: number of recovery shards, <=0 fails
+ */
+extern short LRC_UpdateParity(unsigned short originalCount, unsigned long shardSize, const void *pOldShard, const void *pNewShard, void *pRecoveryData)
+{
+    CM256LRC param;
+    CM256EncodePlan plan;
+
+    if (originalCount <= 0 || originalCount > 230 || shardSize <= 1 || NULL == pOldShard || NULL == pNewShard || NULL == pRecoveryData)
+        return -1;
+    const uint8_t *pOld = pOldShard;
+    const uint8_t *pNew = pNewShard;
+    if (pOld[0] != pNew[0] || pOld[0] >= originalCount)
+        return -2;
+    InitialParam(&param, originalCount, shardSize, true);
+    if (cm256_plan_init(&plan, &param) != 0)
+        return -3;
+
+    if (cm256_encode_plan_update(&plan, pOld[0], pOld + 1, pNew + 1, param.BlockBytes, pRecoveryData) != 0)
+        return -3;
+
+    return param.TotalRecoveryCount;
 }
 
 /*
@@ -182,132 +641,133 @@ extern void *LRC_BeginDecode(unsigned short originalCount, unsigned long shardSi
     InitialParam(&pDecoder->param, originalCount, shardSize, true);
     pDecoder->pDecodedData = pData;
     pDecoder->numShards = 0;
-    for (j = 0; j < MAXSHARDS; j++)
-        pDecoder->blocks[j].pData = NULL;
-    pDecoder->pBuffer = malloc(4 * shardSize);
+    pDecoder->numThreads = 1;
+    pDecoder->bPartial = false;
+    pDecoder->bBorrow = false;
+    pDecoder->pOutputs = NULL;
+    pDecoder->numSpare = 0;
+    pDecoder->pAccumulated = NULL;
+    pDecoder->pBuffer = malloc(3 * shardSize);
     if (NULL == pDecoder->pBuffer)
     {
         free(pDecoder);
         return NULL;
     }
-    memset(ZeroBuf(pDecoder), 0, shardSize); // The last shard is zero shard
-    for (j = pDecoder->param.OriginalCount; j < pDecoder->param.TotalOriginalCount; j++)
-    {
-        pDecoder->blocks[j].pData = ZeroBuf(pDecoder);
-        pDecoder->blocks[j].lrcIndex = j;
-        pDecoder->blocks[j].decodeIndex = j;
-    }
 
     pDecoder->globalMissed = pDecoder->param.OriginalCount;
     pDecoder->numGlobalRecovery = 0;
     pDecoder->totalGlobalRecovery = 0;
     pDecoder->numHorRecovery = 0;
     pDecoder->numVerRecovery = 0;
-    for (j = 0; j < pDecoder->param.VerLocalCount; j++)
-        pDecoder->horMissed[j] = pDecoder->param.HorLocalCount;
-    pDecoder->horMissed[pDecoder->param.VerLocalCount - 1] -= pDecoder->param.TotalOriginalCount - pDecoder->param.OriginalCount;
-    for (j = 0; j < pDecoder->param.HorLocalCount; j++)
-        pDecoder->verMissed[j] = pDecoder->param.VerLocalCount;
-    for (j = pDecoder->param.OriginalCount; j < pDecoder->param.TotalOriginalCount; j++)
-        pDecoder->verMissed[j % pDecoder->param.HorLocalCount]--;
+    CM256LRC *pParam = &pDecoder->param;
+    memset(pDecoder->existed, 0, sizeof(pDecoder->existed));
+    memset(pDecoder->globalRows, 0, sizeof(pDecoder->globalRows));
+    memset(pDecoder->wanted, 0, sizeof(pDecoder->wanted));
+    /* Global recovery shards, the additional ones from horizonal and vertical recovery shards follow them */
+    SetBitRange(pDecoder->globalRows, GLOBAL_RECOVERY_INDEX(pParam, 0), MAX_INDEX(pParam));
+    j = cm256_get_recovery_block_index(pParam, pParam->LocalRecoveryOfGlobalRecoveryIndex);
+    if (j < MAXSHARDS)
+        pDecoder->globalRows[j >> 6] &= ~((uint64_t)1 << (j & 63));
+    for (j = 0; j < pParam->VerLocalCount; j++)
+    {
+        pDecoder->horExisted[j] = 0;
+        pDecoder->horFull[j] = 0xFFFFFFFFu >> (32 - HorGroupCount(pParam, j));
+    }
+    for (j = 0; j < pParam->HorLocalCount; j++)
+    {
+        pDecoder->verExisted[j] = 0;
+        pDecoder->verFull[j] = 0xFFFFFFFFu >> (32 - VerGroupCount(pParam, j));
+    }
 
     return pDecoder;
 }
 
+/*
+ * Begin of new decode process for bytes [offset, offset+length) of each shard
+ * return: handle of this decode process, NULL fails
+ */
+extern void *LRC_BeginDecodeRange(unsigned short originalCount, unsigned long shardSize, unsigned long offset, unsigned long length, void *pData)
+{
+    if (shardSize <= 1 || length <= 0 || offset >= shardSize - 1 || length > shardSize - 1 - offset)
+        return NULL;
+
+    /* Each byte is coded on its own, a window of the shards decodes as shards of that length */
+    return LRC_BeginDecode(originalCount, length + 1, pData);
+}
+
 /* Recover a horizaonal local group when possible, return the x coordinate of recovered shard, <0 means failed */
 static short CheckAndRecoverHor(DecoderLRC *pDecoder, short y)
 {
-    short x;
     CM256LRC *pParam = &pDecoder->param;
-    if (pDecoder->horMissed[y] != 1 || !SHARD_EXISTED(pDecoder, HOR_RECOVERY_INDEX(pParam, y)))
+    uint32_t missed = pDecoder->horFull[y] & ~pDecoder->horExisted[y];
+    if (!ONE_BIT(missed) || !SHARD_EXISTED(pDecoder, HOR_RECOVERY_INDEX(pParam, y)))
         return -1;
     /* Only miss one shard in this horizonal local group and the recovery shard of this group exists, recover the missing shard */
-    unsigned short index2 = y * pParam->HorLocalCount;
-    for (x = 0; x < pParam->HorLocalCount; x++, index2++)
-    {
-        if (!SHARD_EXISTED(pDecoder, index2))
-        {
-            /* Found the missing shard, recover it */
-            pDecoder->blocks[index2].lrcIndex = HOR_RECOVERY_INDEX(pParam, y);
-            pDecoder->blocks[index2].decodeIndex = HOR_DECODE_INDEX(pParam);
-            pDecoder->blocks[index2].pData = pDecoder->pDecodedData + index2 * pParam->BlockBytes;
-            /* Copy horizontal recovery shard data to missing shard, it will be recovered to decoded data by cm256_decode */
-            memcpy(pDecoder->blocks[index2].pData, pDecoder->blocks[HOR_RECOVERY_INDEX(pParam, y)].pData, pParam->BlockBytes);
-
-            cm256_encoder_params params;
-            params.BlockBytes = pParam->BlockBytes;
-            params.TotalOriginalCount = pParam->TotalOriginalCount;
-            params.FirstElement = y * pParam->HorLocalCount;
-            params.OriginalCount = pParam->HorLocalCount;
-            params.RecoveryCount = 1;
-            params.Step = 1;
-
-            if (cm256_decode(params, pDecoder->blocks) != 0)
-            {
-                pDecoder->blocks[index2].pData = NULL; // Decode error, it is not recovered
-                return -2;
-            }
+    short x = LowestBit(missed);
+    unsigned short index2 = y * pParam->HorLocalCount + x;
+    pDecoder->blocks[index2].lrcIndex = HOR_RECOVERY_INDEX(pParam, y);
+    pDecoder->blocks[index2].decodeIndex = HOR_DECODE_INDEX(pParam);
+    SetShard(pDecoder, index2, OutputBuf(pDecoder, index2));
+    /* Copy horizontal recovery shard data to missing shard, it will be recovered to decoded data by cm256_decode */
+    memcpy(pDecoder->blocks[index2].pData, pDecoder->blocks[HOR_RECOVERY_INDEX(pParam, y)].pData, pParam->BlockBytes);
 
-            if (pDecoder->horMissed[y] > 0) // In fact, it should be always greater than zero here unless there is a bug
-                pDecoder->horMissed[y]--;
-            if (pDecoder->verMissed[x] > 0) // In fact, it should be always greater than zero here unless there is a bug
-                pDecoder->verMissed[x]--;
-            if (pDecoder->globalMissed > 0) // In fact, it should be always greater than zero here unless there is a bug
-                pDecoder->globalMissed--;
+    cm256_encoder_params params;
+    params.BlockBytes = pParam->BlockBytes;
+    params.TotalOriginalCount = pParam->TotalOriginalCount;
+    params.FirstElement = y * pParam->HorLocalCount;
+    params.OriginalCount = HorGroupCount(pParam, y);
+    params.RecoveryCount = 1;
+    params.Step = 1;
 
-            return x;
-        }
+    if (cm256_decode(params, pDecoder->blocks) != 0)
+    {
+        ClearShard(pDecoder, index2); // Decode error, it is not recovered
+        return -2;
     }
-    return -3; // This branch is imppossible unless there is a bug
+
+    if (pDecoder->globalMissed > 0) // In fact, it should be always greater than zero here unless there is a bug
+        pDecoder->globalMissed--;
+    EliminateOriginal(pDecoder, index2);
+
+    return x;
 }
 
 /* Recover a vertical local group when possible, return the y coordinate of recovered shard, <0 means failed */
 static short CheckAndRecoverVer(DecoderLRC *pDecoder, short x)
 {
-    short y;
     CM256LRC *pParam = &pDecoder->param;
-    if (pDecoder->verMissed[x] != 1 || !SHARD_EXISTED(pDecoder, VER_RECOVERY_INDEX(pParam, x)))
+    uint32_t missed = pDecoder->verFull[x] & ~pDecoder->verExisted[x];
+    if (!ONE_BIT(missed) || !SHARD_EXISTED(pDecoder, VER_RECOVERY_INDEX(pParam, x)))
         return -1;
     /* Only miss one shard in this vertical local group and the recovery shard of this group exists, recover the missing shard */
-    unsigned short index2 = x;
-    for (y = 0; y < pParam->VerLocalCount; y++)
-    {
-        if (!SHARD_EXISTED(pDecoder, index2))
-        {
-            /* Found the missing shard, recover it */
-            pDecoder->blocks[index2].lrcIndex = VER_RECOVERY_INDEX(pParam, x);
-            pDecoder->blocks[index2].decodeIndex = VER_DECODE_INDEX(pParam);
-            pDecoder->blocks[index2].pData = pDecoder->pDecodedData + index2 * pParam->BlockBytes;
-            /* Copy vertical recovery shard data to missing shard, it will be recovered to decoded data by cm256_decode */
-            memcpy(pDecoder->blocks[index2].pData, pDecoder->blocks[VER_RECOVERY_INDEX(pParam, x)].pData, pParam->BlockBytes);
+    short y = LowestBit(missed);
+    unsigned short index2 = y * pParam->HorLocalCount + x;
+    pDecoder->blocks[index2].lrcIndex = VER_RECOVERY_INDEX(pParam, x);
+    pDecoder->blocks[index2].decodeIndex = VER_DECODE_INDEX(pParam);
+    SetShard(pDecoder, index2, OutputBuf(pDecoder, index2));
+    /* Copy vertical recovery shard data to missing shard, it will be recovered to decoded data by cm256_decode */
+    memcpy(pDecoder->blocks[index2].pData, pDecoder->blocks[VER_RECOVERY_INDEX(pParam, x)].pData, pParam->BlockBytes);
 
-            cm256_encoder_params params;
-            params.BlockBytes = pParam->BlockBytes;
-            params.TotalOriginalCount = pParam->TotalOriginalCount;
-            params.FirstElement = x;
-            params.OriginalCount = pParam->VerLocalCount;
-            params.RecoveryCount = 1;
-            params.Step = pParam->HorLocalCount;
+    cm256_encoder_params params;
+    params.BlockBytes = pParam->BlockBytes;
+    params.TotalOriginalCount = pParam->TotalOriginalCount;
+    params.FirstElement = x;
+    params.OriginalCount = VerGroupCount(pParam, x);
+    params.RecoveryCount = 1;
+    params.Step = pParam->HorLocalCount;
 
-            if (cm256_decode(params, pDecoder->blocks) != 0)
-            {
-                pDecoder->blocks[index2].pData = NULL; // Decode error, it is not recovered
-                return -2;
-            }
+    if (cm256_decode(params, pDecoder->blocks) != 0)
+    {
+        ClearShard(pDecoder, index2); // Decode error, it is not recovered
+        return -2;
+    }
 
-            /* Recovery success */
-            if (pDecoder->horMissed[y] > 0) // In fact, it should be always greater than zero here unless there is a bug
-                pDecoder->horMissed[y]--;
-            if (pDecoder->verMissed[x] > 0) // In fact, it should be always greater than zero here unless there is a bug
-                pDecoder->verMissed[x]--;
-            if (pDecoder->globalMissed > 0) // In fact, it should be always greater than zero here unless there is a bug
-                pDecoder->globalMissed--;
+    /* Recovery success */
+    if (pDecoder->globalMissed > 0) // In fact, it should be always greater than zero here unless there is a bug
+        pDecoder->globalMissed--;
+    EliminateOriginal(pDecoder, index2);
 
-            return y;
-        }
-        index2 += pParam->HorLocalCount;
-    }
-    return -3; // This branch is imppossible unless there is a bug
+    return y;
 }
 
 /* Recover local group of global recovery shards when possible */
@@ -329,7 +789,7 @@ static bool CheckAndRecoverGlobal(DecoderLRC *pDecoder)
             if (!SHARD_EXISTED(pDecoder, index))
             {
                 /* Found the missing shard, repair it */
-                pDecoder->blocks[index].pData = pBuf;
+                SetShard(pDecoder, index, pBuf);
                 pDecoder->blocks[index].lrcIndex = index;
                 pDecoder->blocks[index].decodeIndex = GLOBAL_DECODE_INDEX(pParam, i);
             }
@@ -345,7 +805,7 @@ static bool CheckAndRecoverGlobal(DecoderLRC *pDecoder)
     }
 
     CM256Block *pBlock = &pDecoder->blocks[GLOBAL_FROM_HOR_INDEX(pParam)];
-    if (pDecoder->numHorRecovery == pParam->VerLocalCount && NULL == pBlock->pData)
+    if (pDecoder->numHorRecovery == pParam->VerLocalCount && !SHARD_EXISTED(pDecoder, GLOBAL_FROM_HOR_INDEX(pParam)))
     {
         /* There is an additional global recovery shard from horizonal recovery shards */
         uint8_t *pBuf = GlobalFromHorBuf(pDecoder);
@@ -354,7 +814,7 @@ static bool CheckAndRecoverGlobal(DecoderLRC *pDecoder)
         {
             gf256_add_mem(pBuf, pDecoder->blocks[HOR_RECOVERY_INDEX(pParam, i)].pData, pParam->BlockBytes);
         }
-        pBlock->pData = pBuf;
+        SetShard(pDecoder, GLOBAL_FROM_HOR_INDEX(pParam), pBuf);
         pBlock->lrcIndex = GLOBAL_FROM_HOR_INDEX(pParam);
         pBlock->decodeIndex = HOR_DECODE_INDEX(pParam);
 
@@ -363,14 +823,14 @@ static bool CheckAndRecoverGlobal(DecoderLRC *pDecoder)
     }
 
     pBlock = &pDecoder->blocks[GLOBAL_FROM_VER_INDEX(pParam)];
-    if (pDecoder->numVerRecovery == pParam->HorLocalCount && NULL == pBlock->pData)
+    if (pDecoder->numVerRecovery == pParam->HorLocalCount && !SHARD_EXISTED(pDecoder, GLOBAL_FROM_VER_INDEX(pParam)))
     {
         /* There is an additional global recovery shard from vertical recovery shards */
         uint8_t *pBuf = GlobalFromVerBuf(pDecoder);
         memcpy(pBuf, pDecoder->blocks[VER_RECOVERY_INDEX(pParam, 0)].pData, pParam->BlockBytes);
         for (i = 1; i < pParam->HorLocalCount; i++)
             gf256_add_mem(pBuf, pDecoder->blocks[VER_RECOVERY_INDEX(pParam, i)].pData, pParam->BlockBytes);
-        pBlock->pData = pBuf;
+        SetShard(pDecoder, GLOBAL_FROM_VER_INDEX(pParam), pBuf);
         pBlock->lrcIndex = GLOBAL_FROM_VER_INDEX(pParam);
         pBlock->decodeIndex = VER_DECODE_INDEX(pParam);
 
@@ -381,6 +841,18 @@ static bool CheckAndRecoverGlobal(DecoderLRC *pDecoder)
     return ret;
 }
 
+/* Whether all the wanted original shards of a partial decode are collected or recovered */
+static bool WantedCollected(DecoderLRC *pDecoder)
+{
+    short w;
+    for (w = 0; w < MAXSHARDS / 64; w++)
+    {
+        if (0 != (pDecoder->wanted[w] & ~pDecoder->existed[w]))
+            return false;
+    }
+    return true;
+}
+
 /*
  * Decode one shard for specific decode process
  * handle: handle of decode process
@@ -410,17 +882,19 @@ extern short LRC_Decode(void *handle, const void *pData)
             return 0; // Already calculated or received
         pDecoder->blocks[index].lrcIndex = index;
         pDecoder->blocks[index].decodeIndex = index;
-        pDecoder->blocks[index].pData = pDecoder->pDecodedData + index * pParam->BlockBytes;
-        memcpy(pDecoder->blocks[index].pData, pShard + 1, pParam->BlockBytes); // Copy to destinaltion
+        if (BorrowShard(pDecoder, index))
+            SetShard(pDecoder, index, pShard + 1); // Left in place, as recovery shards
+        else
+        {
+            SetShard(pDecoder, index, OutputBuf(pDecoder, index));
+            memcpy(pDecoder->blocks[index].pData, pShard + 1, pParam->BlockBytes); // Copy to destinaltion
+        }
 
         y = index / pParam->HorLocalCount;
         x = index % pParam->HorLocalCount;
-        if (pDecoder->horMissed[y] > 0) // In fact, it should be always greater than zero here unless there is a bug
-            pDecoder->horMissed[y]--;
-        if (pDecoder->verMissed[x] > 0) // In fact, it should be always greater than zero here unless there is a bug
-            pDecoder->verMissed[x]--;
         if (pDecoder->globalMissed > 0) // In fact, it should be always greater than zero here unless there is a bug
             pDecoder->globalMissed--;
+        EliminateOriginal(pDecoder, index);
     }
     else
     {
@@ -429,7 +903,7 @@ extern short LRC_Decode(void *handle, const void *pData)
         index = cm256_get_recovery_block_index(pParam, recoveryIndex);
         if (SHARD_EXISTED(pDecoder, index))
             return 0;                               // Already calculated or received
-        pDecoder->blocks[index].pData = pShard + 1; // skip index byte
+        SetShard(pDecoder, index, pShard + 1); // skip index byte
         pDecoder->blocks[index].lrcIndex = index;
         if (recoveryIndex >= pParam->FirstHorRecoveryIndex && recoveryIndex < pParam->FirstHorRecoveryIndex + pParam->VerLocalCount)
         {
@@ -451,6 +925,7 @@ extern short LRC_Decode(void *handle, const void *pData)
         {
             /* One of global recovery shard */
             pDecoder->blocks[index].decodeIndex = GLOBAL_DECODE_INDEX(pParam, recoveryIndex - pParam->FirstGlobalRecoveryIndex);
+            AccumulateGlobal(pDecoder, recoveryIndex - pParam->FirstGlobalRecoveryIndex, pShard + 1);
             pDecoder->numGlobalRecovery++;
             pDecoder->totalGlobalRecovery++;
             x = -1;
@@ -491,136 +966,1570 @@ extern short LRC_Decode(void *handle, const void *pData)
 
     if (pDecoder->globalMissed <= 0)
         return 1; // ALl data already been repaired
+    if (pDecoder->bPartial && WantedCollected(pDecoder))
+        return 1; // ALl wanted data already been repaired
     if (pDecoder->globalMissed > pDecoder->totalGlobalRecovery)
         return 0;
 
     /* ALl data can be repaired by global recovery shards */
-    short globalIndex = GLOBAL_RECOVERY_INDEX(pParam, 0);
-    for (i = 0; i < pParam->OriginalCount; i++)
+    bool bEliminated = NULL != pDecoder->pAccumulated;
+    short numRows = 0;
+    CM256Block *rows[MAXSHARDS]; // Recovery shards that the originals are not folded into yet
+    short w, r = 0;
+    uint64_t available[MAXSHARDS / 64]; // Recovery shards not taken by a missing shard yet
+    for (w = 0; w < MAXSHARDS / 64; w++)
+        available[w] = pDecoder->existed[w] & pDecoder->globalRows[w];
+    for (w = 0; w * 64 < pParam->OriginalCount; w++)
     {
-        if (!SHARD_EXISTED(pDecoder, i))
+        uint64_t missed = ~pDecoder->existed[w];
+        if (pParam->OriginalCount - w * 64 < 64)
+            missed &= ((uint64_t)1 << (pParam->OriginalCount - w * 64)) - 1;
+        for (; 0 != missed; missed &= missed - 1)
         {
             /* Found one missing shard that need be repaired */
-            while (!SHARD_EXISTED(pDecoder, globalIndex))
+            i = w * 64 + LowestBit(missed);
+            while (0 == available[r])
             {
-                if (++globalIndex == cm256_get_recovery_block_index(pParam, pParam->LocalRecoveryOfGlobalRecoveryIndex))
-                    globalIndex++;
-                if (globalIndex > MAX_INDEX(pParam))
+                if (++r == MAXSHARDS / 64)
                     return 0; // This branch is impossible unless there is bug
             }
-            pDecoder->blocks[i].pData = pDecoder->pDecodedData + i * pParam->BlockBytes;
-            memcpy(pDecoder->blocks[i].pData, pDecoder->blocks[globalIndex].pData, pParam->BlockBytes);
+            short globalIndex = r * 64 + LowestBit(available[r]);
+            available[r] &= available[r] - 1;
+            short g = globalIndex - GLOBAL_RECOVERY_INDEX(pParam, 0);
+            if (pDecoder->bPartial && !pDecoder->bWanted[i] && !bEliminated)
+                SetShard(pDecoder, i, pDecoder->blocks[globalIndex].pData); // Not recovered, only read
+            else
+            {
+                SetShard(pDecoder, i, OutputBuf(pDecoder, i));
+                if (bEliminated && g < pParam->GlobalRecoveryCount && pDecoder->bAccumulated[g])
+                    memcpy(pDecoder->blocks[i].pData, AccumulatedBuf(pDecoder, g), pParam->BlockBytes);
+                else
+                {
+                    memcpy(pDecoder->blocks[i].pData, pDecoder->blocks[globalIndex].pData, pParam->BlockBytes);
+                    rows[numRows++] = &pDecoder->blocks[i];
+                }
+            }
             pDecoder->blocks[i].lrcIndex = pDecoder->blocks[globalIndex].lrcIndex;
             pDecoder->blocks[i].decodeIndex = pDecoder->blocks[globalIndex].decodeIndex;
+        }
+    }
+
+    cm256_encoder_params params = GlobalParams(pParam, pDecoder->globalMissed);
 
-            globalIndex++;
-            if (globalIndex == cm256_get_recovery_block_index(pParam, pParam->LocalRecoveryOfGlobalRecoveryIndex))
-                globalIndex++;
+    if (bEliminated)
+    {
+        /* Only recovery shards that did not arrive as global recovery shards still need the originals folded in */
+        short count = 0;
+        const CM256Block *originals[MAXSHARDS];
+        for (i = 0; i < pParam->OriginalCount; i++)
+        {
+            if (pDecoder->blocks[i].lrcIndex == i)
+                originals[count++] = &pDecoder->blocks[i];
         }
+        cm256_eliminate(&params, rows, numRows, originals, count);
+        return !cm256_decode_eliminated(params, pDecoder->blocks, pDecoder->numThreads);
     }
 
-    cm256_encoder_params params;
-    params.BlockBytes = pParam->BlockBytes;
-    params.TotalOriginalCount = pParam->TotalOriginalCount;
-    params.FirstElement = 0;
-    params.OriginalCount = pParam->OriginalCount;
-    params.RecoveryCount = pDecoder->globalMissed;
-    params.Step = 1;
+    if (!pDecoder->bPartial)
+        return !cm256_decode_parallel(params, pDecoder->blocks, pDecoder->numThreads);
+
+    short ret = !cm256_decode_wanted(params, pDecoder->blocks, pDecoder->bWanted, pDecoder->numThreads);
+    for (i = 0; i < pParam->OriginalCount; i++)
+    {
+        if (pDecoder->blocks[i].lrcIndex >= pParam->TotalOriginalCount)
+            ClearShard(pDecoder, i); // Not wanted, still the data of a recovery shard
+    }
+    return ret;
+}
+
+/*
+ * Decode only some original shards of a decode process, before its first shard
+ * return: 0 success, <0 error
+ */
+extern short LRC_SetDecodeWanted(void *handle, const unsigned char *pList, unsigned short count)
+{
+    short i;
+    if (NULL == handle || NULL == pList || count <= 0)
+        return -1;
+    DecoderLRC *pDecoder = handle;
+    if (DECODE_MAGIC != pDecoder->magic)
+        return -1;
+    if (pDecoder->numShards > 0)
+        return -3;
+    for (i = 0; i < count; i++)
+    {
+        if (pList[i] >= pDecoder->param.OriginalCount)
+            return -2;
+    }
+
+    memset(pDecoder->bWanted, 0, sizeof(pDecoder->bWanted));
+    memset(pDecoder->wanted, 0, sizeof(pDecoder->wanted));
+    for (i = 0; i < count; i++)
+    {
+        pDecoder->bWanted[pList[i]] = true;
+        pDecoder->wanted[pList[i] >> 6] |= (uint64_t)1 << (pList[i] & 63);
+    }
+    pDecoder->bPartial = true;
+    return 0;
+}
+
+/*
+ * Decode original shards into separate buffers, before the first shard of a decode process
+ * return: 0 success, <0 error
+ */
+extern short LRC_SetDecodeOutputs(void *handle, void *pOutputs[])
+{
+    short i;
+    if (NULL == handle || NULL == pOutputs)
+        return -1;
+    DecoderLRC *pDecoder = handle;
+    if (DECODE_MAGIC != pDecoder->magic)
+        return -1;
+    if (pDecoder->numShards > 0)
+        return -3;
+    for (i = 0; i < pDecoder->param.OriginalCount; i++)
+    {
+        if (NULL == pOutputs[i])
+            return -2;
+    }
+
+    if (NULL == pDecoder->pOutputs)
+    {
+        pDecoder->pOutputs = malloc(pDecoder->param.OriginalCount * sizeof(uint8_t *));
+        if (NULL == pDecoder->pOutputs)
+            return -4;
+    }
+    memcpy(pDecoder->pOutputs, pOutputs, pDecoder->param.OriginalCount * sizeof(uint8_t *));
+    return 0;
+}
+
+/*
+ * Leave original shards where LRC_Decode got them, before the first shard of a decode process
+ * return: 0 success, <0 error
+ */
+extern short LRC_SetDecodeBorrow(void *handle)
+{
+    if (NULL == handle)
+        return -1;
+    DecoderLRC *pDecoder = handle;
+    if (DECODE_MAGIC != pDecoder->magic)
+        return -1;
+    if (pDecoder->numShards > 0)
+        return -3;
+
+    pDecoder->bBorrow = true;
+    return 0;
+}
+
+/*
+ * Fold original shards into the global recovery shards while they arrive, before the first shard of a decode process
+ * return: 0 success, <0 error
+ */
+extern short LRC_SetDecodeProgressive(void *handle, short numRows)
+{
+    short g;
+    if (NULL == handle || numRows < 0)
+        return -1;
+    DecoderLRC *pDecoder = handle;
+    if (DECODE_MAGIC != pDecoder->magic)
+        return -1;
+    if (pDecoder->numShards > 0)
+        return -3;
+
+    CM256LRC *pParam = &pDecoder->param;
+    if (NULL == pDecoder->pAccumulated)
+    {
+        pDecoder->pAccumulated = malloc(pParam->GlobalRecoveryCount * pParam->BlockBytes);
+        if (NULL == pDecoder->pAccumulated)
+            return -4;
+    }
+    if (numRows > pParam->GlobalRecoveryCount)
+        numRows = pParam->GlobalRecoveryCount;
+    for (g = 0; g < pParam->GlobalRecoveryCount; g++)
+    {
+        pDecoder->bFolding[g] = g < numRows;
+        pDecoder->bAccumulated[g] = false;
+    }
+    memset(pDecoder->pAccumulated, 0, numRows * pParam->BlockBytes);
+    memset(pDecoder->bEliminated, 0, sizeof(pDecoder->bEliminated));
+    return 0;
+}
+
+/*
+ * Get the data of one original shard of a decode process
+ * return: the data, NULL if the shard is neither collected nor recovered
+ */
+extern const void *LRC_GetDecodedShard(void *handle, unsigned short index)
+{
+    if (NULL == handle)
+        return NULL;
+    DecoderLRC *pDecoder = handle;
+    if (DECODE_MAGIC != pDecoder->magic || index >= pDecoder->param.OriginalCount)
+        return NULL;
+    if (!SHARD_EXISTED(pDecoder, index) || pDecoder->blocks[index].lrcIndex != index)
+        return NULL; // Still the data of a recovery shard while it is being recovered
+
+    return pDecoder->blocks[index].pData;
+}
+
+/*
+ * Set the most threads the global decode of a decode process may use
+ * return: 0 success, <0 error
+ */
+extern short LRC_SetDecodeThreads(void *handle, short numThreads)
+{
+    if (NULL == handle || numThreads <= 0)
+        return -1;
+    DecoderLRC *pDecoder = handle;
+    if (DECODE_MAGIC != pDecoder->magic)
+        return -1;
+
+    pDecoder->numThreads = numThreads;
+    return 0;
+}
+
+/*
+ * Abandon a decode or rebuild process
+ */
+extern short LRC_FreeHandle(void *handle)
+{
+    if (NULL == handle)
+        return false;
+
+    DecoderLRC *pDecoder = handle;
+    if (DECODE_MAGIC == pDecoder->magic)
+    {
+        if (NULL != pDecoder->pBuffer)
+            free(pDecoder->pBuffer);
+        if (NULL != pDecoder->pOutputs)
+            free(pDecoder->pOutputs);
+        if (NULL != pDecoder->pAccumulated)
+            free(pDecoder->pAccumulated);
+        free(pDecoder);
+        return true;
+    }
+
+    Rebuilder *pRebuilder = handle;
+    if (REBUILD_MAGIC == pRebuilder->magic)
+    {
+        free(pRebuilder);
+        return true;
+    }
+
+    MultiRebuilder *pMulti = handle;
+    if (MULTI_REBUILD_MAGIC == pMulti->magic)
+    {
+        if (NULL != pMulti->pDecoder)
+            LRC_FreeHandle(pMulti->pDecoder);
+        if (NULL != pMulti->pDecodedData)
+            free(pMulti->pDecodedData);
+        free(pMulti);
+        return true;
+    }
+
+    EncodePlanLRC *pPlan = handle;
+    if (ENCODE_PLAN_MAGIC == pPlan->magic)
+    {
+        pPlan->magic = 0;
+        free(pPlan);
+        return true;
+    }
+
+    EncoderLRC *pEncoder = handle;
+    if (ENCODE_MAGIC == pEncoder->magic)
+    {
+        pEncoder->magic = 0;
+        free(pEncoder);
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * Set how many decode matrices are cached for erasure patterns seen before
+ * return: the number now in use
+ */
+extern short LRC_SetDecodeCacheSize(short maxEntries)
+{
+    return cm256_cache_configure(maxEntries);
+}
+
+/*
+ * Get statistics of decode matrix cache
+ */
+extern void LRC_GetDecodeCacheStats(unsigned long *pHits, unsigned long *pMisses, short *pEntries)
+{
+    int entries;
+    cm256_cache_stats(pHits, pMisses, &entries);
+    if (NULL != pEntries)
+        *pEntries = entries;
+}
+
+short GetHorLocalCount(short originalCount)
+{
+    return originalCount >= 64 ? 8 : sqrt(originalCount);
+}
+
+void InitialParam(CM256LRC *pParam, unsigned short originalCount, unsigned shardSize, bool bIndexByte)
+{
+    pParam->bIndexByte = bIndexByte;
+    pParam->BlockBytes = bIndexByte ? shardSize - 1 : shardSize;
+    pParam->OriginalCount = originalCount;
+    pParam->GlobalRecoveryCount = globalRecoveryCount;
+    pParam->HorLocalCount = GetHorLocalCount(originalCount);
+    pParam->VerLocalCount = (originalCount + pParam->HorLocalCount - 1) / pParam->HorLocalCount;
+    pParam->TotalOriginalCount = pParam->HorLocalCount * pParam->VerLocalCount;
+    pParam->FirstHorRecoveryIndex = 0;
+    pParam->FirstVerRecoveryIndex = pParam->VerLocalCount;
+    pParam->FirstGlobalRecoveryIndex = pParam->VerLocalCount + pParam->HorLocalCount;
+    pParam->LocalRecoveryOfGlobalRecoveryIndex = pParam->FirstGlobalRecoveryIndex + pParam->GlobalRecoveryCount;
+    pParam->TotalRecoveryCount = pParam->LocalRecoveryOfGlobalRecoveryIndex + 1;
+}
+
+/* Mark the originals that lost shard iLost is figured from, all of them for global recovery shards and their local recovery shard */
+static void MarkDependencies(const CM256LRC *pParam, short iLost, bool *bWanted)
+{
+    short i;
+    short recoveryIndex = iLost - pParam->OriginalCount;
+    if (iLost < pParam->OriginalCount)
+        bWanted[iLost] = true;
+    else if (recoveryIndex >= pParam->FirstHorRecoveryIndex && recoveryIndex < pParam->FirstHorRecoveryIndex + pParam->VerLocalCount)
+    {
+        short y = recoveryIndex - pParam->FirstHorRecoveryIndex;
+        for (i = y * pParam->HorLocalCount; i < y * pParam->HorLocalCount + HorGroupCount(pParam, y); i++)
+            bWanted[i] = true;
+    }
+    else if (recoveryIndex >= pParam->FirstVerRecoveryIndex && recoveryIndex < pParam->FirstVerRecoveryIndex + pParam->HorLocalCount)
+    {
+        for (i = recoveryIndex - pParam->FirstVerRecoveryIndex; i < pParam->OriginalCount; i += pParam->HorLocalCount)
+            bWanted[i] = true;
+    }
+    else
+    {
+        for (i = 0; i < pParam->OriginalCount; i++)
+            bWanted[i] = true;
+    }
+}
+
+/*
+ * Begin a rebuild process
+ * originalCount: number of shards of original data
+ * iLost: order of lost shard
+ * shardSize: size of each shard
+ * pData: the buffer for rebuilt shard, at least shardSize length
+ * return: handle of rebuild process, NULL fails
+ */
+extern void *LRC_BeginRebuild(unsigned short originalCount, unsigned short iLost, unsigned long shardSize, void *pData)
+{
+    short j;
+    bool bWanted[MAXSHARDS];
+    CM256LRC param;
+    if (originalCount <= 0 || originalCount >= MAXSHARDS)
+        return NULL;
+    InitialParam(&param, originalCount, shardSize, true);
+    if (iLost >= originalCount + param.TotalRecoveryCount)
+        return NULL;
+
+    Rebuilder *pRebuilder = malloc(sizeof(Rebuilder));
+    if (NULL == pRebuilder)
+        return NULL;
+    pRebuilder->magic = REBUILD_MAGIC;
+    pRebuilder->iLost = iLost;
+    pRebuilder->stage = INIT_REBUILD;
+    pRebuilder->pRepairedData = pData;
+    *pRebuilder->pRepairedData++ = iLost; // Index byte
+
+    memset(pRebuilder->shardStatus, UNKNOWN, sizeof(pRebuilder->shardStatus));
+    pRebuilder->shardStatus[iLost] = LOST;
+    for (j = 0; j < MAXSHARDS; j++)
+        pRebuilder->shards[j] = NULL;
+    pRebuilder->numShards = 0;
+    memset(&pRebuilder->have, 0, sizeof(pRebuilder->have));
+    pRebuilder->numOriginalsAtHand = 0;
+    pRebuilder->numRecoveryAtHand = 0;
+    memset(bWanted, 0, sizeof(bWanted));
+    memset(pRebuilder->wanted, 0, sizeof(pRebuilder->wanted));
+    MarkDependencies(&param, iLost, bWanted);
+    for (j = 0; j < originalCount; j++)
+    {
+        if (bWanted[j])
+            pRebuilder->wanted[j / param.HorLocalCount] |= (uint32_t)1 << (j % param.HorLocalCount);
+    }
+    pRebuilder->param = param;
+    pRebuilder->bCosts = false;
+    pRebuilder->triedStages = 0;
+    pRebuilder->bHedged = false;
+    pRebuilder->numSpare = 0;
+    pRebuilder->numHedged = 0;
+
+    return pRebuilder;
+}
+
+/*
+ * Begin a rebuild process for bytes [offset, offset+length) of the lost shard
+ * return: handle of this rebuild process, NULL fails
+ */
+extern void *LRC_BeginRebuildRange(unsigned short originalCount, unsigned short iLost, unsigned long shardSize, unsigned long offset, unsigned long length, void *pData)
+{
+    if (shardSize <= 1 || length <= 0 || offset >= shardSize - 1 || length > shardSize - 1 - offset)
+        return NULL;
+
+    /* Each byte is coded on its own, a window of the shards rebuilds as shards of that length */
+    return LRC_BeginRebuild(originalCount, iLost, length + 1, pData);
+}
+
+/*
+ * Begin the decode of GLOBAL_REBUILD for only the wanted originals, the originals are borrowed where they arrived.
+ * pTargets: buffer of each lost original that it is rebuilt to, NULL for the others
+ * ppDecodedData: return the blocks of this decode. The first one is for figuring local recovery shard for global
+ *                recovery shards, then one for each other wanted original, then the ones for originals that local
+ *                groups recover on the way
+ * return: handle of decode process, NULL fails
+ */
+static DecoderLRC *BeginRebuildDecode(const CM256LRC *pParam, const bool *bWanted, uint8_t *const *pTargets, uint8_t **ppDecodedData)
+{
+    short i, numWanted = 0, numBlocks = 1;
+    unsigned char wanted[MAXSHARDS];
+    int blockBytes = pParam->BlockBytes;
+    for (i = 0; i < pParam->OriginalCount; i++)
+    {
+        if (!bWanted[i])
+            continue;
+        wanted[numWanted++] = i;
+        if (NULL == pTargets[i])
+            numBlocks++;
+    }
+
+    *ppDecodedData = malloc((numBlocks + pParam->HorLocalCount + pParam->VerLocalCount) * blockBytes);
+    if (NULL == *ppDecodedData)
+        return NULL;
+    DecoderLRC *pDecoder = LRC_BeginDecode(pParam->OriginalCount, blockBytes + 1, *ppDecodedData + numBlocks * blockBytes);
+    if (NULL == pDecoder)
+        return NULL;
+    pDecoder->pOutputs = malloc(pParam->OriginalCount * sizeof(uint8_t *));
+    if (NULL == pDecoder->pOutputs || LRC_SetDecodeWanted(pDecoder, wanted, numWanted) != 0)
+    {
+        LRC_FreeHandle(pDecoder);
+        return NULL;
+    }
+    numBlocks = 1;
+    for (i = 0; i < pParam->OriginalCount; i++)
+    {
+        pDecoder->pOutputs[i] = pTargets[i]; // NULL if not wanted, recovered to the blocks after the wanted ones if its local group does
+        if (bWanted[i] && NULL == pTargets[i])
+            pDecoder->pOutputs[i] = *ppDecodedData + numBlocks++ * blockBytes;
+    }
+    LRC_SetDecodeBorrow(pDecoder);
+    return pDecoder;
+}
+
+/*
+ * Figure lost recovery shard iLost from the originals of a rebuild decode, either borrowed or decoded
+ * pScratch: one block for figuring local recovery shard for global recovery shards
+ * return: 0 success, <0 error
+ */
+static short EncodeRecoveryShard(const CM256LRC *pParam, void *pDecoder, short iLost, uint8_t *pOut, uint8_t *pScratch)
+{
+    short i;
+    int blockBytes = pParam->BlockBytes;
+    CM256Block blocks[MAXSHARDS];
+    for (i = 0; i < pParam->OriginalCount; i++)
+    {
+        blocks[i].pData = (uint8_t *)LRC_GetDecodedShard(pDecoder, i);
+        blocks[i].lrcIndex = i;
+        blocks[i].decodeIndex = i;
+    }
+    short recoveryIndex = iLost - pParam->OriginalCount;
+    if (recoveryIndex >= pParam->FirstHorRecoveryIndex && recoveryIndex < pParam->FirstHorRecoveryIndex + pParam->VerLocalCount)
+    {
+        /* Horizonal recovery shard */
+        short y = recoveryIndex - pParam->FirstHorRecoveryIndex;
+        const CM256Block *pBlock = &blocks[y * pParam->HorLocalCount];
+        memcpy(pOut, pBlock->pData, blockBytes);
+        for (i = 1; i < HorGroupCount(pParam, y); i++)
+            gf256_add_mem(pOut, pBlock[i].pData, blockBytes);
+        return 0;
+    }
+
+    cm256_encoder_params cmParam;
+    cmParam.TotalOriginalCount = pParam->TotalOriginalCount;
+    cmParam.BlockBytes = pParam->BlockBytes;
+    if (recoveryIndex >= pParam->FirstVerRecoveryIndex && recoveryIndex < pParam->FirstVerRecoveryIndex + pParam->HorLocalCount)
+    {
+        /* One of vertical recovery shards */
+        cmParam.FirstElement = recoveryIndex - pParam->FirstVerRecoveryIndex;
+        cmParam.OriginalCount = VerGroupCount(pParam, cmParam.FirstElement);
+        cmParam.Step = pParam->HorLocalCount;
+        cmParam.RecoveryCount = 1;
+        CM256EncodeBlock(cmParam, blocks, cmParam.TotalOriginalCount + 1, pOut);
+        return 0;
+    }
+    cmParam.OriginalCount = pParam->OriginalCount;
+    cmParam.RecoveryCount = pParam->GlobalRecoveryCount;
+    cmParam.FirstElement = 0;
+    cmParam.Step = 1;
+    if (recoveryIndex >= pParam->FirstGlobalRecoveryIndex && recoveryIndex < pParam->FirstGlobalRecoveryIndex + pParam->GlobalRecoveryCount)
+    {
+        /* One of global recovery shard */
+        /* 1st recovery matrix is used for horizon recovery, 2nd matrix is used for vertical recovery, global recovery start from 2 */
+        CM256EncodeBlock(cmParam, blocks, cmParam.TotalOriginalCount + recoveryIndex - pParam->FirstGlobalRecoveryIndex + 2, pOut);
+        return 0;
+    }
+    if (recoveryIndex == pParam->LocalRecoveryOfGlobalRecoveryIndex)
+    {
+        /* Local recovery shard for global recovery shards */
+        memset(pOut, 0, blockBytes);
+        for (i = 0; i < pParam->GlobalRecoveryCount; i++)
+        {
+            /* 1st recovery matrix is used for horizon recovery, 2nd matrix is used for vertical recovery, global recovery start from 2 */
+            CM256EncodeBlock(cmParam, blocks, cmParam.TotalOriginalCount + i + 2, pScratch); // Recover one global recovery shard
+            gf256_add_mem(pOut, pScratch, blockBytes);
+        }
+        return 0;
+    }
+    return -6; // Impossible branch
+}
+
+/* The stages that rebuild lost shard iLost by one local group, in the fixed order they are tried */
+static short LocalStages(const CM256LRC *pParam, short iLost, RebuildStage *pStages)
+{
+    short recoveryIndex = iLost - pParam->OriginalCount;
+    if (iLost < pParam->OriginalCount)
+    {
+        pStages[0] = HOR_REBUILD;
+        pStages[1] = VER_REBUILD;
+        return 2;
+    }
+    if (recoveryIndex >= pParam->FirstHorRecoveryIndex && recoveryIndex < pParam->FirstHorRecoveryIndex + pParam->VerLocalCount)
+        pStages[0] = HOR_RECOVERY_REBUILD;
+    else if (recoveryIndex >= pParam->FirstVerRecoveryIndex && recoveryIndex < pParam->FirstVerRecoveryIndex + pParam->HorLocalCount)
+        pStages[0] = VER_RECOVERY_REBUILD;
+    else
+        pStages[0] = GLOBAL_RECOVERY_REBUILD;
+    return 1;
+}
+
+/*
+ * Shards that a local stage requests for lost shard iLost
+ * return: number of shards
+ */
+static short LocalStageShards(const CM256LRC *pParam, short iLost, RebuildStage stage, unsigned char *pList)
+{
+    short j, n, numRequest = 0;
+    short x = iLost % pParam->HorLocalCount, y = iLost / pParam->HorLocalCount;
+    short recoveryIndex = iLost - pParam->OriginalCount;
+    switch (stage)
+    {
+    case HOR_REBUILD:
+        n = y * pParam->HorLocalCount;
+        for (j = 0; j < pParam->HorLocalCount; j++)
+        {
+            if (n + j == iLost)
+                pList[numRequest++] = pParam->OriginalCount + pParam->FirstHorRecoveryIndex + y; // Horizonal local recovery shard
+            else if (n + j < pParam->OriginalCount)
+                pList[numRequest++] = n + j;
+        }
+        break;
+
+    case VER_REBUILD:
+        for (j = 0, n = x; j < pParam->VerLocalCount; j++, n += pParam->HorLocalCount)
+        {
+            if (n == iLost)
+                pList[numRequest++] = pParam->OriginalCount + pParam->FirstVerRecoveryIndex + x;
+            else if (n < pParam->OriginalCount)
+                pList[numRequest++] = n;
+        }
+        break;
+
+    case HOR_RECOVERY_REBUILD:
+        /* One of horizonal recovery shards */
+        n = (recoveryIndex - pParam->FirstHorRecoveryIndex) * pParam->HorLocalCount;
+        for (j = 0; j < pParam->HorLocalCount && n + j < pParam->OriginalCount; j++)
+            pList[numRequest++] = n + j;
+        break;
+
+    case VER_RECOVERY_REBUILD:
+        /* One of vertical recovery shards */
+        x = recoveryIndex - pParam->FirstVerRecoveryIndex;
+        for (j = 0; j < pParam->VerLocalCount; j++)
+        {
+            short iRequest = j * pParam->HorLocalCount + x;
+            if (iRequest < pParam->OriginalCount)
+                pList[numRequest++] = iRequest;
+        }
+        break;
+
+    case GLOBAL_RECOVERY_REBUILD:
+        /* One of global recovery shard, or their local recovery shard */
+        n = pParam->OriginalCount + pParam->FirstGlobalRecoveryIndex;
+        for (j = 0; j < pParam->GlobalRecoveryCount; j++)
+        {
+            if (n + j == iLost)
+                pList[numRequest++] = pParam->OriginalCount + pParam->LocalRecoveryOfGlobalRecoveryIndex;
+            else
+                pList[numRequest++] = n + j;
+        }
+        break;
+
+    default:
+        break;
+    }
+    return numRequest;
+}
+
+/*
+ * Begin a local stage of rebuild
+ * return: number of shards in new list
+ */
+static short BeginLocalStage(Rebuilder *pRebuilder, RebuildStage stage, unsigned char *pList)
+{
+    pRebuilder->stage = stage;
+    pRebuilder->triedStages |= 1 << stage;
+    pRebuilder->remainShards = LocalStageShards(&pRebuilder->param, pRebuilder->iLost, stage, pList);
+    memset(pRebuilder->pRepairedData, 0, pRebuilder->param.BlockBytes);
+    return pRebuilder->remainShards;
+}
+
+/*
+ * The lost shard is rebuilt from the shards at hand, request one of them again so that LRC_OneShardForRebuild reports it
+ * return: number of shards in new list
+ */
+static short RequestRebuilt(Rebuilder *pRebuilder, unsigned char *pList)
+{
+    short i;
+    CM256LRC *pParam = &pRebuilder->param;
+    pRebuilder->stage = DONE_REBUILD;
+    for (i = 0; i < pParam->OriginalCount + pParam->TotalRecoveryCount; i++)
+    {
+        if (EXISTED == pRebuilder->shardStatus[i])
+        {
+            pRebuilder->shardStatus[i] = REQUEST;
+            pList[0] = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void PutShard(const CM256LRC *pParam, ShardSet *pSet, short index, bool bHave)
+{
+    if (index >= pParam->OriginalCount)
+    {
+        pSet->recovery[index - pParam->OriginalCount] = bHave;
+        return;
+    }
+    short y = index / pParam->HorLocalCount;
+    short x = index % pParam->HorLocalCount;
+    if (bHave)
+    {
+        pSet->hor[y] |= (uint32_t)1 << x;
+        pSet->ver[x] |= (uint32_t)1 << y;
+    }
+    else
+    {
+        pSet->hor[y] &= ~((uint32_t)1 << x);
+        pSet->ver[x] &= ~((uint32_t)1 << y);
+    }
+}
+
+/*
+ * Whether the global decode surely gets the wanted originals from the shards at hand. Local groups missing one
+ * original recover it, then the global recovery shards, one of them may be recovered by their local recovery shard,
+ * solve all originals still missed. It does not count on horizonal or vertical recovery shards there
+ * pWanted: wanted originals by horizonal groups
+ */
+static bool GlobalDecodable(const CM256LRC *pParam, const ShardSet *pHave, const uint32_t *pWanted)
+{
+    short x, y, i, numMissed = 0, numGlobal = 0;
+    uint32_t missed, hor[32], ver[8];
+    bool bProgress, bEnough = true;
+
+    memcpy(hor, pHave->hor, pParam->VerLocalCount * sizeof(uint32_t));
+    memcpy(ver, pHave->ver, pParam->HorLocalCount * sizeof(uint32_t));
+    do
+    {
+        bProgress = false;
+        for (y = 0; y < pParam->VerLocalCount; y++)
+        {
+            missed = (0xFFFFFFFFu >> (32 - HorGroupCount(pParam, y))) & ~hor[y];
+            if (!ONE_BIT(missed) || !pHave->recovery[pParam->FirstHorRecoveryIndex + y])
+                continue;
+            x = LowestBit(missed);
+            hor[y] |= missed;
+            ver[x] |= (uint32_t)1 << y;
+            bProgress = true;
+        }
+        for (x = 0; x < pParam->HorLocalCount; x++)
+        {
+            missed = (0xFFFFFFFFu >> (32 - VerGroupCount(pParam, x))) & ~ver[x];
+            if (!ONE_BIT(missed) || !pHave->recovery[pParam->FirstVerRecoveryIndex + x])
+                continue;
+            y = LowestBit(missed);
+            ver[x] |= missed;
+            hor[y] |= (uint32_t)1 << x;
+            bProgress = true;
+        }
+    } while (bProgress);
+
+    for (y = 0; y < pParam->VerLocalCount; y++)
+    {
+        missed = (0xFFFFFFFFu >> (32 - HorGroupCount(pParam, y))) & ~hor[y];
+        numMissed += BitCount(missed);
+        bEnough = bEnough && 0 == (missed & pWanted[y]);
+    }
+    if (bEnough)
+        return true;
+    for (i = pParam->FirstGlobalRecoveryIndex; i < pParam->FirstGlobalRecoveryIndex + pParam->GlobalRecoveryCount; i++)
+        numGlobal += pHave->recovery[i];
+    if (numGlobal == pParam->GlobalRecoveryCount - 1 && pHave->recovery[pParam->LocalRecoveryOfGlobalRecoveryIndex])
+        numGlobal++;
+    return numMissed <= numGlobal;
+}
+
+/* Coefficient of original shard i in the vertical recovery shard of its group */
+static inline uint8_t VerCoefficient(const CM256LRC *pParam, short i)
+{
+    const uint8_t x_0 = (uint8_t)pParam->TotalOriginalCount;
+    return VerGroupCount(pParam, i % pParam->HorLocalCount) == 1 ? 1 : GetMatrixElement((uint8_t)(x_0 + 1), x_0, (uint8_t)i);
+}
+
+/* Coefficient of original shard i in recovery shard recoveryIndex */
+static uint8_t RecoveryElement(const CM256LRC *pParam, short recoveryIndex, short i)
+{
+    short j;
+    uint8_t element = 0;
+    const uint8_t x_0 = (uint8_t)pParam->TotalOriginalCount;
+    if (recoveryIndex >= pParam->FirstHorRecoveryIndex && recoveryIndex < pParam->FirstHorRecoveryIndex + pParam->VerLocalCount)
+        return i / pParam->HorLocalCount == recoveryIndex - pParam->FirstHorRecoveryIndex ? 1 : 0;
+    if (recoveryIndex >= pParam->FirstVerRecoveryIndex && recoveryIndex < pParam->FirstVerRecoveryIndex + pParam->HorLocalCount)
+        return i % pParam->HorLocalCount == recoveryIndex - pParam->FirstVerRecoveryIndex ? VerCoefficient(pParam, i) : 0;
+    /* One of global recovery shards, or their local recovery shard that sums them all */
+    for (j = 0; j < pParam->GlobalRecoveryCount; j++)
+    {
+        /* 1st recovery matrix is used for horizon recovery, 2nd matrix is used for vertical recovery, global recovery start from 2 */
+        if (pParam->FirstGlobalRecoveryIndex + j == recoveryIndex || pParam->LocalRecoveryOfGlobalRecoveryIndex == recoveryIndex)
+            element ^= pParam->OriginalCount == 1 ? 1 : GetMatrixElement((uint8_t)(x_0 + j + 2), x_0, (uint8_t)i);
+    }
+    return element;
+}
+
+/*
+ * Coefficients that rebuild lost shard iLost as one sum of the shards at hand. The lost shard is a sum of the
+ * originals, and the missing ones are solved from the recovery shards at hand, but only for the one combination
+ * of them the lost shard needs: the row of the inverse is found by Gauss-Jordan elimination of the small system
+ * of missing originals by recovery shards, without decoding any original
+ * pCoeffs: output, coefficient of each shard by order, 0 for the shards not read
+ * return: 1 if the shards at hand are enough, 0 if not, <0 if something wrong
+ */
+static short GlobalRebuildCoefficients(const Rebuilder *pRebuilder, uint8_t *pCoeffs)
+{
+    short i, j, c, r, numMissed = 0, numAtHand = 0, rank = 0;
+    unsigned char missed[MAXSHARDS], atHand[MAXSHARDS], pivots[MAXSHARDS];
+    uint8_t target[MAXSHARDS], row[MAXSHARDS];
+    const CM256LRC *pParam = &pRebuilder->param;
+    const short originalCount = pParam->OriginalCount;
+
+    for (i = 0; i < originalCount + pParam->TotalRecoveryCount; i++)
+    {
+        if (i < originalCount && EXISTED != pRebuilder->shardStatus[i])
+            missed[numMissed++] = i;
+        else if (i >= originalCount && EXISTED == pRebuilder->shardStatus[i])
+            atHand[numAtHand++] = i;
+    }
+    for (i = 0; i < originalCount; i++)
+    {
+        if (pRebuilder->iLost < originalCount)
+            target[i] = i == pRebuilder->iLost;
+        else
+            target[i] = RecoveryElement(pParam, pRebuilder->iLost - originalCount, i);
+    }
+
+    /* One line for each missing original: its coefficient in each recovery shard at hand, then in the lost shard */
+    const short width = numAtHand + 1;
+    uint8_t *pSystem = malloc(numMissed * width + 1);
+    if (NULL == pSystem)
+        return -4;
+    for (i = 0; i < numMissed; i++)
+    {
+        for (j = 0; j < numAtHand; j++)
+            pSystem[i * width + j] = RecoveryElement(pParam, atHand[j] - originalCount, missed[i]);
+        pSystem[i * width + numAtHand] = target[missed[i]];
+    }
+
+    for (c = 0; c < numAtHand && rank < numMissed; c++)
+    {
+        for (r = rank; r < numMissed && 0 == pSystem[r * width + c]; r++);
+        if (r >= numMissed)
+            continue; // This recovery shard adds nothing to the ones before
+        if (r != rank)
+            gf256_memswap(pSystem + r * width, pSystem + rank * width, width);
+
+        uint8_t *pPivotLine = pSystem + rank * width;
+        const uint8_t pivot = pPivotLine[c];
+        for (j = c; j < width; j++)
+            pPivotLine[j] = gf256_div(pPivotLine[j], pivot);
+        for (r = 0; r < numMissed; r++)
+        {
+            if (r != rank && 0 != pSystem[r * width + c])
+                gf256_muladd_mem(pSystem + r * width, pSystem[r * width + c], pPivotLine, width);
+        }
+        pivots[rank++] = (unsigned char)c;
+    }
+    /* The lines without pivot are all zeros, the lost shard is out of reach unless its coefficients are too */
+    for (r = rank; r < numMissed; r++)
+    {
+        if (0 != pSystem[r * width + numAtHand])
+        {
+            free(pSystem);
+            return 0;
+        }
+    }
+
+    /* The originals at hand make up what the recovery shards used add of them beyond the lost shard */
+    memset(pCoeffs, 0, originalCount + pParam->TotalRecoveryCount);
+    for (i = 0; i < originalCount; i++)
+    {
+        if (EXISTED == pRebuilder->shardStatus[i])
+            pCoeffs[i] = target[i];
+    }
+    for (r = 0; r < rank; r++)
+    {
+        const uint8_t w = pSystem[r * width + numAtHand];
+        const short iRecovery = atHand[pivots[r]];
+        if (0 == w)
+            continue;
+        pCoeffs[iRecovery] = w;
+        for (i = 0; i < originalCount; i++)
+            row[i] = RecoveryElement(pParam, iRecovery - originalCount, i);
+        for (i = 0; i < originalCount; i++)
+        {
+            if (EXISTED == pRebuilder->shardStatus[i] && 0 != row[i])
+                pCoeffs[i] ^= gf256_mul(w, row[i]);
+        }
+    }
+    free(pSystem);
+    return 1;
+}
+
+/*
+ * Rebuild the lost shard by GLOBAL_REBUILD with one gf256_dot_mem pass over the shards at hand, once they are
+ * surely enough for all originals the lost shard depends on. Nothing else is allocated or decoded
+ * bAll: try even if they are not surely enough, since no more shards are coming: local groups may rebuild it
+ *       with fewer, or horizonal and vertical recovery shards may make up for global ones
+ * return: 1 rebuilt, 0 if more shards required, <0 error
+ */
+static short RebuildByGlobal(Rebuilder *pRebuilder, bool bAll)
+{
+    short i, n = 0;
+    uint8_t coeffs[MAXSHARDS], used[MAXSHARDS];
+    const void *srcs[MAXSHARDS];
+    const uint8_t *byOrder[MAXSHARDS];
+    const CM256LRC *pParam = &pRebuilder->param;
+
+    /* Fewer recovery shards than missing originals are enough only by peeling a few local groups, left to bAll */
+    if (!bAll && (pParam->OriginalCount - pRebuilder->numOriginalsAtHand > pRebuilder->numRecoveryAtHand ||
+                  !GlobalDecodable(pParam, &pRebuilder->have, pRebuilder->wanted)))
+        return 0;
+
+    n = GlobalRebuildCoefficients(pRebuilder, coeffs);
+    if (n <= 0)
+        return n;
+    for (i = 0; i < pRebuilder->numShards; i++)
+        byOrder[pRebuilder->shards[i][0]] = pRebuilder->shards[i] + 1;
+    for (i = 0, n = 0; i < pParam->OriginalCount + pParam->TotalRecoveryCount; i++)
+    {
+        if (0 == coeffs[i])
+            continue;
+        if (EXISTED != pRebuilder->shardStatus[i])
+            return -7;
+        srcs[n] = byOrder[i];
+        used[n++] = coeffs[i];
+    }
+    gf256_dot_mem(pRebuilder->pRepairedData, used, srcs, n, pParam->BlockBytes);
+    return 1;
+}
+
+/*
+ * Cheapest shards that the global decode surely rebuilds the lost shard with, along with the shards collected:
+ * the shortest enough run of the cheapest ones is taken, then the dearest ones the others make up for are dropped.
+ * If even all of them are not surely enough, all are requested as the fixed order of stages does
+ * return: number of shards in the list, -1 if there is none to request and the shards collected are not enough
+ */
+static short CheapestGlobalShards(const Rebuilder *pRebuilder, unsigned char *pList)
+{
+    short i, j, numCandidates = 0, numRequest, low = 0, high;
+    bool bWanted[MAXSHARDS];
+    uint32_t wanted[32];
+    unsigned char candidates[MAXSHARDS];
+    ShardSet existed, have;
+    const CM256LRC *pParam = &pRebuilder->param;
+
+    memset(bWanted, 0, sizeof(bWanted));
+    memset(wanted, 0, sizeof(wanted));
+    memset(&existed, 0, sizeof(existed));
+    MarkDependencies(pParam, pRebuilder->iLost, bWanted);
+    for (i = 0; i < pParam->OriginalCount + pParam->TotalRecoveryCount; i++)
+    {
+        if (i < pParam->OriginalCount && bWanted[i])
+            wanted[i / pParam->HorLocalCount] |= (uint32_t)1 << (i % pParam->HorLocalCount);
+        if (EXISTED == pRebuilder->shardStatus[i])
+            PutShard(pParam, &existed, i, true);
+        if (UNKNOWN != pRebuilder->shardStatus[i] || LRC_COST_UNAVAILABLE == pRebuilder->costs[i])
+            continue;
+        /* Sorted by cost, the order of shards breaks ties */
+        for (j = numCandidates++; j > 0 && pRebuilder->costs[candidates[j - 1]] > pRebuilder->costs[i]; j--)
+            candidates[j] = candidates[j - 1];
+        candidates[j] = i;
+    }
+
+    /* More shards never hurt, so the shortest enough run is searched by halves */
+    for (high = numCandidates; low < high; )
+    {
+        short middle = (low + high) / 2;
+        have = existed;
+        for (i = 0; i < middle; i++)
+            PutShard(pParam, &have, candidates[i], true);
+        if (GlobalDecodable(pParam, &have, wanted))
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    have = existed;
+    for (i = 0; i < low; i++)
+        PutShard(pParam, &have, candidates[i], true);
+    memcpy(pList, candidates, numCandidates);
+    if (!GlobalDecodable(pParam, &have, wanted))
+        return numCandidates > 0 ? numCandidates : -1; // All of them, the decode may still work with local recovery shards
+
+    for (i = low - 1, numRequest = low; i >= 0; i--)
+    {
+        PutShard(pParam, &have, pList[i], false);
+        if (GlobalDecodable(pParam, &have, wanted))
+        {
+            memmove(pList + i, pList + i + 1, numRequest - i - 1);
+            numRequest--;
+        }
+        else
+            PutShard(pParam, &have, pList[i], true);
+    }
+    return numRequest;
+}
+
+/*
+ * Least cost of the shards the global decode fetches for a lost original. It gets the original by a local group
+ * or by solving all originals, so it has no fewer shards than the smallest of them, less the shards collected
+ * return: 0 if there is no such bound
+ */
+static unsigned long GlobalCostBound(const Rebuilder *pRebuilder)
+{
+    short i, j, m, n = 0;
+    unsigned long cost = 0;
+    unsigned short lowest[MAXSHARDS];
+    const CM256LRC *pParam = &pRebuilder->param;
+    if (pRebuilder->iLost >= pParam->OriginalCount)
+        return 0;
+    m = HorGroupCount(pParam, pRebuilder->iLost / pParam->HorLocalCount);
+    if (m > VerGroupCount(pParam, pRebuilder->iLost % pParam->HorLocalCount))
+        m = VerGroupCount(pParam, pRebuilder->iLost % pParam->HorLocalCount);
+    m -= pRebuilder->numShards;
+    if (m <= 0)
+        return 0;
+
+    for (i = 0; i < pParam->OriginalCount + pParam->TotalRecoveryCount; i++)
+    {
+        if (UNKNOWN != pRebuilder->shardStatus[i] || LRC_COST_UNAVAILABLE == pRebuilder->costs[i])
+            continue;
+        /* The m lowest costs sorted */
+        for (j = n < m ? n++ : m; j > 0 && lowest[j - 1] > pRebuilder->costs[i]; j--)
+        {
+            if (j < m)
+                lowest[j] = lowest[j - 1];
+        }
+        if (j < m)
+            lowest[j] = pRebuilder->costs[i];
+    }
+    if (n < m)
+        return ULONG_MAX; // Never enough
+    for (i = 0; i < m; i++)
+        cost += lowest[i];
+    return cost;
+}
+
+/* Cost of fetching the shards of a list, ULONG_MAX if one of them is lost or unavailable */
+static unsigned long RequestCost(const Rebuilder *pRebuilder, const unsigned char *pList, short numRequest)
+{
+    short i;
+    unsigned long cost = 0;
+    for (i = 0; i < numRequest; i++)
+    {
+        if (LOST == pRebuilder->shardStatus[pList[i]] || LRC_COST_UNAVAILABLE == pRebuilder->costs[pList[i]])
+            return ULONG_MAX;
+        cost += pRebuilder->costs[pList[i]];
+    }
+    return cost;
+}
+
+/*
+ * Begin the hedged stage: request the shards of all local stages not tried yet at once, with costs only the ones
+ * that can be fetched. The first local stage whose shards all arrive rebuilds the lost shard
+ * return: number of shards in new list
+ */
+static short BeginHedgedStage(Rebuilder *pRebuilder, unsigned char *pList)
+{
+    short i, j, n, num, numRequest = 0;
+    RebuildStage stages[2];
+    unsigned char list[MAXSHARDS];
+    CM256LRC *pParam = &pRebuilder->param;
+
+    pRebuilder->stage = HEDGED_REBUILD;
+    pRebuilder->numHedged = 0;
+    memset(pRebuilder->hedgedOf, 0, sizeof(pRebuilder->hedgedOf));
+    n = LocalStages(pParam, pRebuilder->iLost, stages);
+    for (i = 0; i < n; i++)
+    {
+        if (pRebuilder->triedStages & (1 << stages[i]))
+            continue;
+        num = LocalStageShards(pParam, pRebuilder->iLost, stages[i], list);
+        if (pRebuilder->bCosts && RequestCost(pRebuilder, list, num) == ULONG_MAX)
+            continue;
+        pRebuilder->triedStages |= 1 << stages[i];
+        pRebuilder->hedgedStages[pRebuilder->numHedged] = stages[i];
+        pRebuilder->hedgedRemain[pRebuilder->numHedged] = num;
+        for (j = 0; j < num; j++)
+        {
+            if (0 == pRebuilder->hedgedOf[list[j]])
+                pList[numRequest++] = list[j];
+            pRebuilder->hedgedOf[list[j]] |= 1 << pRebuilder->numHedged;
+        }
+        pRebuilder->numHedged++;
+    }
+    return numRequest;
+}
+
+/*
+ * Append the spare shards to a list of the global decode: the cheapest ones neither in the list nor fetched yet,
+ * so that the decode finishes with any enough of them instead of waiting for the slowest one
+ * return: number of shards in the list
+ */
+static short AddSpareShards(const Rebuilder *pRebuilder, unsigned char *pList, short numRequest)
+{
+    short i, iCheapest, n;
+    bool bListed[MAXSHARDS] = {false};
+    const CM256LRC *pParam = &pRebuilder->param;
+
+    for (i = 0; i < numRequest; i++)
+        bListed[pList[i]] = true;
+    for (n = 0; n < pRebuilder->numSpare; n++)
+    {
+        iCheapest = -1;
+        for (i = 0; i < pParam->OriginalCount + pParam->TotalRecoveryCount; i++)
+        {
+            if (bListed[i] || UNKNOWN != pRebuilder->shardStatus[i] || LRC_COST_UNAVAILABLE == pRebuilder->costs[i])
+                continue;
+            if (iCheapest < 0 || pRebuilder->costs[i] < pRebuilder->costs[iCheapest])
+                iCheapest = i;
+        }
+        if (iCheapest < 0)
+            break;
+        bListed[iCheapest] = true;
+        pList[numRequest++] = (unsigned char)iCheapest;
+    }
+    return numRequest;
+}
+
+/*
+ * Next shard list by costs: the cheapest of the local stages not tried yet and the global decode. A local stage
+ * fetches all shards of its group, while the global decode fetches the cheapest shards that are enough, and more
+ * of them each time this is invoked again
+ * return: number of shards in new list. 0 if no way to rebuild, <0 if something wrong
+ */
+static short NextCheapestRequestList(Rebuilder *pRebuilder, unsigned char *pList)
+{
+    short i, n, numRequest;
+    unsigned long cost, minCost;
+    RebuildStage stages[2], stage = GLOBAL_REBUILD;
+    unsigned char list[MAXSHARDS];
+    CM256LRC *pParam = &pRebuilder->param;
+
+    for (i = 0; i < pParam->OriginalCount + pParam->TotalRecoveryCount; i++)
+    {
+        if (REQUEST == pRebuilder->shardStatus[i])
+            pRebuilder->shardStatus[i] = LOST; // The remaning shards of last list
+    }
+    if (DONE_REBUILD == pRebuilder->stage)
+        return RequestRebuilt(pRebuilder, pList);
+
+    if (GLOBAL_REBUILD == pRebuilder->stage)
+    {
+        /* The shards at hand may do without the ones that did not come, else make up for them */
+        n = RebuildByGlobal(pRebuilder, true);
+        if (n < 0)
+            return n;
+        if (n > 0)
+            return RequestRebuilt(pRebuilder, pList);
+        numRequest = CheapestGlobalShards(pRebuilder, pList);
+        if (numRequest <= 0)
+            return 0;
+        if (pRebuilder->bHedged)
+            numRequest = AddSpareShards(pRebuilder, pList, numRequest);
+        for (i = 0; i < numRequest; i++)
+            pRebuilder->shardStatus[pList[i]] = REQUEST;
+        return numRequest;
+    }
+
+    minCost = ULONG_MAX;
+    n = LocalStages(pParam, pRebuilder->iLost, stages);
+    for (i = 0; i < n; i++)
+    {
+        if (pRebuilder->triedStages & (1 << stages[i]))
+            continue;
+        cost = RequestCost(pRebuilder, list, LocalStageShards(pParam, pRebuilder->iLost, stages[i], list));
+        if (cost < minCost)
+        {
+            minCost = cost;
+            stage = stages[i];
+        }
+    }
+    /* A local stage needs no decode, it is taken at the same cost */
+    numRequest = -1;
+    if (GLOBAL_REBUILD == stage || GlobalCostBound(pRebuilder) < minCost)
+    {
+        numRequest = CheapestGlobalShards(pRebuilder, pList);
+        if (numRequest >= 0 && RequestCost(pRebuilder, pList, numRequest) < minCost)
+            stage = GLOBAL_REBUILD;
+    }
+
+    if (GLOBAL_REBUILD != stage)
+        numRequest = pRebuilder->bHedged ? BeginHedgedStage(pRebuilder, pList) : BeginLocalStage(pRebuilder, stage, pList);
+    else if (numRequest < 0)
+        return 0; // Unable to repair
+    else
+    {
+        if (pRebuilder->bHedged)
+            numRequest = AddSpareShards(pRebuilder, pList, numRequest);
+        pRebuilder->stage = GLOBAL_REBUILD;
+        pRebuilder->triedStages |= 1 << GLOBAL_REBUILD;
+        n = RebuildByGlobal(pRebuilder, 0 == numRequest);
+        if (n < 0)
+            return n;
+        if (n > 0)
+            return RequestRebuilt(pRebuilder, pList);
+    }
+    for (i = 0; i < numRequest; i++)
+        pRebuilder->shardStatus[pList[i]] = REQUEST;
+    return numRequest;
+}
+
+
+/*
+ * Shards that one local group rebuilds lost shard iLost from, with the coefficient of each in their sum
+ * bVer: a lost original is rebuilt by its vertical local group instead of the horizonal one
+ * pInputs: output, orders of the shards
+ * pCoeffs: output, coefficient of each shard
+ * return: number of the shards
+ */
+static short LocalRebuildInputs(const CM256LRC *pParam, short iLost, bool bVer, unsigned char *pInputs, uint8_t *pCoeffs)
+{
+    short i, n = 0;
+    short recoveryIndex = iLost - pParam->OriginalCount;
+    if (iLost < pParam->OriginalCount && !bVer)
+    {
+        /* Horizonal recovery shard is the XOR of its group */
+        short y = iLost / pParam->HorLocalCount;
+        for (i = y * pParam->HorLocalCount; i < y * pParam->HorLocalCount + HorGroupCount(pParam, y); i++)
+        {
+            if (i == iLost)
+                continue;
+            pInputs[n] = i;
+            pCoeffs[n++] = 1;
+        }
+        pInputs[n] = pParam->OriginalCount + pParam->FirstHorRecoveryIndex + y;
+        pCoeffs[n++] = 1;
+    }
+    else if (iLost < pParam->OriginalCount)
+    {
+        /* Vertical recovery shard is the sum of c_i * original_i, solved for the lost one */
+        short x = iLost % pParam->HorLocalCount;
+        uint8_t c = VerCoefficient(pParam, iLost);
+        for (i = x; i < pParam->OriginalCount; i += pParam->HorLocalCount)
+        {
+            if (i == iLost)
+                continue;
+            pInputs[n] = i;
+            pCoeffs[n++] = gf256_div(VerCoefficient(pParam, i), c);
+        }
+        pInputs[n] = pParam->OriginalCount + pParam->FirstVerRecoveryIndex + x;
+        pCoeffs[n++] = gf256_inv(c);
+    }
+    else if (recoveryIndex >= pParam->FirstHorRecoveryIndex && recoveryIndex < pParam->FirstHorRecoveryIndex + pParam->VerLocalCount)
+    {
+        short y = recoveryIndex - pParam->FirstHorRecoveryIndex;
+        for (i = y * pParam->HorLocalCount; i < y * pParam->HorLocalCount + HorGroupCount(pParam, y); i++)
+        {
+            pInputs[n] = i;
+            pCoeffs[n++] = 1;
+        }
+    }
+    else if (recoveryIndex >= pParam->FirstVerRecoveryIndex && recoveryIndex < pParam->FirstVerRecoveryIndex + pParam->HorLocalCount)
+    {
+        for (i = recoveryIndex - pParam->FirstVerRecoveryIndex; i < pParam->OriginalCount; i += pParam->HorLocalCount)
+        {
+            pInputs[n] = i;
+            pCoeffs[n++] = VerCoefficient(pParam, i);
+        }
+    }
+    else
+    {
+        /* Local recovery shard for global recovery shards is their XOR, so is each of them with the others */
+        for (i = pParam->FirstGlobalRecoveryIndex; i <= pParam->LocalRecoveryOfGlobalRecoveryIndex; i++)
+        {
+            if (pParam->OriginalCount + i == iLost)
+                continue;
+            pInputs[n] = pParam->OriginalCount + i;
+            pCoeffs[n++] = 1;
+        }
+    }
+    return n;
+}
 
-    return !cm256_decode(params, pDecoder->blocks);
+/*
+ * Rebuild the lost shard by the local group of a stage from the shards collected
+ * return: 1 rebuilt, <0 if something wrong
+ */
+static short RebuildByLocalGroup(Rebuilder *pRebuilder, RebuildStage stage)
+{
+    short i, n;
+    unsigned char inputs[MAXSHARDS];
+    uint8_t coeffs[MAXSHARDS];
+    const uint8_t *byOrder[MAXSHARDS] = {NULL};
+    const void *srcs[MAXSHARDS];
+    CM256LRC *pParam = &pRebuilder->param;
+
+    for (i = 0; i < pRebuilder->numShards; i++)
+        byOrder[pRebuilder->shards[i][0]] = pRebuilder->shards[i] + 1;
+    n = LocalRebuildInputs(pParam, pRebuilder->iLost, VER_REBUILD == stage, inputs, coeffs);
+    for (i = 0; i < n; i++)
+    {
+        if (NULL == byOrder[inputs[i]])
+            return -7;
+        srcs[i] = byOrder[inputs[i]];
+    }
+    gf256_dot_mem(pRebuilder->pRepairedData, coeffs, srcs, n, pParam->BlockBytes);
+    return 1;
+}
+
+/* Data of shard i without index byte, NULL if it is neither collected nor rebuilt yet */
+static const uint8_t *MultiShardData(const MultiRebuilder *pRebuilder, short i)
+{
+    if (NULL != pRebuilder->pRepaired[i])
+        return pRebuilder->bRebuilt[i] ? pRebuilder->pRepaired[i] : NULL;
+    return NULL != pRebuilder->shards[i] ? pRebuilder->shards[i] + 1 : NULL;
 }
 
 /*
- * Abandon a decode or rebuild process
+ * Plan the lost shards that local groups rebuild, each after the lost shards it is rebuilt from,
+ * so a lost shard becomes locally repairable once another one of its groups is rebuilt.
+ * Horizonal group is preferred for a lost original. Lost shards out of reach of local groups are left out
  */
-extern short LRC_FreeHandle(void *handle)
+static void PlanLocalRebuild(MultiRebuilder *pRebuilder)
 {
-    if (NULL == handle)
-        return false;
+    short i, j, n, v;
+    bool bProgress;
+    bool bPlanned[MAXSHARDS];
+    unsigned char inputs[MAXSHARDS];
+    uint8_t coeffs[MAXSHARDS];
+    CM256LRC *pParam = &pRebuilder->param;
 
-    DecoderLRC *pDecoder = handle;
-    if (DECODE_MAGIC == pDecoder->magic)
+    memcpy(bPlanned, pRebuilder->bRebuilt, sizeof(bPlanned));
+    pRebuilder->numPlan = 0;
+    do
     {
-        if (NULL != pDecoder->pBuffer)
-            free(pDecoder->pBuffer);
-        free(pDecoder);
-        return true;
+        bProgress = false;
+        for (i = 0; i < pRebuilder->numLost; i++)
+        {
+            short iLost = pRebuilder->lost[i];
+            for (v = 0; !bPlanned[iLost] && v <= (iLost < pParam->OriginalCount ? 1 : 0); v++)
+            {
+                n = LocalRebuildInputs(pParam, iLost, v, inputs, coeffs);
+                for (j = 0; j < n; j++)
+                {
+                    /* A lost shard helps only after it is rebuilt */
+                    if (LOST == pRebuilder->shardStatus[inputs[j]] && !bPlanned[inputs[j]])
+                        break;
+                }
+                if (n <= 0 || j < n)
+                    continue;
+                pRebuilder->plan[pRebuilder->numPlan++] = iLost;
+                pRebuilder->bVer[iLost] = v;
+                bPlanned[iLost] = true;
+                bProgress = true;
+            }
+        }
+    } while (bProgress);
+}
+
+/* Rebuild each lost shard of the plan whose shards are all there, in the order of the plan */
+static void RunLocalRebuild(MultiRebuilder *pRebuilder)
+{
+    short i, j, n;
+    unsigned char inputs[MAXSHARDS];
+    uint8_t coeffs[MAXSHARDS];
+    const void *data[MAXSHARDS];
+    CM256LRC *pParam = &pRebuilder->param;
+    for (i = 0; i < pRebuilder->numPlan; i++)
+    {
+        short iLost = pRebuilder->plan[i];
+        if (pRebuilder->bRebuilt[iLost])
+            continue;
+        n = LocalRebuildInputs(pParam, iLost, pRebuilder->bVer[iLost], inputs, coeffs);
+        for (j = 0; j < n && NULL != (data[j] = MultiShardData(pRebuilder, inputs[j])); j++)
+            ;
+        if (j < n)
+            continue;
+        gf256_dot_mem(pRebuilder->pRepaired[iLost], coeffs, data, n, pParam->BlockBytes);
+        pRebuilder->bRebuilt[iLost] = true;
+        pRebuilder->numRebuilt++;
     }
+}
 
-    Rebuilder *pRebuilder = handle;
-    if (REBUILD_MAGIC == pRebuilder->magic)
+/*
+ * Rebuild the lost shards left once the global decode has all the originals they depend on
+ * return: 1 success, <0 error
+ */
+static short FinishGlobalMultiRebuild(MultiRebuilder *pRebuilder)
+{
+    short i;
+    CM256LRC *pParam = &pRebuilder->param;
+    for (i = 0; i < pRebuilder->numLost; i++)
     {
-        if (NULL != pRebuilder->pDecoder)
-            LRC_FreeHandle(pRebuilder->pDecoder);
-        if (NULL != pRebuilder->pDecodedData)
-            free(pRebuilder->pDecodedData);
-        free(pRebuilder);
-        return true;
+        short iLost = pRebuilder->lost[i];
+        if (pRebuilder->bRebuilt[iLost] || iLost >= pParam->OriginalCount)
+            continue;
+        const uint8_t *pDecoded = LRC_GetDecodedShard(pRebuilder->pDecoder, iLost);
+        if (NULL == pDecoded)
+            return -7;
+        if (pDecoded != pRebuilder->pRepaired[iLost])
+            memcpy(pRebuilder->pRepaired[iLost], pDecoded, pParam->BlockBytes);
+        pRebuilder->bRebuilt[iLost] = true;
+        pRebuilder->numRebuilt++;
     }
 
-    return false;
+    /* Recovery shards after the originals, which may be rebuilt ones */
+    for (i = 0; i < pRebuilder->numLost; i++)
+    {
+        short iLost = pRebuilder->lost[i];
+        if (pRebuilder->bRebuilt[iLost])
+            continue;
+        if (EncodeRecoveryShard(pParam, pRebuilder->pDecoder, iLost, pRebuilder->pRepaired[iLost], pRebuilder->pDecodedData) != 0)
+            return -6;
+        pRebuilder->bRebuilt[iLost] = true;
+        pRebuilder->numRebuilt++;
+    }
+    return 1;
 }
 
-short GetHorLocalCount(short originalCount)
+/*
+ * Give the global decode every collected or rebuilt shard it has not got
+ * return: 1 if rebuilding is done, 0 if more shards required, <0 error
+ */
+static short FeedGlobalMultiRebuild(MultiRebuilder *pRebuilder)
 {
-    return originalCount >= 64 ? 8 : sqrt(originalCount);
+    short i;
+    CM256LRC *pParam = &pRebuilder->param;
+    for (i = 0; i < pParam->OriginalCount + pParam->TotalRecoveryCount; i++)
+    {
+        const uint8_t *pData = MultiShardData(pRebuilder, i);
+        if (NULL == pData || pRebuilder->bFed[i])
+            continue;
+        pRebuilder->bFed[i] = true;
+        if (LRC_Decode(pRebuilder->pDecoder, pData - 1) > 0) // With index byte
+            return FinishGlobalMultiRebuild(pRebuilder);
+    }
+    return 0;
 }
 
-void InitialParam(CM256LRC *pParam, unsigned short originalCount, unsigned shardSize, bool bIndexByte)
+/*
+ * Begin the global decode for the lost shards that local groups do not rebuild, for only the originals they depend on
+ * return: 1 if rebuilding is done, 0 if more shards required, <0 error
+ */
+static short BeginGlobalMultiRebuild(MultiRebuilder *pRebuilder)
 {
-    pParam->bIndexByte = bIndexByte;
-    pParam->BlockBytes = bIndexByte ? shardSize - 1 : shardSize;
-    pParam->OriginalCount = originalCount;
-    pParam->GlobalRecoveryCount = globalRecoveryCount;
-    pParam->HorLocalCount = GetHorLocalCount(originalCount);
-    pParam->VerLocalCount = (originalCount + pParam->HorLocalCount - 1) / pParam->HorLocalCount;
-    pParam->TotalOriginalCount = pParam->HorLocalCount * pParam->VerLocalCount;
-    pParam->FirstHorRecoveryIndex = 0;
-    pParam->FirstVerRecoveryIndex = pParam->VerLocalCount;
-    pParam->FirstGlobalRecoveryIndex = pParam->VerLocalCount + pParam->HorLocalCount;
-    pParam->LocalRecoveryOfGlobalRecoveryIndex = pParam->FirstGlobalRecoveryIndex + pParam->GlobalRecoveryCount;
-    pParam->TotalRecoveryCount = pParam->LocalRecoveryOfGlobalRecoveryIndex + 1;
+    short i;
+    bool bWanted[MAXSHARDS];
+    CM256LRC *pParam = &pRebuilder->param;
+
+    memset(bWanted, 0, sizeof(bWanted));
+    for (i = 0; i < pRebuilder->numLost; i++)
+    {
+        if (!pRebuilder->bRebuilt[pRebuilder->lost[i]])
+            MarkDependencies(pParam, pRebuilder->lost[i], bWanted);
+    }
+    pRebuilder->pDecoder = BeginRebuildDecode(pParam, bWanted, pRebuilder->pRepaired, &pRebuilder->pDecodedData);
+    if (NULL == pRebuilder->pDecoder)
+        return NULL == pRebuilder->pDecodedData ? -4 : -5;
+    return FeedGlobalMultiRebuild(pRebuilder);
 }
 
 /*
- * Begin a rebuild process
+ * Begin a rebuild process for several lost shards of one stripe, each fetched shard is used for all of them
  * originalCount: number of shards of original data
- * iLost: order of lost shard
+ * pLost: orders of lost shards
+ * numLost: number of lost shards
  * shardSize: size of each shard
- * pData: the buffer for rebuilt shard, at least shardSize length
+ * pData: the buffer for each rebuilt shard, at least shardSize length
  * return: handle of rebuild process, NULL fails
  */
-extern void *LRC_BeginRebuild(unsigned short originalCount, unsigned short iLost, unsigned long shardSize, void *pData)
+extern void *LRC_BeginRebuildMulti(unsigned short originalCount, const unsigned char *pLost, unsigned short numLost, unsigned long shardSize, void *pData[])
 {
     short j;
     CM256LRC param;
-    if (originalCount <= 0 || originalCount >= MAXSHARDS)
+    if (originalCount <= 0 || originalCount >= MAXSHARDS || NULL == pLost || NULL == pData || numLost <= 0)
         return NULL;
     InitialParam(&param, originalCount, shardSize, true);
-    if (iLost >= originalCount + param.TotalRecoveryCount)
+    if (numLost > originalCount + param.TotalRecoveryCount)
         return NULL;
 
-    Rebuilder *pRebuilder = malloc(sizeof(Rebuilder));
+    MultiRebuilder *pRebuilder = malloc(sizeof(MultiRebuilder));
     if (NULL == pRebuilder)
         return NULL;
-    pRebuilder->magic = REBUILD_MAGIC;
-    pRebuilder->iLost = iLost;
-    pRebuilder->pDecoder = NULL;
-    pRebuilder->stage = INIT_REBUILD;
-    pRebuilder->pRepairedData = pData;
-    *pRebuilder->pRepairedData++ = iLost; // Index byte
-
+    pRebuilder->magic = MULTI_REBUILD_MAGIC;
+    pRebuilder->param = param;
     memset(pRebuilder->shardStatus, UNKNOWN, sizeof(pRebuilder->shardStatus));
-    pRebuilder->shardStatus[iLost] = LOST;
+    memset(pRebuilder->bRebuilt, 0, sizeof(pRebuilder->bRebuilt));
+    memset(pRebuilder->bFed, 0, sizeof(pRebuilder->bFed));
     for (j = 0; j < MAXSHARDS; j++)
+    {
         pRebuilder->shards[j] = NULL;
-    pRebuilder->numShards = 0;
+        pRebuilder->pRepaired[j] = NULL;
+    }
+    for (j = 0; j < numLost; j++)
+    {
+        if (pLost[j] >= originalCount + param.TotalRecoveryCount || NULL == pData[j] || NULL != pRebuilder->pRepaired[pLost[j]])
+        {
+            free(pRebuilder);
+            return NULL;
+        }
+        pRebuilder->lost[j] = pLost[j];
+        pRebuilder->shardStatus[pLost[j]] = LOST;
+        *(uint8_t *)pData[j] = pLost[j]; // Index byte
+        pRebuilder->pRepaired[pLost[j]] = (uint8_t *)pData[j] + 1;
+    }
+    pRebuilder->numLost = numLost;
+    pRebuilder->numRebuilt = 0;
+    pRebuilder->numPlan = 0;
+    pRebuilder->pDecoder = NULL;
     pRebuilder->pDecodedData = NULL;
-    pRebuilder->param = param;
 
     return pRebuilder;
 }
 
+/*
+ * All lost shards are rebuilt from the shards at hand, request one of them again so that LRC_OneShardForRebuild reports it
+ * return: number of shards in new list
+ */
+static short RequestAgain(MultiRebuilder *pRebuilder, unsigned char *pList)
+{
+    short i;
+    CM256LRC *pParam = &pRebuilder->param;
+    for (i = 0; i < pParam->OriginalCount + pParam->TotalRecoveryCount; i++)
+    {
+        if (EXISTED == pRebuilder->shardStatus[i])
+        {
+            pRebuilder->shardStatus[i] = REQUEST;
+            pList[0] = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Next shard list of a multi-shard rebuild: the shards that the plan of local groups still needs,
+ * or all shards left once some lost shard is out of reach of local groups
+ * return: number of shards in new list. 0 if no way to rebuild, <0 if something wrong
+ */
+static short NextMultiRequestList(MultiRebuilder *pRebuilder, unsigned char *pList)
+{
+    short i, j, n, numRequest = 0;
+    unsigned char inputs[MAXSHARDS];
+    uint8_t coeffs[MAXSHARDS];
+    CM256LRC *pParam = &pRebuilder->param;
+    short numShards = pParam->OriginalCount + pParam->TotalRecoveryCount;
+
+    if (NULL != pRebuilder->pDecoder && pRebuilder->numRebuilt < pRebuilder->numLost)
+        return 0; // All shards have been requested
+    for (i = 0; i < numShards; i++)
+    {
+        if (REQUEST == pRebuilder->shardStatus[i])
+            pRebuilder->shardStatus[i] = LOST;
+    }
+    if (pRebuilder->numRebuilt >= pRebuilder->numLost)
+        return RequestAgain(pRebuilder, pList);
+
+    PlanLocalRebuild(pRebuilder);
+    if (pRebuilder->numRebuilt + pRebuilder->numPlan < pRebuilder->numLost)
+    {
+        short numMissed = 0;
+        for (i = 0; i < numShards; i++)
+        {
+            if (UNKNOWN == pRebuilder->shardStatus[i])
+                pList[numRequest++] = i;
+            else if (LOST == pRebuilder->shardStatus[i] && !pRebuilder->bRebuilt[i])
+                numMissed++;
+        }
+        if (numMissed > pParam->TotalRecoveryCount)
+            return 0; // Unable to repair
+        RunLocalRebuild(pRebuilder);
+        n = BeginGlobalMultiRebuild(pRebuilder);
+        if (n < 0)
+            return n;
+    }
+    else
+    {
+        for (i = 0; i < pRebuilder->numPlan; i++)
+        {
+            n = LocalRebuildInputs(pParam, pRebuilder->plan[i], pRebuilder->bVer[pRebuilder->plan[i]], inputs, coeffs);
+            for (j = 0; j < n; j++)
+            {
+                if (UNKNOWN == pRebuilder->shardStatus[inputs[j]])
+                {
+                    pRebuilder->shardStatus[inputs[j]] = REQUEST;
+                    pList[numRequest++] = inputs[j];
+                }
+            }
+        }
+        RunLocalRebuild(pRebuilder);
+    }
+
+    for (i = 0; i < numRequest; i++)
+        pRebuilder->shardStatus[pList[i]] = pRebuilder->numRebuilt >= pRebuilder->numLost ? UNKNOWN : REQUEST;
+    if (pRebuilder->numRebuilt >= pRebuilder->numLost)
+        return RequestAgain(pRebuilder, pList);
+    return numRequest;
+}
+
+/*
+ * One shard for a multi-shard rebuild
+ * return: >0 if all lost shards are rebuilt, 0 if more shards required, <0 if something wrong
+ */
+static short OneShardForMultiRebuild(MultiRebuilder *pRebuilder, const uint8_t *pShard)
+{
+    CM256LRC *pParam = &pRebuilder->param;
+    uint8_t index = *pShard;
+    if (index >= pParam->OriginalCount + pParam->TotalRecoveryCount)
+        return -2;
+    if (REQUEST != pRebuilder->shardStatus[index])
+        return -3;
+    pRebuilder->shardStatus[index] = EXISTED;
+    pRebuilder->shards[index] = pShard;
+
+    RunLocalRebuild(pRebuilder);
+    if (pRebuilder->numRebuilt < pRebuilder->numLost && NULL != pRebuilder->pDecoder)
+        return FeedGlobalMultiRebuild(pRebuilder);
+    return pRebuilder->numRebuilt >= pRebuilder->numLost ? 1 : 0;
+}
+
 /*
  * Get next shard list for rebuild the lost shard. 
  * Invoking this function means the remaning shards of last list are lost.
@@ -636,96 +2545,32 @@ extern short LRC_NextRequestList(void *handle, unsigned char *pList)
         return -1;
 
     Rebuilder *pRebuilder = handle;
+    if (MULTI_REBUILD_MAGIC == pRebuilder->magic)
+        return NextMultiRequestList(handle, pList);
     if (REBUILD_MAGIC != pRebuilder->magic)
         return -2;
 
-    CM256LRC *pParam = &pRebuilder->param;
-    short iLost = pRebuilder->iLost;
+    if (pRebuilder->bCosts)
+        return NextCheapestRequestList(pRebuilder, pList);
+
+    RebuildStage stages[2];
     switch (pRebuilder->stage)
     {
     case INIT_REBUILD:
-        if (iLost < pParam->OriginalCount)
-        {
-            /* Original shard */
-            pRebuilder->stage = HOR_REBUILD;
-            numRequest = 0;
-            short y = iLost / pParam->HorLocalCount;
-            short n = y * pParam->HorLocalCount;
-            for (j = 0; j < pParam->HorLocalCount; j++)
-            {
-                if (n + j == iLost)
-                    pList[numRequest++] = pParam->OriginalCount + pParam->FirstHorRecoveryIndex + y; // Horizonal local recovery shard
-                else if (n + j < pParam->OriginalCount)
-                    pList[numRequest++] = n + j;
-            }
-            pRebuilder->remainShards = numRequest;
-        }
-        else
+        if (pRebuilder->bHedged)
         {
-            short recoveryIndex = iLost - pParam->OriginalCount;
-            if (recoveryIndex >= pParam->FirstHorRecoveryIndex && recoveryIndex < pParam->FirstHorRecoveryIndex + pParam->VerLocalCount)
-            {
-                /* One of horizonal recovery shards */
-                pRebuilder->stage = HOR_RECOVERY_REBUILD;
-                numRequest = 0;
-                short y = recoveryIndex - pParam->FirstHorRecoveryIndex;
-                short n = y * pParam->HorLocalCount;
-                for (j = 0; j < pParam->HorLocalCount && n + j < pParam->OriginalCount; j++)
-                    pList[numRequest++] = n + j;
-                pRebuilder->remainShards = numRequest;
-            }
-            else if (recoveryIndex >= pParam->FirstVerRecoveryIndex && recoveryIndex < pParam->FirstVerRecoveryIndex + pParam->HorLocalCount)
-            {
-                /* One of vertical recovery shards */
-                pRebuilder->stage = VER_RECOVERY_REBUILD;
-                pRebuilder->remainShards = numRequest = pParam->VerLocalCount;
-                short x = recoveryIndex - pParam->FirstVerRecoveryIndex;
-                numRequest = 0;
-                for (j = 0; j < pParam->VerLocalCount; j++)
-                {
-                    short iRequest = j * pParam->HorLocalCount + x;
-                    if (iRequest < pParam->OriginalCount)
-                        pList[numRequest++] = iRequest;
-                }
-                pRebuilder->remainShards = numRequest;
-            }
-            else if ((recoveryIndex >= pParam->FirstGlobalRecoveryIndex && recoveryIndex < pParam->FirstGlobalRecoveryIndex + pParam->GlobalRecoveryCount) || recoveryIndex == pParam->LocalRecoveryOfGlobalRecoveryIndex)
-            {
-                /* One of global recovery shard */
-                pRebuilder->stage = GLOBAL_RECOVERY_REBUILD;
-                pRebuilder->remainShards = numRequest = pParam->GlobalRecoveryCount;
-                short n = pParam->OriginalCount + pParam->FirstGlobalRecoveryIndex;
-                for (j = 0; j < pParam->GlobalRecoveryCount; j++)
-                {
-                    if (n + j == iLost)
-                        pList[j] = pParam->OriginalCount + pParam->LocalRecoveryOfGlobalRecoveryIndex;
-                    else
-                        pList[j] = n + j;
-                }
-            }
-            else
-                return -2; // Impossible branch, because the value of index has been checked above
+            numRequest = BeginHedgedStage(pRebuilder, pList);
+            break;
         }
-        memset(pRebuilder->pRepairedData, 0, pRebuilder->param.BlockBytes);
+        LocalStages(&pRebuilder->param, pRebuilder->iLost, stages);
+        numRequest = BeginLocalStage(pRebuilder, stages[0], pList);
         break;
 
     case HOR_REBUILD:
-        pRebuilder->stage = VER_REBUILD;
-        unsigned short x = pRebuilder->iLost % pRebuilder->param.HorLocalCount;
-        unsigned short index = x;
-        numRequest = 0;
-        for (i = 0; i < pRebuilder->param.VerLocalCount; i++)
-        {
-            if (index == pRebuilder->iLost)
-                pList[numRequest++] = pRebuilder->param.OriginalCount + pRebuilder->param.FirstVerRecoveryIndex + x;
-            else if (index < pParam->OriginalCount)
-                pList[numRequest++] = index;
-            index += pRebuilder->param.HorLocalCount;
-        }
-        pRebuilder->remainShards = numRequest;
-        memset(pRebuilder->pRepairedData, 0, pRebuilder->param.BlockBytes);
+        numRequest = BeginLocalStage(pRebuilder, VER_REBUILD, pList);
         break;
 
+    case HEDGED_REBUILD:
     case VER_REBUILD:
     case HOR_RECOVERY_REBUILD:
     case VER_RECOVERY_REBUILD:
@@ -751,18 +2596,23 @@ extern short LRC_NextRequestList(void *handle, unsigned char *pList)
                 pList[numRequest++] = j;
         }
 
-        pRebuilder->pDecodedData = malloc((pRebuilder->param.TotalOriginalCount + 1) * pRebuilder->param.BlockBytes); // Last block is reserved for figuring local recovery shard for global recovery shards
-        if (NULL == pRebuilder->pDecodedData)
-            return -4;
-        pRebuilder->pDecoder = LRC_BeginDecode(pRebuilder->param.OriginalCount, pRebuilder->param.BlockBytes + 1, pRebuilder->pDecodedData);
-        if (NULL == pRebuilder->pDecoder)
-            return -5;
-        for (i = 0; i < pRebuilder->numShards; i++)
-            LRC_Decode(pRebuilder->pDecoder, pRebuilder->shards[i]);
+        pRebuilder->triedStages |= 1 << GLOBAL_REBUILD;
+        j = RebuildByGlobal(pRebuilder, 0 == numRequest);
+        if (j < 0)
+            return j;
+        if (j > 0)
+            return RequestRebuilt(pRebuilder, pList);
         break;
 
     case GLOBAL_REBUILD:
-        return 0; // No way to rebuild
+        /* The shards at hand are the last chance */
+        j = RebuildByGlobal(pRebuilder, true);
+        if (j <= 0)
+            return j; // No way to rebuild
+        return RequestRebuilt(pRebuilder, pList);
+
+    case DONE_REBUILD:
+        return RequestRebuilt(pRebuilder, pList);
 
     default:
         return -3;
@@ -772,6 +2622,45 @@ extern short LRC_NextRequestList(void *handle, unsigned char *pList)
     return numRequest;
 }
 
+/*
+ * Set the cost of fetching each shard for a rebuild process
+ * return: 0 success, <0 if something wrong
+ */
+extern short LRC_SetRebuildCosts(void *handle, const unsigned short *pCosts)
+{
+    if (NULL == handle || NULL == pCosts)
+        return -1;
+    Rebuilder *pRebuilder = handle;
+    if (REBUILD_MAGIC != pRebuilder->magic)
+        return -2;
+
+    memcpy(pRebuilder->costs, pCosts, (pRebuilder->param.OriginalCount + pRebuilder->param.TotalRecoveryCount) * sizeof(unsigned short));
+    pRebuilder->bCosts = true;
+    return 0;
+}
+
+/*
+ * Hedge the requests of a rebuild process of LRC_BeginRebuild: the local stages of the lost shard are requested at
+ * once, e.g. both the horizonal and the vertical group of a lost original, and the first group that has all arrived
+ * rebuilds it. With costs, the global decode requests numSpare more shards beyond the cheapest enough ones
+ * and finishes as soon as any enough of them have arrived
+ * return: 0 success, <0 if something wrong
+ */
+extern short LRC_SetRebuildHedge(void *handle, short numSpare)
+{
+    if (NULL == handle || numSpare < 0)
+        return -1;
+    Rebuilder *pRebuilder = handle;
+    if (REBUILD_MAGIC != pRebuilder->magic)
+        return -2;
+    if (INIT_REBUILD != pRebuilder->stage)
+        return -3;
+
+    pRebuilder->bHedged = true;
+    pRebuilder->numSpare = numSpare;
+    return 0;
+}
+
 /*
  * Provide one shard for rebuilding lost shards
  * handle: handle of rebuild process
@@ -781,10 +2670,12 @@ extern short LRC_NextRequestList(void *handle, unsigned char *pList)
 extern short LRC_OneShardForRebuild(void *handle, const void *pShardData)
 {
     short i = 0;
-    uint8_t matrixElement;
+    uint8_t c;
     if (NULL == handle || NULL == pShardData)
         return -1;
     Rebuilder *pRebuilder = handle;
+    if (MULTI_REBUILD_MAGIC == pRebuilder->magic)
+        return OneShardForMultiRebuild(handle, pShardData);
     if (REBUILD_MAGIC != pRebuilder->magic)
         return -1;
 
@@ -797,7 +2688,14 @@ extern short LRC_OneShardForRebuild(void *handle, const void *pShardData)
     if (REQUEST != pRebuilder->shardStatus[index])
         return -3;
     pRebuilder->shardStatus[index] = EXISTED;
+    if (DONE_REBUILD == pRebuilder->stage)
+        return 1; // Rebuilt already
     pRebuilder->shards[pRebuilder->numShards++] = pShard++; // pShard skips index byte
+    PutShard(pParam, &pRebuilder->have, index, true);
+    if (index < pParam->OriginalCount)
+        pRebuilder->numOriginalsAtHand++;
+    else
+        pRebuilder->numRecoveryAtHand++;
     switch (pRebuilder->stage)
     {
     case HOR_REBUILD:
@@ -810,128 +2708,30 @@ extern short LRC_OneShardForRebuild(void *handle, const void *pShardData)
         break;
 
     case VER_REBUILD:
+        /* Fold in each shard as it arrives, the vertical recovery shard is the sum of c_i * original_i solved for the lost one */
+        c = VerCoefficient(pParam, pRebuilder->iLost);
+        gf256_muladd_mem(pRebuilder->pRepairedData, index < pParam->OriginalCount ? gf256_div(VerCoefficient(pParam, index), c) : gf256_inv(c), pShard, blockBytes);
         if (--pRebuilder->remainShards <= 0)
-        {
-            /* Enough to recover */
-            assert(pRebuilder->numShards >= pParam->VerLocalCount - 1);
-            CM256Block blocks[MAXSHARDS];
-            unsigned short x = pRebuilder->iLost % pParam->HorLocalCount;
-            unsigned short verRecoveryIndex = VER_RECOVERY_INDEX(pParam, x);
-            for (i = 0; i < pRebuilder->numShards; i++)
-            {
-                uint8_t j = pRebuilder->shards[i][0];
-                if (j < pParam->OriginalCount)
-                {
-                    /* Original shard */
-                    blocks[j].lrcIndex = blocks[j].decodeIndex = j;
-                    blocks[j].pData = (uint8_t *)pRebuilder->shards[i] + 1;
-                }
-                else if (j - pParam->OriginalCount + pParam->TotalOriginalCount == verRecoveryIndex)
-                {
-                    /* Vertical recovery shard for lost shard */
-                    blocks[pRebuilder->iLost].lrcIndex = verRecoveryIndex;
-                    blocks[pRebuilder->iLost].decodeIndex = pParam->TotalOriginalCount + 1;
-                    blocks[pRebuilder->iLost].pData = pRebuilder->pRepairedData;
-                    memcpy(pRebuilder->pRepairedData, (uint8_t *)pRebuilder->shards[i] + 1, pParam->BlockBytes);
-                }
-            }
-            cm256_encoder_params params;
-            params.BlockBytes = pParam->BlockBytes;
-            params.TotalOriginalCount = pParam->TotalOriginalCount;
-            params.FirstElement = x;
-            if (0 == (pParam->OriginalCount % pParam->HorLocalCount) || x < (pParam->OriginalCount % pParam->HorLocalCount))
-                params.OriginalCount = pParam->VerLocalCount;
-            else
-                params.OriginalCount = pParam->VerLocalCount - 1;
-            params.RecoveryCount = 1;
-            params.Step = pParam->HorLocalCount;
+            return 1;
+        break;
 
-            if (cm256_decode(params, blocks) == 0)
-                return 1;
-            else
-                return -7;
+    case HEDGED_REBUILD:
+        for (i = 0; i < pRebuilder->numHedged; i++)
+        {
+            if ((pRebuilder->hedgedOf[index] & (1 << i)) && --pRebuilder->hedgedRemain[i] <= 0)
+                return RebuildByLocalGroup(pRebuilder, pRebuilder->hedgedStages[i]);
         }
         break;
 
     case VER_RECOVERY_REBUILD:
-        matrixElement = GetMatrixElement(pParam->TotalOriginalCount + 1, pParam->TotalOriginalCount, index);
-        gf256_muladd_mem(pRebuilder->pRepairedData, matrixElement, pShard, pParam->BlockBytes);
+        gf256_muladd_mem(pRebuilder->pRepairedData, VerCoefficient(pParam, index), pShard, blockBytes);
         if (--pRebuilder->remainShards <= 0)
             return 1;
         break;
 
     case GLOBAL_REBUILD:
-        if (LRC_Decode(pRebuilder->pDecoder, pShardData) <= 0)
-            break;
-        /* Recovered original data */
-        if (pRebuilder->iLost < pParam->OriginalCount)
-        {
-            /* Lost one of original shards */
-            memcpy(pRebuilder->pRepairedData, pRebuilder->pDecodedData + pRebuilder->iLost * blockBytes, blockBytes);
-            return 1;
-        }
-        /* Lost one of recovery shards */
-        short recoveryIndex = pRebuilder->iLost - pParam->OriginalCount;
-        memset(pRebuilder->pDecodedData + pParam->OriginalCount * blockBytes, 0, (pParam->TotalOriginalCount - pParam->OriginalCount) * blockBytes);
-        if (recoveryIndex >= pParam->FirstHorRecoveryIndex && recoveryIndex < pParam->FirstHorRecoveryIndex + pParam->VerLocalCount)
-        {
-            /* Horizonal recovery shard */
-            uint8_t *pData = pRebuilder->pDecodedData + (recoveryIndex - pParam->FirstHorRecoveryIndex) * pParam->HorLocalCount * blockBytes;
-            gf256_addset_mem(pRebuilder->pRepairedData, pData, pData + blockBytes, blockBytes);
-            pData += 2 * blockBytes;
-            for (i = 2; i < pParam->HorLocalCount; i++)
-            {
-                gf256_add_mem(pRebuilder->pRepairedData, pData, blockBytes);
-                pData += blockBytes;
-            }
-            return 1;
-        }
-        CM256Block blocks[MAXSHARDS];
-        for (i = 0; i < pParam->TotalOriginalCount; i++)
-        {
-            blocks[i].pData = pRebuilder->pDecodedData + i * blockBytes;
-            blocks[i].lrcIndex = i;
-            blocks[i].decodeIndex = i;
-        }
-
-        cm256_encoder_params cmParam;
-        cmParam.TotalOriginalCount = pParam->TotalOriginalCount;
-        cmParam.BlockBytes = pParam->BlockBytes;
-        if (recoveryIndex >= pParam->FirstVerRecoveryIndex && recoveryIndex < pParam->FirstVerRecoveryIndex + pParam->HorLocalCount)
-        {
-            /* One of vertical recovery shards */
-            cmParam.OriginalCount = pParam->VerLocalCount;
-            cmParam.Step = pParam->HorLocalCount;
-            cmParam.RecoveryCount = 1;
-            cmParam.FirstElement = recoveryIndex - pParam->FirstVerRecoveryIndex;
-            CM256EncodeBlock(cmParam, blocks, cmParam.TotalOriginalCount + 1, pRebuilder->pRepairedData);
-            return 1;
-        }
-        cmParam.OriginalCount = pParam->OriginalCount;
-        cmParam.RecoveryCount = pParam->GlobalRecoveryCount;
-        cmParam.FirstElement = 0;
-        cmParam.Step = 1;
-        if (recoveryIndex >= pParam->FirstGlobalRecoveryIndex && recoveryIndex < pParam->FirstGlobalRecoveryIndex + pParam->GlobalRecoveryCount)
-        {
-            /* One of global recovery shard */
-            /* 1st recovery matrix is used for horizon recovery, 2nd matrix is used for vertical recovery, global recovery start from 2 */
-            CM256EncodeBlock(cmParam, blocks, cmParam.TotalOriginalCount + recoveryIndex - pParam->FirstGlobalRecoveryIndex + 2, pRebuilder->pRepairedData);
-            return 1;
-        }
-        if (recoveryIndex == pParam->LocalRecoveryOfGlobalRecoveryIndex)
-        {
-            /* Local recovery shard for global recovery shards */
-            uint8_t *pGlobalRecovery = pRebuilder->pDecodedData + cmParam.TotalOriginalCount * blockBytes; // Space reserved for now
-            memset(pRebuilder->pRepairedData, 0, blockBytes);
-            for (i = 0; i < pParam->GlobalRecoveryCount; i++)
-            {
-                /* 1st recovery matrix is used for horizon recovery, 2nd matrix is used for vertical recovery, global recovery start from 2 */
-                CM256EncodeBlock(cmParam, blocks, cmParam.TotalOriginalCount + i + 2, pGlobalRecovery); // Recover one global recovery shard
-                gf256_add_mem(pRebuilder->pRepairedData, pGlobalRecovery, blockBytes);
-            }
-            return 1;
-        }
-        return -6; // Impossible branch
+        for (i = 0; i < pParam->OriginalCount + pParam->TotalRecoveryCount && REQUEST != pRebuilder->shardStatus[i]; i++);
+        return RebuildByGlobal(pRebuilder, i >= pParam->OriginalCount + pParam->TotalRecoveryCount); // All of the list arrived, whatever they are
 
     default:
         return -5;
@@ -47,6 +47,80 @@ short LRC_Initial(short globalRecoveryCount);
  */
 short LRC_Encode(const void *originalShards[], unsigned short originalCount, unsigned long shardSize, void *pRecoveryData);
 
+/*
+ * Encode original data with up to numThreads threads, output is the same as LRC_Encode
+ * numThreads: number of threads including the calling one. Each thread encodes a disjoint byte range of all shards,
+ *             the library never runs more worker threads than there are cores, for all callers together
+ * return: number of recovery shards, <=0 fails
+ */
+short LRC_EncodeParallel(const void *originalShards[], unsigned short originalCount, unsigned long shardSize, void *pRecoveryData, short numThreads);
+
+/*
+ * Encode a batch of stripes with the same originalCount and shardSize in one call, output of each stripe is the same as LRC_Encode
+ * originalShards: stripeCount arrays of originalCount shards, 1st byte of each shard is its index
+ * stripeCount: number of stripes
+ * pRecoveryData: stripeCount buffers, each one required at least MAXRECOVERYSHARDS*shardSize space for recovery shards of the stripe
+ * numThreads: number of threads including the calling one, each one encodes a disjoint set of stripes
+ * return: number of recovery shards of each stripe, <=0 fails
+ */
+short LRC_EncodeBatch(const void **originalShards[], unsigned short stripeCount, unsigned short originalCount, unsigned long shardSize, void *pRecoveryData[], short numThreads);
+
+/*
+ * Build an encode plan for stripes of originalCount shards, with the global recovery count given to LRC_Initial.
+ * The plan holds the geometry and all matrix elements, it is read-only and may be shared by threads.
+ * originalCount: number of shards of original data
+ * return: handle of the plan, NULL fails. Free it by LRC_FreeHandle
+ */
+void *LRC_CreateEncodePlan(unsigned short originalCount);
+
+/*
+ * Encode original data with a plan, without per-call setup or allocation. Output is the same as LRC_Encode
+ * hPlan: handle from LRC_CreateEncodePlan
+ * originalShards: the originalCount shards of the plan, 1st byte of each shard is its index
+ * shardSize: size of each shard
+ * pRecoveryData: required at least MAXRECOVERYSHARDS*shardSize space, return recovery shards after encoding,
+ *                the leading byte of each shard is index of this shard
+ * return: number of recovery shards, <=0 fails
+ */
+short LRC_EncodeWithPlan(const void *hPlan, const void *originalShards[], unsigned long shardSize, void *pRecoveryData);
+
+/*
+ * Encode original data with a plan and up to numThreads threads, as LRC_EncodeParallel
+ * return: number of recovery shards, <=0 fails
+ */
+short LRC_EncodeWithPlanParallel(const void *hPlan, const void *originalShards[], unsigned long shardSize, void *pRecoveryData, short numThreads);
+
+/*
+ * Begin of new incremental encode process, for original shards that arrive one at a time
+ * originalCount: number of shards of original data
+ * shardSize: size of each shard in byte including index byte
+ * pRecoveryData: required at least MAXRECOVERYSHARDS*shardSize space, return recovery shards after all original shards are encoded,
+ *                the leading byte of each shard is index of this shard
+ * return: handle of this encode process, NULL fails. Free it by LRC_FreeHandle
+ */
+void *LRC_BeginEncode(unsigned short originalCount, unsigned long shardSize, void *pRecoveryData);
+
+/*
+ * Encode one original shard for specific encode process, in any order. The shard is folded into its horizonal,
+ * vertical and all global recovery shards at once, so its buffer can be released as soon as this function returns
+ * handle: handle of encode process
+ * pShard: data of this shard, 1st byte is its index
+ * return: 0 if more original shards are required, >0 number of recovery shards when all original shards are encoded, <0 error
+ */
+short LRC_OneShardForEncode(void *handle, const void *pShard);
+
+/*
+ * Update recovery shards in place after one original shard is rewritten. Only the horizonal and vertical
+ * recovery shards of that shard, the global recovery shards and their local recovery shard are changed
+ * originalCount: number of shards of original data
+ * shardSize: size of each shard
+ * pOldShard: old content of the shard, 1st byte is its index
+ * pNewShard: new content of the shard, 1st byte is its index
+ * pRecoveryData: recovery shards of the stripe as returned by LRC_Encode, updated in place
+ * return: number of recovery shards, <=0 fails
+ */
+short LRC_UpdateParity(unsigned short originalCount, unsigned long shardSize, const void *pOldShard, const void *pNewShard, void *pRecoveryData);
+
 /*
  * Begin of new decode process
  * originalCount: number of shards of original data
@@ -56,6 +130,19 @@ short LRC_Encode(const void *originalShards[], unsigned short originalCount, uns
  */
 void *LRC_BeginDecode(unsigned short originalCount, unsigned long shardSize, void *pData);
 
+/*
+ * Begin of new decode process for a byte range of the shards, e.g. a small read inside a shard.
+ * Shards given to LRC_Decode of this process are fragments: the index byte followed by
+ * bytes [offset, offset+length) of the shard data, the index byte excluded
+ * originalCount: number of shards of original data
+ * shardSize: size of each shard in byte including index byte
+ * offset: first byte of the range in shard data
+ * length: number of bytes of the range
+ * pData: require at least originalCount * length space, return the range of original data if success
+ * return: handle of this decode process, NULL fails
+ */
+void *LRC_BeginDecodeRange(unsigned short originalCount, unsigned long shardSize, unsigned long offset, unsigned long length, void *pData);
+
 /*
  * Decode one shard for specific decode process
  * handle: handle of decode process
@@ -64,6 +151,67 @@ void *LRC_BeginDecode(unsigned short originalCount, unsigned long shardSize, voi
  */
 short LRC_Decode(void *handle, const void *pShard);
 
+/*
+ * Decode only some original shards, call it before the first LRC_Decode of the process.
+ * LRC_Decode then succeeds as soon as these shards are collected or recovered, and only their
+ * places in pData are sure to hold original data. Like recovery shards, the other original shards
+ * given to LRC_Decode are not copied, they must be kept until the decode process ends
+ * handle: handle of decode process
+ * pList: indexes of wanted original shards
+ * count: number of indexes in pList
+ * return: 0 success, <0 error
+ */
+short LRC_SetDecodeWanted(void *handle, const unsigned char *pList, unsigned short count);
+
+/*
+ * Decode original shards into separate buffers instead of pData, call it before the first LRC_Decode of the process
+ * handle: handle of decode process
+ * pOutputs: buffer of each original shard, at least shardSize-1 bytes each. The list is copied, the buffers are
+ *           written until the decode process ends
+ * return: 0 success, <0 error
+ */
+short LRC_SetDecodeOutputs(void *handle, void *pOutputs[]);
+
+/*
+ * Leave original shards where LRC_Decode got them instead of copying them, call it before the first LRC_Decode
+ * of the process. Only missing original shards are written, to pData or the buffers of LRC_SetDecodeOutputs.
+ * Like recovery shards, the shards given to LRC_Decode must be kept until the decode process ends
+ * handle: handle of decode process
+ * return: 0 success, <0 error
+ */
+short LRC_SetDecodeBorrow(void *handle);
+
+/*
+ * Fold each original shard into the global recovery shards as it arrives, call it before the first LRC_Decode
+ * of the process. The work of global recovery is then spread over the shards, and the call that completes
+ * the collection mostly solves for the missing shards. It costs a copy of each global recovery shard, and
+ * the folding is wasted if no original shard turns out to be missing
+ * handle: handle of decode process
+ * numRows: number of global recovery shards, from the first, that originals are folded into before they
+ *          arrive, e.g. the number of shards expected to be lost when recovery shards are sent last.
+ *          Other global recovery shards get the originals so far folded in when they arrive
+ * return: 0 success, <0 error
+ */
+short LRC_SetDecodeProgressive(void *handle, short numRows);
+
+/*
+ * Get the data of one original shard after LRC_Decode succeeds, either in the shard given to LRC_Decode
+ * or in its output buffer. It is valid until the decode process ends
+ * handle: handle of decode process
+ * index: index of original shard
+ * return: data of the shard without index byte, NULL if it is neither collected nor recovered
+ */
+const void *LRC_GetDecodedShard(void *handle, unsigned short index);
+
+/*
+ * Set the most threads used when the collected shards are decoded by global recovery, default is 1.
+ * Threads of all processes together are kept below the number of cores
+ * handle: handle of decode process
+ * numThreads: number of threads including the calling one
+ * return: 0 success, <0 error
+ */
+short LRC_SetDecodeThreads(void *handle, short numThreads);
+
 /*
  * Begin a rebuild process, call LRC_NextRequestList immediately to get requested shard list
  * originalCount: number of shards of original data
@@ -74,6 +222,28 @@ short LRC_Decode(void *handle, const void *pShard);
  */
 void *LRC_BeginRebuild(unsigned short originalCount, unsigned short iLost, unsigned long shardSize, void *pData);
 
+/*
+ * Begin a rebuild process for a byte range of the lost shard, call LRC_NextRequestList immediately as LRC_BeginRebuild.
+ * Shards given to LRC_OneShardForRebuild of this process are fragments as of LRC_BeginDecodeRange
+ * offset: first byte of the range in shard data
+ * length: number of bytes of the range
+ * pData: the buffer for rebuilt fragment, at least length+1 bytes, the index byte first
+ * return: handle of rebuild process, NULL fails
+ */
+void *LRC_BeginRebuildRange(unsigned short originalCount, unsigned short iLost, unsigned long shardSize, unsigned long offset, unsigned long length, void *pData);
+
+/*
+ * Begin a rebuild process for several lost shards of one stripe, call LRC_NextRequestList immediately as LRC_BeginRebuild.
+ * One request list serves all lost shards and each fetched shard is used for all of them. A lost shard that
+ * becomes locally repairable after another one is rebuilt is repaired by its local group, only the ones
+ * out of reach of local groups need the global decode. LRC_OneShardForRebuild returns >0 when all are rebuilt
+ * pLost: orders of lost shards
+ * numLost: number of lost shards
+ * pData: the buffer for each rebuilt shard, at least shardSize length
+ * return: handle of rebuild process, NULL fails
+ */
+void *LRC_BeginRebuildMulti(unsigned short originalCount, const unsigned char *pLost, unsigned short numLost, unsigned long shardSize, void *pData[]);
+
 /*
  * Get next shard list for rebuild the lost shard. 
  * Invoking this function means the remaning shards of last list are lost.
@@ -83,17 +253,56 @@ void *LRC_BeginRebuild(unsigned short originalCount, unsigned short iLost, unsig
  */
 short LRC_NextRequestList(void *handle, unsigned char *pList);
 
+#define LRC_COST_UNAVAILABLE 0xFFFF
+/*
+ * Set the cost of fetching each shard for a rebuild process of LRC_BeginRebuild, e.g. latency or bandwidth class
+ * weighted by the caller. LRC_NextRequestList then requests the cheapest shards that are enough, among horizonal,
+ * vertical, local of global and global recovery, instead of trying them in fixed order. Global recovery requests only
+ * the cheapest shards it surely works with, and the next cheapest ones if LRC_NextRequestList is invoked again
+ * pCosts: cost of each shard by order, LRC_COST_UNAVAILABLE if the shard can not be fetched
+ * return: 0 success, <0 if something wrong
+ */
+short LRC_SetRebuildCosts(void *handle, const unsigned short *pCosts);
+
+/*
+ * Hedge the requests of a rebuild process of LRC_BeginRebuild against slow shards, call it before LRC_NextRequestList.
+ * The local groups of the lost shard are requested at once, e.g. both the horizonal and the vertical group of a lost
+ * original, and LRC_OneShardForRebuild returns >0 as soon as any of them has all arrived. The shards of the other group
+ * need not come. With LRC_SetRebuildCosts, the global decode also requests numSpare more shards beyond the cheapest
+ * enough ones and finishes with any enough of them. Shard buffers are kept until the rebuild is done
+ * numSpare: number of spare shards for the global decode
+ * return: 0 success, <0 if something wrong
+ */
+short LRC_SetRebuildHedge(void *handle, short numSpare);
+
 /*
  * Provide one shard for rebuilding lost shards
  * handle: handle of rebuild process
- * pShard: shard data
+ * pShard: shard data, it is read in place and must be kept until rebuilding is done or the handle is freed.
+ *         A local group folds it in as it arrives, the global decode reads it again if the group fails
  * return: >0 if rebuilding is done, repaired data in the buffer provided at beginning of rebuilding process, automatically free handle, 0 if more shards required, <0 if something wrong
  */
  short LRC_OneShardForRebuild(void *handle, const void *pShard);
 
 /*
- * End of a decode or rebuild process and free the resource of this process
- * handle: handle of decode or rebuild process, system will identify the type automatically
+ * Set how many decode matrices are cached. Stripes with the same missing shards and the same recovery shards used,
+ * e.g. during a node outage, share one decode matrix. The cache is shared by all decode and rebuild processes
+ * maxEntries: maximum of cached matrices, 0 disables the cache, default is 64
+ * return: the number now in use
+ */
+short LRC_SetDecodeCacheSize(short maxEntries);
+
+/*
+ * Get statistics of decode matrix cache, to size it
+ * pHits: output, number of decodes that reused a cached matrix. Can be NULL
+ * pMisses: output, number of decodes that generated their matrix. Can be NULL
+ * pEntries: output, number of matrices cached now. Can be NULL
+ */
+void LRC_GetDecodeCacheStats(unsigned long *pHits, unsigned long *pMisses, short *pEntries);
+
+/*
+ * End of an encode, decode or rebuild process and free the resource of this process, or free an encode plan
+ * handle: handle of encode, decode or rebuild process or encode plan, system will identify the type automatically
  * return: true if sucess
  */
 short LRC_FreeHandle(void *handle);
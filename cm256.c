@@ -29,6 +29,13 @@
 #include <stdlib.h>
 #include "cm256.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 
 /*
     GF(256) Cauchy Matrix Overview
@@ -122,6 +129,339 @@ extern int cm256_init_(int version)
 */
 
 
+//-----------------------------------------------------------------------------
+// Worker threads
+
+// One slice of the byte range, run by the calling thread or a worker thread
+typedef struct {
+    CM256RangeTask Task;
+    void* Context;
+    int Offset;
+    int Bytes;
+#ifdef _WIN32
+    HANDLE Thread;
+#else
+    pthread_t Thread;
+#endif
+    bool bStarted;
+} CM256Slice;
+
+// Worker threads running for all callers together
+static volatile long BusyWorkers = 0;
+
+// Lock-free loads and stores of the values shared by all callers
+#ifdef _WIN32
+#define LOAD_SHARED(x)      (x)
+#define STORE_SHARED(x, v)  ((x) = (v))
+#else
+#define LOAD_SHARED(x)      __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define STORE_SHARED(x, v)  __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+#endif
+
+static int HardwareThreads()
+{
+    static int cachedThreads = 0;
+    int numThreads = LOAD_SHARED(cachedThreads);
+
+    if (numThreads <= 0)
+    {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        numThreads = (int)info.dwNumberOfProcessors;
+#else
+        numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+        if (numThreads <= 0)
+            numThreads = 1;
+        STORE_SHARED(cachedThreads, numThreads);
+    }
+    return numThreads;
+}
+
+/*
+    Reserve up to 'wanted' worker threads.  Each caller also works on its own
+    thread, so all callers together never run more worker threads than there
+    are cores besides one.
+*/
+static long ReserveWorkers(long wanted)
+{
+    for (;;)
+    {
+        const long busy = LOAD_SHARED(BusyWorkers);
+        long granted = HardwareThreads() - 1 - busy;
+        if (granted > wanted)
+            granted = wanted;
+        if (granted <= 0)
+            return 0;
+#ifdef _WIN32
+        if (InterlockedCompareExchange(&BusyWorkers, busy + granted, busy) == busy)
+#else
+        if (__sync_bool_compare_and_swap(&BusyWorkers, busy, busy + granted))
+#endif
+            return granted;
+    }
+}
+
+static void ReleaseWorkers(long count)
+{
+#ifdef _WIN32
+    InterlockedExchangeAdd(&BusyWorkers, -count);
+#else
+    __sync_fetch_and_sub(&BusyWorkers, count);
+#endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI SliceThread(LPVOID pArg)
+#else
+static void* SliceThread(void* pArg)
+#endif
+{
+    CM256Slice* pSlice = (CM256Slice*)pArg;
+    pSlice->Task(pSlice->Context, pSlice->Offset, pSlice->Bytes);
+    return 0;
+}
+
+extern int cm256_parallel_ranges(CM256RangeTask task, void* context, int blockBytes, int numThreads)
+{
+    // Slices start on cache line boundaries, so no two threads write the same line
+    return cm256_parallel_slices(task, context, blockBytes, CM256_MIN_THREAD_BYTES, 64, numThreads);
+}
+
+extern int cm256_parallel_slices(CM256RangeTask task, void* context, int total, int minSlice, int align, int numThreads)
+{
+    CM256Slice slices[CM256_MAX_THREADS];
+    int i;
+
+    if (numThreads > CM256_MAX_THREADS)
+        numThreads = CM256_MAX_THREADS;
+    if (minSlice < 1)
+        minSlice = 1;
+    if (numThreads > total / minSlice)
+        numThreads = total / minSlice;
+    const int workers = numThreads > 1 ? (int)ReserveWorkers(numThreads - 1) : 0;
+    if (workers <= 0)
+    {
+        task(context, 0, total);
+        return 1;
+    }
+
+    const int count = workers + 1;
+    const int sliceSize = ((total + count - 1) / count + align - 1) / align * align;
+    for (i = 0; i < count; i++)
+    {
+        slices[i].Task = task;
+        slices[i].Context = context;
+        slices[i].Offset = i * sliceSize < total ? i * sliceSize : total;
+        slices[i].Bytes = total - slices[i].Offset < sliceSize ? total - slices[i].Offset : sliceSize;
+        slices[i].bStarted = false;
+    }
+
+    for (i = 1; i < count; i++)
+    {
+        if (slices[i].Bytes <= 0)
+            continue;
+#ifdef _WIN32
+        slices[i].Thread = CreateThread(NULL, 0, SliceThread, &slices[i], 0, NULL);
+        slices[i].bStarted = NULL != slices[i].Thread;
+#else
+        slices[i].bStarted = pthread_create(&slices[i].Thread, NULL, SliceThread, &slices[i]) == 0;
+#endif
+    }
+
+    // The calling thread takes the first slice, and any slice a thread could not be started for
+    for (i = 0; i < count; i++)
+    {
+        if (!slices[i].bStarted && slices[i].Bytes > 0)
+            task(context, slices[i].Offset, slices[i].Bytes);
+    }
+
+    for (i = 1; i < count; i++)
+    {
+        if (!slices[i].bStarted)
+            continue;
+#ifdef _WIN32
+        WaitForSingleObject(slices[i].Thread, INFINITE);
+        CloseHandle(slices[i].Thread);
+#else
+        pthread_join(slices[i].Thread, NULL);
+#endif
+    }
+
+    ReleaseWorkers(workers);
+    return count;
+}
+
+
+//-----------------------------------------------------------------------------
+// Decode matrix cache
+
+#ifdef _WIN32
+static SRWLOCK CacheLock = SRWLOCK_INIT;
+#define LOCK_CACHE()    AcquireSRWLockExclusive(&CacheLock)
+#define UNLOCK_CACHE()  ReleaseSRWLockExclusive(&CacheLock)
+#else
+static pthread_mutex_t CacheLock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_CACHE()    pthread_mutex_lock(&CacheLock)
+#define UNLOCK_CACHE()  pthread_mutex_unlock(&CacheLock)
+#endif
+
+// Kinds of matrices in the cache
+#define CM256_CACHE_LDU 1       // Elimination matrix and LDU decomposition used by Decode()
+#define CM256_CACHE_INVERSE 2   // Recovery matrix used by DecodeInverse()
+
+// Key of a cached matrix: its kind, the decode geometry, the erased rows, the recovery rows used and the originals received
+#define CM256_CACHE_KEY_BYTES (6 + 3 * MAXSHARDS)
+
+typedef struct {
+    uint64_t Hash;
+    uint64_t LastUsed;
+    int KeyBytes;
+    int MatrixBytes;
+    uint8_t Key[CM256_CACHE_KEY_BYTES];
+    uint8_t Matrix[1];  // MatrixBytes in fact
+} CM256CacheEntry;
+
+static CM256CacheEntry* CacheEntries[CM256_MAX_CACHE_ENTRIES];
+static int CacheCapacity = CM256_DEFAULT_CACHE_ENTRIES;
+static int CacheCount = 0;
+static uint64_t CacheClock = 0;
+static unsigned long CacheHits = 0, CacheMisses = 0;
+
+static uint64_t CacheHash(const uint8_t* key, int keyBytes)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    int i;
+    for (i = 0; i < keyBytes; i++)
+        hash = (hash ^ key[i]) * 1099511628211ULL;
+    return hash;
+}
+
+// Fill in the key of the matrices Decode() needs for pDecoder, return its length
+static int DecodeCacheKey(const CM256Decoder* pDecoder, int kind, uint8_t* key)
+{
+    const int N = pDecoder->RecoveryCount;
+    int i, n = 0;
+
+    key[n++] = (uint8_t)kind;
+    key[n++] = (uint8_t)pDecoder->Params.TotalOriginalCount;
+    key[n++] = (uint8_t)pDecoder->Params.FirstElement;
+    key[n++] = (uint8_t)pDecoder->Params.Step;
+    key[n++] = (uint8_t)pDecoder->Params.OriginalCount;
+    key[n++] = (uint8_t)N;
+    // The erased rows of the group also decide which rows are originals, in order
+    for (i = 0; i < N; i++) {
+        key[n++] = pDecoder->ErasuresIndices[i];
+        key[n++] = pDecoder->recoveryBlock[i]->decodeIndex;
+    }
+    // The columns of the matrices follow the originals as they are laid out in the blocks
+    for (i = 0; i < pDecoder->OriginalCount; i++)
+        key[n++] = pDecoder->originalBlock[i]->lrcIndex;
+    return n;
+}
+
+static void EvictCacheEntry(int i)
+{
+    free(CacheEntries[i]);
+    CacheEntries[i] = CacheEntries[--CacheCount];
+}
+
+// Copy a cached matrix into 'matrix', return false if it is not cached
+static bool CacheGet(const uint8_t* key, int keyBytes, uint8_t* matrix, int matrixBytes)
+{
+    const uint64_t hash = CacheHash(key, keyBytes);
+    bool bFound = false;
+    int i;
+
+    LOCK_CACHE();
+    for (i = 0; i < CacheCount; i++)
+    {
+        CM256CacheEntry* pEntry = CacheEntries[i];
+        if (pEntry->Hash == hash && pEntry->KeyBytes == keyBytes && pEntry->MatrixBytes == matrixBytes &&
+            memcmp(pEntry->Key, key, keyBytes) == 0)
+        {
+            memcpy(matrix, pEntry->Matrix, matrixBytes);
+            pEntry->LastUsed = ++CacheClock;
+            bFound = true;
+            break;
+        }
+    }
+    if (bFound)
+        CacheHits++;
+    else
+        CacheMisses++;
+    UNLOCK_CACHE();
+
+    return bFound;
+}
+
+// Add a matrix to the cache, evicting the least recently used one when it is full
+static void CachePut(const uint8_t* key, int keyBytes, const uint8_t* matrix, int matrixBytes)
+{
+    if (CacheCapacity <= 0)
+        return;
+
+    CM256CacheEntry* pEntry = (CM256CacheEntry*)malloc(sizeof(CM256CacheEntry) + matrixBytes);
+    if (NULL == pEntry)
+        return;
+    pEntry->Hash = CacheHash(key, keyBytes);
+    pEntry->KeyBytes = keyBytes;
+    pEntry->MatrixBytes = matrixBytes;
+    memcpy(pEntry->Key, key, keyBytes);
+    memcpy(pEntry->Matrix, matrix, matrixBytes);
+
+    LOCK_CACHE();
+    if (CacheCount >= CacheCapacity && CacheCount > 0)
+    {
+        int i, oldest = 0;
+        for (i = 1; i < CacheCount; i++)
+            if (CacheEntries[i]->LastUsed < CacheEntries[oldest]->LastUsed)
+                oldest = i;
+        EvictCacheEntry(oldest);
+    }
+    if (CacheCount < CacheCapacity)
+    {
+        pEntry->LastUsed = ++CacheClock;
+        CacheEntries[CacheCount++] = pEntry;
+        pEntry = NULL;
+    }
+    UNLOCK_CACHE();
+
+    if (NULL != pEntry)
+        free(pEntry); // The capacity was reduced meanwhile
+}
+
+extern int cm256_cache_configure(int maxEntries)
+{
+    if (maxEntries < 0)
+        maxEntries = 0;
+    if (maxEntries > CM256_MAX_CACHE_ENTRIES)
+        maxEntries = CM256_MAX_CACHE_ENTRIES;
+
+    LOCK_CACHE();
+    CacheCapacity = maxEntries;
+    while (CacheCount > CacheCapacity)
+        EvictCacheEntry(CacheCount - 1);
+    UNLOCK_CACHE();
+
+    return maxEntries;
+}
+
+extern void cm256_cache_stats(unsigned long* pHits, unsigned long* pMisses, int* pEntries)
+{
+    LOCK_CACHE();
+    if (NULL != pHits)
+        *pHits = CacheHits;
+    if (NULL != pMisses)
+        *pMisses = CacheMisses;
+    if (NULL != pEntries)
+        *pEntries = CacheCount;
+    UNLOCK_CACHE();
+}
+
+
 //-----------------------------------------------------------------------------
 // Encoding
 
@@ -171,113 +511,389 @@ extern void CM256EncodeBlock(
     {
         int j;
         const uint8_t x_i = (uint8_t)(recoveryBlockIndex);
+        uint8_t matrixRow[MAXSHARDS];
+        const void* columns[MAXSHARDS];
+
+        // For each original data column,
+        for (j = 0; j < params.OriginalCount; j++) {
+            const uint8_t y_j = (uint8_t)(params.FirstElement + j * params.Step);
+
+            matrixRow[j] = GetMatrixElement(x_i, x_0, y_j);
+            columns[j] = originals[y_j].pData;
+        }
+
+        // One pass over the recovery block for all columns
+        gf256_dot_mem(recoveryBlockData, matrixRow, columns, params.OriginalCount, params.BlockBytes);
+    }
+}
+
+#ifndef CM256_TILE_BYTES
+// Bytes of each block per tile
+#define CM256_TILE_BYTES 1024
+#endif
+#ifndef CM256_TILE_ROWS
+// Recovery rows updated together.  Blocks are usually laid out end to end at
+// a power-of-two stride, so their tiles all land in the same L1 cache sets
+// and more rows than the cache has ways would evict each other.
+#define CM256_TILE_ROWS 8
+#endif
 
-        // Unroll first operation for speed
+/*
+    Computes rows[r] += matrix[j * rowCount + r] * columns[j] over all j.
+
+    The blocks are cut into tiles, and each column tile is multiplied into
+    several row tiles at once while those stay in L1 cache.  The column tiles
+    of one pass fit in L2 cache, so the column blocks are read from memory
+    only once however many rows there are.
+    If bClear is set the rows are zeroed first.
+*/
+static void MulAddColumns(
+    void* const* rows, int rowCount,
+    const void* const* columns, int columnCount,
+    const uint8_t* matrix, int blockBytes, bool bClear)
+{
+    void* rowTiles[CM256_TILE_ROWS];
+    uint8_t tileMatrix[CM256_TILE_ROWS];
+    int offset, first, r, j;
+
+    for (offset = 0; offset < blockBytes; offset += CM256_TILE_BYTES)
+    {
+        const int bytes = blockBytes - offset < CM256_TILE_BYTES ? blockBytes - offset : CM256_TILE_BYTES;
+
+        for (first = 0; first < rowCount; first += CM256_TILE_ROWS)
         {
-            const uint8_t y_0 = params.FirstElement;
-            const uint8_t matrixElement = GetMatrixElement(x_i, x_0, y_0);
+            const int count = rowCount - first < CM256_TILE_ROWS ? rowCount - first : CM256_TILE_ROWS;
+
+            for (r = 0; r < count; r++) {
+                rowTiles[r] = (uint8_t*)rows[first + r] + offset;
+                if (bClear)
+                    memset(rowTiles[r], 0, bytes);
+            }
 
-            gf256_mul_mem(recoveryBlockData, originals[y_0].pData, matrixElement, params.BlockBytes);
+            for (j = 0; j < columnCount; j++) {
+                for (r = 0; r < count; r++)
+                    tileMatrix[r] = matrix[j * rowCount + first + r];
+                gf256_muladd_multi_dest_mem(rowTiles, tileMatrix, count, (const uint8_t*)columns[j] + offset, bytes);
+            }
         }
+    }
+}
 
-        // For each original data column,
-        for (j = 1; j < params.OriginalCount; j++) {
-            const uint8_t y_j = (uint8_t)(params.FirstElement + j * params.Step);
-            const uint8_t matrixElement = GetMatrixElement(x_i, x_0, y_j);
+#ifndef CM256_ENCODE_L2_BYTES
+// Bytes of original data encoded at a time.  The originals of one range stay
+// in L2 cache for the horizontal, vertical and global passes over them.
+#define CM256_ENCODE_L2_BYTES (512 * 1024)
+#endif
 
-            gf256_muladd_mem(recoveryBlockData, matrixElement, originals[y_j].pData, params.BlockBytes);
+/*
+    Encodes bytes [offset, offset + bytes) of every LRC recovery block:
+    the horizontal and vertical local recovery blocks, the global recovery
+    blocks and the local recovery block of the global ones.
+
+    recoveryBlocks[] points at the data of each recovery block in LRC order.
+*/
+static void EncodeRange(
+    const CM256EncodePlan* pPlan,
+    const CM256Block* originals,
+    uint8_t* const* recoveryBlocks,
+    int offset, int bytes)
+{
+    const CM256LRC* pParam = &pPlan->Param;
+    const int horCount = pParam->HorLocalCount;
+    const int verCount = pParam->VerLocalCount;
+    const void* columns[MAXSHARDS];
+    void* rows[MAXSHARDS];
+    int i, j;
+
+    /*
+     * Calculate horizon recovery blocks, the parity of each run of HorLocalCount originals
+     */
+    for (i = 0; i < verCount; i++) {
+        uint8_t* pOut = recoveryBlocks[pParam->FirstHorRecoveryIndex + i] + offset;
+        const CM256Block* group = originals + i * horCount;
+
+        if (pPlan->HorCount[i] == 1)
+            memcpy(pOut, group[0].pData + offset, bytes);
+        else {
+            gf256_addset_mem(pOut, group[0].pData + offset, group[1].pData + offset, bytes);
+            for (j = 2; j < pPlan->HorCount[i]; j++)
+                gf256_add_mem(pOut, group[j].pData + offset, bytes);
         }
     }
+
+    /*
+     * Calculate vertical recovery blocks from every HorLocalCount-th original
+     */
+    for (i = 0; i < horCount; i++) {
+        for (j = 0; j < pPlan->VerCount[i]; j++)
+            columns[j] = originals[i + j * horCount].pData + offset;
+        gf256_dot_mem(recoveryBlocks[pParam->FirstVerRecoveryIndex + i] + offset, pPlan->VerMatrix + i * verCount, columns, pPlan->VerCount[i], bytes);
+    }
+
+    /*
+     * Calculate global recovery blocks and the local recovery block of them together
+     */
+    for (j = 0; j < pParam->OriginalCount; j++)
+        columns[j] = originals[j].pData + offset;
+    for (i = 0; i <= pParam->GlobalRecoveryCount; i++)
+        rows[i] = recoveryBlocks[pParam->FirstGlobalRecoveryIndex + i] + offset;
+    MulAddColumns(rows, pParam->GlobalRecoveryCount + 1, columns, pParam->OriginalCount, pPlan->GlobalMatrix, bytes, true);
 }
 
-extern int cm256_encode(
-    CM256LRC paramLRC, // LRC Encoder params
-    CM256Block* originals,      // Array of pointers to original blocks
-    uint8_t* recoveryData)        // Output recovery blocks end-to-end
+extern int cm256_plan_init(CM256EncodePlan* pPlan, const CM256LRC* pParam)
 {
-    short i;
+    int i, j;
     // Validate input:
-    if (paramLRC.OriginalCount <= 0 ||
-        paramLRC.TotalRecoveryCount <= 3 ||
-        paramLRC.BlockBytes <= 0)
+    if (pParam->OriginalCount <= 0 ||
+        pParam->TotalRecoveryCount <= 3 ||
+        pParam->HorLocalCount <= 0 || pParam->HorLocalCount > MAXHORCOUNT ||
+        pParam->TotalOriginalCount != pParam->HorLocalCount * pParam->VerLocalCount ||
+        pParam->TotalOriginalCount < pParam->OriginalCount)
     {
         return -1;
     }
-    if (paramLRC.TotalOriginalCount + paramLRC.TotalRecoveryCount > 256)
+    if (pParam->TotalOriginalCount + pParam->TotalRecoveryCount > 256)
     {
         return -2;
     }
+
+    pPlan->Param = *pParam;
+
+    /*
+     * Group sizes, not counting padding
+     */
+    for (i = 0; i < pParam->VerLocalCount; i++) {
+        const int remaining = pParam->OriginalCount - i * pParam->HorLocalCount;
+        pPlan->HorCount[i] = (uint8_t)(remaining < pParam->HorLocalCount ? remaining : pParam->HorLocalCount);
+    }
+    for (i = 0; i < pParam->HorLocalCount; i++)
+        pPlan->VerCount[i] = (uint8_t)((pParam->OriginalCount - i + pParam->HorLocalCount - 1) / pParam->HorLocalCount);
+
+    /*
+     * Matrix elements.  The vertical recovery row is TotalOriginalCount + 1, and the
+     * global recovery rows start from TotalOriginalCount + 2.  The local recovery block
+     * of the global recovery blocks is their sum, so its elements are the column sums.
+     * A group of one block degenerates to a copy of it, as in CM256EncodeBlock().
+     */
+    const uint8_t x_0 = (uint8_t)pParam->TotalOriginalCount;
+    for (i = 0; i < pParam->HorLocalCount; i++)
+        for (j = 0; j < pParam->VerLocalCount; j++)
+            pPlan->VerMatrix[i * pParam->VerLocalCount + j] = pParam->VerLocalCount == 1 ? 1 :
+                GetMatrixElement((uint8_t)(x_0 + 1), x_0, (uint8_t)(i + j * pParam->HorLocalCount));
+
+    const int globalRows = pParam->GlobalRecoveryCount + 1;
+    for (j = 0; j < pParam->OriginalCount; j++) {
+        uint8_t* column = pPlan->GlobalMatrix + j * globalRows;
+        uint8_t sum = 0;
+        for (i = 0; i < pParam->GlobalRecoveryCount; i++) {
+            column[i] = pParam->OriginalCount == 1 ? 1 : GetMatrixElement((uint8_t)(x_0 + i + 2), x_0, (uint8_t)j);
+            sum ^= column[i];
+        }
+        column[pParam->GlobalRecoveryCount] = sum;
+    }
+
+    return 0;
+}
+
+// Arguments of an encode shared by all worker threads
+typedef struct {
+    const CM256EncodePlan* pPlan;
+    const CM256Block* originals;
+    uint8_t* recoveryBlocks[MAXSHARDS];
+} CM256EncodeJob;
+
+/*
+    Encodes bytes [offset, offset + bytes) of every recovery block, one L2
+    sized range at a time
+*/
+static void EncodeSlice(void* context, int offset, int bytes)
+{
+    const CM256EncodeJob* pJob = (const CM256EncodeJob*)context;
+    const int end = offset + bytes;
+
+    int rangeBytes = (CM256_ENCODE_L2_BYTES / pJob->pPlan->Param.TotalOriginalCount) & ~1023;
+    if (rangeBytes < 1024)
+        rangeBytes = 1024;
+    for (; offset < end; offset += rangeBytes) {
+        const int count = end - offset < rangeBytes ? end - offset : rangeBytes;
+        EncodeRange(pJob->pPlan, pJob->originals, pJob->recoveryBlocks, offset, count);
+    }
+}
+
+/*
+    Points recoveryBlocks[] at the data of each recovery block laid out
+    end-to-end in recoveryData, each one after its index byte.  The index
+    bytes are written if bWriteIndex is set.
+*/
+static void LayoutRecoveryBlocks(const CM256LRC* pParam, int blockBytes, uint8_t* recoveryData, uint8_t** recoveryBlocks, bool bWriteIndex)
+{
+    const size_t recoveryStride = blockBytes + (pParam->bIndexByte ? 1 : 0);
+    int i;
+
+    for (i = 0; i < pParam->TotalRecoveryCount; i++) {
+        uint8_t* pRecoveryData = recoveryData + i * recoveryStride;
+        if ( pParam->bIndexByte ) {
+            if ( bWriteIndex )
+                *pRecoveryData = pParam->OriginalCount + i;
+            pRecoveryData++;
+        }
+        recoveryBlocks[i] = pRecoveryData;
+    }
+}
+
+extern int cm256_encode_plan(const CM256EncodePlan* pPlan, const CM256Block* originals, int blockBytes, uint8_t* recoveryData)
+{
+    return cm256_encode_plan_parallel(pPlan, originals, blockBytes, recoveryData, 1);
+}
+
+extern int cm256_encode_plan_parallel(const CM256EncodePlan* pPlan, const CM256Block* originals, int blockBytes, uint8_t* recoveryData, int numThreads)
+{
+    CM256EncodeJob job;
+
+    if (blockBytes <= 0)
+    {
+        return -1;
+    }
     if (NULL == originals || NULL == recoveryData)
     {
         return -3;
     }
 
-    cm256_encoder_params params;
-    params.TotalOriginalCount = paramLRC.TotalOriginalCount;
-    params.BlockBytes = paramLRC.BlockBytes;
+    LayoutRecoveryBlocks(&pPlan->Param, blockBytes, recoveryData, job.recoveryBlocks, true);
+
     /*
-     * Calculate horizon recovery blocks
+     * Produce every recovery block one byte range at a time. Worker threads
+     * take disjoint byte ranges, so they never write the same output.
      */
-    params.OriginalCount = paramLRC.HorLocalCount;
-    params.RecoveryCount = 1;
-    params.FirstElement = 0;
-    params.Step = 1;
-    uint8_t* pRecoveryData = recoveryData;
-    for (i = 0; i < paramLRC.VerLocalCount; i++) {
-        if ( paramLRC.bIndexByte )
-            *pRecoveryData++ = paramLRC.OriginalCount + i;
-        CM256EncodeBlock(params, originals, params.TotalOriginalCount, pRecoveryData);
-        pRecoveryData += params.BlockBytes;
-        params.FirstElement += paramLRC.HorLocalCount;
+    job.pPlan = pPlan;
+    job.originals = originals;
+    cm256_parallel_ranges(EncodeSlice, &job, blockBytes, numThreads);
+
+    return 0;
+}
+
+extern int cm256_encode_plan_begin(const CM256EncodePlan* pPlan, int blockBytes, uint8_t* recoveryData)
+{
+    uint8_t* recoveryBlocks[MAXSHARDS];
+    int i;
+
+    if (blockBytes <= 0)
+    {
+        return -1;
+    }
+    if (NULL == recoveryData)
+    {
+        return -3;
     }
 
-    /*
-     * Calculate vertical recovery blocks
-     */
-    params.OriginalCount = paramLRC.VerLocalCount;
-    params.Step = paramLRC.HorLocalCount;
-    for (i = 0; i < paramLRC.HorLocalCount; i++) {
-        if ( paramLRC.bIndexByte )
-            *pRecoveryData++ = paramLRC.OriginalCount + paramLRC.VerLocalCount + i;
-        params.FirstElement = i;
-        CM256EncodeBlock(params, originals, params.TotalOriginalCount+1, pRecoveryData);
-        pRecoveryData += params.BlockBytes;        
+    LayoutRecoveryBlocks(&pPlan->Param, blockBytes, recoveryData, recoveryBlocks, true);
+    for (i = 0; i < pPlan->Param.TotalRecoveryCount; i++)
+        memset(recoveryBlocks[i], 0, blockBytes);
+
+    return 0;
+}
+
+/*
+    Adds bytes [offset, offset + bytes) of one original block, given in pData,
+    to every recovery block it contributes to: one horizontal, one vertical and
+    all the global recovery blocks, with the same matrix elements
+    cm256_encode_plan() uses.  They are all updated in one pass over pData.
+*/
+static void AddOriginalRange(const CM256EncodePlan* pPlan, int originalIndex, uint8_t* const* recoveryBlocks, const uint8_t* pData, int offset, int bytes)
+{
+    const CM256LRC* pParam = &pPlan->Param;
+    const int x = originalIndex % pParam->HorLocalCount;
+    const int y = originalIndex / pParam->HorLocalCount;
+    const int globalRows = pParam->GlobalRecoveryCount + 1;
+    const void* columns[1];
+    void* rows[MAXSHARDS];
+    uint8_t column[MAXSHARDS];
+    int i;
+
+    rows[0] = recoveryBlocks[pParam->FirstHorRecoveryIndex + y] + offset;
+    column[0] = 1;
+    rows[1] = recoveryBlocks[pParam->FirstVerRecoveryIndex + x] + offset;
+    column[1] = pPlan->VerMatrix[x * pParam->VerLocalCount + y];
+    for (i = 0; i < globalRows; i++) {
+        rows[2 + i] = recoveryBlocks[pParam->FirstGlobalRecoveryIndex + i] + offset;
+        column[2 + i] = pPlan->GlobalMatrix[originalIndex * globalRows + i];
     }
 
+    columns[0] = pData;
+    MulAddColumns(rows, 2 + globalRows, columns, 1, column, bytes, false);
+}
+
+extern int cm256_encode_plan_add(const CM256EncodePlan* pPlan, int originalIndex, const uint8_t* pData, int blockBytes, uint8_t* recoveryData)
+{
+    uint8_t* recoveryBlocks[MAXSHARDS];
+
+    if (blockBytes <= 0 || originalIndex < 0 || originalIndex >= pPlan->Param.OriginalCount)
+    {
+        return -1;
+    }
+    if (NULL == pData || NULL == recoveryData)
+    {
+        return -3;
+    }
+
+    LayoutRecoveryBlocks(&pPlan->Param, blockBytes, recoveryData, recoveryBlocks, false);
+    AddOriginalRange(pPlan, originalIndex, recoveryBlocks, pData, 0, blockBytes);
+
+    return 0;
+}
+
+extern int cm256_encode_plan_update(const CM256EncodePlan* pPlan, int originalIndex, const uint8_t* pOldData, const uint8_t* pNewData, int blockBytes, uint8_t* recoveryData)
+{
+    uint8_t* recoveryBlocks[MAXSHARDS];
+    GF256_ALIGNED uint8_t delta[CM256_TILE_BYTES * 4];
+    int offset;
+
+    if (blockBytes <= 0 || originalIndex < 0 || originalIndex >= pPlan->Param.OriginalCount)
+    {
+        return -1;
+    }
+    if (NULL == pOldData || NULL == pNewData || NULL == recoveryData)
+    {
+        return -3;
+    }
+
+    LayoutRecoveryBlocks(&pPlan->Param, blockBytes, recoveryData, recoveryBlocks, false);
+
     /*
-     * Calculate global recovery blocks
+     * Every recovery block is linear in each original, so adding (old + new) times the
+     * original's matrix elements replaces old with new.  The difference is formed one
+     * tile at a time on the stack.
      */
-    uint8_t *pLocalGlobalRecoveryData;
-    if ( !paramLRC.bIndexByte )
-        pLocalGlobalRecoveryData = pRecoveryData + paramLRC.GlobalRecoveryCount * params.BlockBytes;
-    else {
-        pLocalGlobalRecoveryData = pRecoveryData + paramLRC.GlobalRecoveryCount * (params.BlockBytes + 1);
-        *pLocalGlobalRecoveryData++ = paramLRC.OriginalCount + paramLRC.LocalRecoveryOfGlobalRecoveryIndex;;
-    }
-    memset(pLocalGlobalRecoveryData, 0, params.BlockBytes);
-    params.OriginalCount = paramLRC.OriginalCount;
-    params.RecoveryCount = paramLRC.GlobalRecoveryCount;
-    params.FirstElement = 0;
-    params.Step = 1;
-    for (i = 0; i < paramLRC.GlobalRecoveryCount; i++) {
-        /*
-         * First recovery matrix is used for horizon recovery, 2nd matrix is used for vertical recovery, 
-         * so global recovery start from 2
-         */
-        if ( paramLRC.bIndexByte )
-            *pRecoveryData++ = paramLRC.OriginalCount + paramLRC.VerLocalCount + paramLRC.HorLocalCount + i;
-        CM256EncodeBlock(params, originals, (params.TotalOriginalCount + i + 2), pRecoveryData);
-
-        gf256_add_mem(pLocalGlobalRecoveryData, pRecoveryData, params.BlockBytes);  // Figure local recovery block of global recovery data
-        //for (j = 0; j < params.BlockBytes; j++)
-        //    pLocalGlobalRecoveryData[j] ^= pRecoveryData[j];
-
-        pRecoveryData += params.BlockBytes;
-    }
-    
+    for (offset = 0; offset < blockBytes; offset += (int)sizeof(delta)) {
+        const int bytes = blockBytes - offset < (int)sizeof(delta) ? blockBytes - offset : (int)sizeof(delta);
+        gf256_addset_mem(delta, pOldData + offset, pNewData + offset, bytes);
+        AddOriginalRange(pPlan, originalIndex, recoveryBlocks, delta, offset, bytes);
+    }
+
     return 0;
 }
 
+extern int cm256_encode(
+    CM256LRC paramLRC, // LRC Encoder params
+    CM256Block* originals,      // Array of pointers to original blocks
+    uint8_t* recoveryData)        // Output recovery blocks end-to-end
+{
+    CM256EncodePlan plan;
+    int ret;
+
+    if (paramLRC.BlockBytes <= 0)
+    {
+        return -1;
+    }
+    ret = cm256_plan_init(&plan, &paramLRC);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    return cm256_encode_plan(&plan, originals, paramLRC.BlockBytes, recoveryData);
+}
+
 
 //-----------------------------------------------------------------------------
 // Decoding
@@ -332,33 +948,40 @@ extern bool DecoderInitialize(CM256Decoder *pDecoder, const cm256_encoder_params
 
 extern void DecodeM1(CM256Decoder *pDecoder)
 {
-    int ii;
+    int ii, offset;
     // XOR all other blocks into the recovery block
     uint8_t* outBlock = pDecoder->recoveryBlock[0]->pData;
-    size_t blockBytes = pDecoder->Params.BlockBytes;
+    const int blockBytes = pDecoder->Params.BlockBytes;
+    const int tileBytes = CM256_DECODE_TILE_BYTES > 0 ? CM256_DECODE_TILE_BYTES : blockBytes;
 #ifdef NOT_USE
     for (ii = 0; ii < pDecoder->OriginalCount; ii++)
         gf256_add_mem(outBlock, pDecoder->originalBlock[ii]->pData, blockBytes);
 #endif
-    const uint8_t* inBlock = nullptr;
 
-    // For each block,
-    for (ii = 0; ii < pDecoder->OriginalCount; ii++) {
-        const uint8_t* inBlock2 = pDecoder->originalBlock[ii]->pData;
-
-        if (nullptr == inBlock)
-            inBlock = inBlock2;
-        else {
-            // outBlock ^= inBlock ^ inBlock2
-            gf256_add2_mem(outBlock, inBlock, inBlock2, blockBytes);
-            inBlock = nullptr;
+    // For each range, so the recovery range stays in L1 over all the originals
+    for (offset = 0; offset < blockBytes; offset += tileBytes)
+    {
+        const int bytes = blockBytes - offset < tileBytes ? blockBytes - offset : tileBytes;
+        const uint8_t* inBlock = nullptr;
+
+        // For each block,
+        for (ii = 0; ii < pDecoder->OriginalCount; ii++) {
+            const uint8_t* inBlock2 = (const uint8_t*)pDecoder->originalBlock[ii]->pData + offset;
+
+            if (nullptr == inBlock)
+                inBlock = inBlock2;
+            else {
+                // outBlock ^= inBlock ^ inBlock2
+                gf256_add2_mem(outBlock + offset, inBlock, inBlock2, bytes);
+                inBlock = nullptr;
+            }
         }
-    }
 
-    // Complete XORs
-    if (nullptr != inBlock)
-    {
-        gf256_add_mem(outBlock, inBlock, pDecoder->Params.BlockBytes);
+        // Complete XORs
+        if (nullptr != inBlock)
+        {
+            gf256_add_mem(outBlock + offset, inBlock, bytes);
+        }
     }
 
     // Recover the index it corresponds to
@@ -475,36 +1098,105 @@ extern void GenerateLDUDecomposition(CM256Decoder *pDecoder, uint8_t* matrix_L,
     diag_D[N - 1] = gf256_div(gf256_mul(L_nn, U_nn), gf256_add(x_n, y_n));
 }
 
-extern void Decode(CM256Decoder *pDecoder)
+// Apply the elimination and the LDU decomposition to bytes [offset, offset + bytes) of the blocks.
+// The elimination is skipped if the originals were already folded into the recovery blocks
+static void DecodeRange(CM256Decoder *pDecoder, const uint8_t* matrix, const uint8_t* diag_D, bool bEliminated, int offset, int bytes)
 {
     int originalIndex, recoveryIndex, i, j;
-    // Matrix size is NxN, where N is the number of recovery blocks used.
     const int N = pDecoder->RecoveryCount;
+    const uint8_t* matrix_U = matrix + N * pDecoder->OriginalCount;
+    const uint8_t* matrix_L = diag_D + N;
+    uint8_t* rows[MAXSHARDS];
+
+    for (recoveryIndex = 0; recoveryIndex < N; ++recoveryIndex)
+        rows[recoveryIndex] = (uint8_t*)pDecoder->recoveryBlock[recoveryIndex]->pData + offset;
 
     // Eliminate original data from the the recovery rows
-    for (originalIndex = 0; originalIndex < pDecoder->OriginalCount; ++originalIndex)
+    if (!bEliminated)
+    {
+        const void* inBlocks[MAXSHARDS];
+
+        for (originalIndex = 0; originalIndex < pDecoder->OriginalCount; ++originalIndex)
+            inBlocks[originalIndex] = (const uint8_t*)pDecoder->originalBlock[originalIndex]->pData + offset;
+
+        // Each original is read once and multiplied into all the recovery rows
+        MulAddColumns((void**)rows, N, inBlocks, pDecoder->OriginalCount, matrix, bytes, false);
+    }
+
+    /*
+        Eliminate lower left triangle.
+    */
+    // For each column,
+    for (j = 0; j < N - 1; ++j)
     {
-        const uint8_t* inBlock = pDecoder->originalBlock[originalIndex]->pData;
-        const uint8_t iElement = pDecoder->originalBlock[originalIndex]->lrcIndex;
+        // For each row,
+        for (i = j + 1; i < N; ++i)
+        {
+            const uint8_t c_ij = *matrix_L++; // Matrix elements are stored column-first, top-down.
+
+            gf256_muladd_mem(rows[i], c_ij, rows[j], bytes);
+        }
+    }
+
+    /*
+        Eliminate diagonal.
+    */
+    for (i = 0; i < N; ++i)
+        gf256_div_mem(rows[i], rows[i], diag_D[i], bytes);
 
-        for (recoveryIndex = 0; recoveryIndex < N; ++recoveryIndex)
+    /*
+        Eliminate upper right triangle.
+    */
+    for (j = N - 1; j >= 1; --j)
+    {
+        for (i = j - 1; i >= 0; --i)
         {
-            uint8_t* outBlock = pDecoder->recoveryBlock[recoveryIndex]->pData;
-            const uint8_t matrixElement = GetMatrixElement(pDecoder->recoveryBlock[recoveryIndex]->decodeIndex, pDecoder->Params.TotalOriginalCount, iElement);
+            const uint8_t c_ij = *matrix_U++; // Matrix elements are stored column-first, bottom-up.
 
-            gf256_muladd_mem(outBlock, matrixElement, inBlock, pDecoder->Params.BlockBytes);
+            gf256_muladd_mem(rows[i], c_ij, rows[j], bytes);
         }
     }
+}
 
-    // Allocate matrix
+// Decode shared by the threads, each one runs all the steps on its own byte range
+typedef struct {
+    CM256Decoder* pDecoder;
+    const uint8_t* matrix;  // Elimination matrix followed by the LDU decomposition, or rows of the recovery matrix
+    const uint8_t* diag_D;
+    const int* rows;        // Recovery blocks that the rows of the recovery matrix are written to
+    int rowCount;
+    bool bEliminated;       // Originals were already folded into the recovery blocks
+} CM256DecodeJob;
+
+static void DecodeSlice(void* context, int offset, int bytes)
+{
+    const CM256DecodeJob* pJob = (const CM256DecodeJob*)context;
+    const int end = offset + bytes;
+    const int tileBytes = CM256_DECODE_TILE_BYTES > 0 ? CM256_DECODE_TILE_BYTES : bytes;
+
+    // Run every step on one byte range of all the blocks before moving on,
+    // so the N recovery ranges stay in L1 between the steps
+    for (; offset < end; offset += tileBytes)
+        DecodeRange(pJob->pDecoder, pJob->matrix, pJob->diag_D, pJob->bEliminated, offset, end - offset < tileBytes ? end - offset : tileBytes);
+}
+
+static int DecodeParallel(CM256Decoder *pDecoder, bool bEliminated, int numThreads)
+{
+    int originalIndex, recoveryIndex, i;
+    // Matrix size is NxN, where N is the number of recovery blocks used.
+    const int N = pDecoder->RecoveryCount;
+
+    // Allocate the elimination matrix, followed by the LDU decomposition
     static const int StackAllocSize = 2048;
     uint8_t stackMatrix[StackAllocSize];
     uint8_t* dynamicMatrix = nullptr;
     uint8_t* matrix = stackMatrix;
-    const int requiredSpace = N * N;
+    const int requiredSpace = N * pDecoder->OriginalCount + N * N;
     if (requiredSpace > StackAllocSize)
     {
         dynamicMatrix = (uint8_t*)malloc(requiredSpace);
+        if (NULL == dynamicMatrix)
+            return -4;
         matrix = dynamicMatrix;
     }
 
@@ -517,64 +1209,231 @@ extern void Decode(CM256Decoder *pDecoder)
         D is a diagonal matrix.
         U is upper-triangular, diagonal is all ones.
     */
-    uint8_t* matrix_U = matrix;
+    uint8_t* matrix_U = matrix + N * pDecoder->OriginalCount;
     uint8_t* diag_D = matrix_U + (N - 1) * N / 2;
     uint8_t* matrix_L = diag_D + N;
-    GenerateLDUDecomposition(pDecoder, matrix_L, diag_D, matrix_U);
 
-    /*
-        Eliminate lower left triangle.
-    */
-    // For each column,
-    for (j = 0; j < N - 1; ++j)
+    // Both matrices only depend on the erasure pattern, reuse them when it was seen before.
+    // A single erasure is cheap to set up and would only crowd out the global patterns.
+    uint8_t key[CM256_CACHE_KEY_BYTES];
+    const int keyBytes = N > 1 ? DecodeCacheKey(pDecoder, CM256_CACHE_LDU, key) : 0;
+    if (N <= 1 || !CacheGet(key, keyBytes, matrix, requiredSpace))
     {
-        const void* block_j = pDecoder->recoveryBlock[j]->pData;
-
-        // For each row,
-        for (i = j + 1; i < N; ++i)
+        for (originalIndex = 0; originalIndex < pDecoder->OriginalCount; ++originalIndex)
         {
-            void* block_i = pDecoder->recoveryBlock[i]->pData;
-            const uint8_t c_ij = *matrix_L++; // Matrix elements are stored column-first, top-down.
+            const uint8_t iElement = pDecoder->originalBlock[originalIndex]->lrcIndex;
+            uint8_t* column = matrix + originalIndex * N;
 
-            gf256_muladd_mem(block_i, c_ij, block_j, pDecoder->Params.BlockBytes);
+            for (recoveryIndex = 0; recoveryIndex < N; ++recoveryIndex)
+                column[recoveryIndex] = GetMatrixElement(pDecoder->recoveryBlock[recoveryIndex]->decodeIndex, pDecoder->Params.TotalOriginalCount, iElement);
         }
+        GenerateLDUDecomposition(pDecoder, matrix_L, diag_D, matrix_U);
+
+        if (N > 1)
+            CachePut(key, keyBytes, matrix, requiredSpace);
     }
 
-    /*
-        Eliminate diagonal.
-    */
-    for (i = 0; i < N; ++i)
-    {
-        uint8_t* blockData = pDecoder->recoveryBlock[i]->pData;
+    // The matrices are only read from here on, the threads share them
+    CM256DecodeJob job;
+    job.pDecoder = pDecoder;
+    job.matrix = matrix;
+    job.diag_D = diag_D;
+    job.rows = NULL;
+    job.rowCount = N;
+    job.bEliminated = bEliminated;
+    cm256_parallel_ranges(DecodeSlice, &job, pDecoder->Params.BlockBytes, numThreads);
 
+    for (i = 0; i < N; ++i)
         pDecoder->recoveryBlock[i]->decodeIndex = pDecoder->recoveryBlock[i]->lrcIndex = pDecoder->ErasuresIndices[i];
 
-        gf256_div_mem(blockData, blockData, diag_D[i], pDecoder->Params.BlockBytes);
+    if (NULL != dynamicMatrix)
+        free(dynamicMatrix);
+    return 0;
+}
+
+extern int Decode(CM256Decoder *pDecoder)
+{
+    return DecodeParallel(pDecoder, false, 1);
+}
+
+/*
+    Computes the recovery matrix of the erasures: erased original i is
+
+        sum_j M[j * N + i] * column_j
+
+    where the columns are the received originals followed by the recovery rows.
+    With G the recovery rows restricted to the erased columns and C restricted
+    to the received ones, recovery = G * erased + C * received, so
+    M = [G^-1 * C | G^-1].  It is found by Gauss-Jordan elimination of [G | C | I].
+*/
+static bool GenerateRecoveryMatrix(CM256Decoder *pDecoder, uint8_t* matrix)
+{
+    const int N = pDecoder->RecoveryCount;
+    const int K = pDecoder->OriginalCount;
+    const int width = N + K + N;
+    const uint8_t x_0 = (uint8_t)pDecoder->Params.TotalOriginalCount;
+    int r, c, j;
+
+    uint8_t* work = (uint8_t*)malloc(N * width);
+    if (NULL == work)
+        return false;
+
+    for (r = 0; r < N; r++)
+    {
+        uint8_t* row = work + r * width;
+        const uint8_t x_r = pDecoder->recoveryBlock[r]->decodeIndex;
+
+        for (c = 0; c < N; c++)
+            row[c] = GetMatrixElement(x_r, x_0, pDecoder->ErasuresIndices[c]);
+        for (j = 0; j < K; j++)
+            row[N + j] = GetMatrixElement(x_r, x_0, pDecoder->originalBlock[j]->lrcIndex);
+        memset(row + N + K, 0, N);
+        row[N + K + r] = 1;
     }
 
+    // Any square part of a Cauchy matrix is invertible, the pivot search only guards against misuse
+    for (c = 0; c < N; c++)
+    {
+        for (r = c; r < N && 0 == work[r * width + c]; r++);
+        if (r >= N)
+        {
+            free(work);
+            return false;
+        }
+        if (r != c)
+            gf256_memswap(work + r * width, work + c * width, width);
+
+        // Scalar scaling: the row is a few bytes and gf256_div_mem() must not alias its arguments
+        uint8_t* pivotRow = work + c * width;
+        const uint8_t pivot = pivotRow[c];
+        for (j = 0; j < width; j++)
+            pivotRow[j] = gf256_div(pivotRow[j], pivot);
+        for (r = 0; r < N; r++)
+        {
+            if (r != c && 0 != work[r * width + c])
+                gf256_muladd_mem(work + r * width, work[r * width + c], pivotRow, width);
+        }
+    }
+
+    // Store it column-first, the layout MulAddColumns() reads
+    for (r = 0; r < N; r++)
+        for (j = 0; j < K + N; j++)
+            matrix[j * N + r] = work[r * width + N + j];
+
+    free(work);
+    return true;
+}
+
+static void DecodeInverseSlice(void* context, int offset, int bytes)
+{
+    const CM256DecodeJob* pJob = (const CM256DecodeJob*)context;
+    const CM256Decoder* pDecoder = pJob->pDecoder;
+    const int N = pDecoder->RecoveryCount;
+    const int K = pDecoder->OriginalCount;
+    const int R = pJob->rowCount;
+    const int end = offset + bytes;
+    int i;
+
     /*
-        Eliminate upper right triangle.
+        Each erased original is one linear combination of all the received blocks.
+        The outputs replace the recovery blocks they are computed from, so each
+        tile of them is finished in a side buffer before it is copied back.
+        Many erasures get shorter tiles to fit the buffer.
     */
-    for (j = N - 1; j >= 1; --j)
+    GF256_ALIGNED uint8_t tiles[CM256_TILE_BYTES * 16];
+    const int tileFit = (int)(sizeof(tiles) / R) & ~(GF256_ALIGN_BYTES - 1);
+    const int tileBytes = tileFit < CM256_TILE_BYTES ? tileFit : CM256_TILE_BYTES;
+    void* outTiles[MAXSHARDS];
+    for (i = 0; i < R; i++)
+        outTiles[i] = tiles + i * tileBytes;
+
+    for (; offset < end; offset += tileBytes)
     {
-        const void* block_j = pDecoder->recoveryBlock[j]->pData;
+        const int tile = end - offset < tileBytes ? end - offset : tileBytes;
+        const void* inTiles[MAXSHARDS];
+
+        for (i = 0; i < K; i++)
+            inTiles[i] = (const uint8_t*)pDecoder->originalBlock[i]->pData + offset;
+        for (i = 0; i < N; i++)
+            inTiles[K + i] = (const uint8_t*)pDecoder->recoveryBlock[i]->pData + offset;
+        MulAddColumns(outTiles, R, inTiles, K + N, pJob->matrix, tile, true);
+        for (i = 0; i < R; i++)
+            memcpy(pDecoder->recoveryBlock[pJob->rows[i]]->pData + offset, outTiles[i], tile);
+    }
+}
 
-        for (i = j - 1; i >= 0; --i)
+/*
+    Recover the erased originals flagged in 'wanted', indexed by element, or all of them
+    when it is NULL.  Only the wanted rows of the recovery matrix are applied, so the cost
+    follows the number of wanted originals rather than the number of erasures.
+*/
+static bool DecodeInverseParallel(CM256Decoder *pDecoder, const bool* wanted, int numThreads)
+{
+    int i, j;
+    const int N = pDecoder->RecoveryCount;
+    const int K = pDecoder->OriginalCount;
+    const int matrixBytes = N * (K + N);
+    int rows[MAXSHARDS], rowCount = 0;
+
+    for (i = 0; i < N; i++)
+    {
+        if (NULL == wanted || wanted[pDecoder->ErasuresIndices[i]])
+            rows[rowCount++] = i;
+    }
+
+    // One allocation for the recovery matrix and the wanted rows of it
+    uint8_t* matrix = (uint8_t*)malloc(matrixBytes + (rowCount < N ? rowCount * (K + N) : 0));
+    if (NULL == matrix)
+        return false;
+
+    uint8_t key[CM256_CACHE_KEY_BYTES];
+    const int keyBytes = DecodeCacheKey(pDecoder, CM256_CACHE_INVERSE, key);
+    if (!CacheGet(key, keyBytes, matrix, matrixBytes))
+    {
+        if (!GenerateRecoveryMatrix(pDecoder, matrix))
         {
-            void* block_i = pDecoder->recoveryBlock[i]->pData;
-            const uint8_t c_ij = *matrix_U++; // Matrix elements are stored column-first, bottom-up.
+            free(matrix);
+            return false;
+        }
+        CachePut(key, keyBytes, matrix, matrixBytes);
+    }
 
-            gf256_muladd_mem(block_i, c_ij, block_j, pDecoder->Params.BlockBytes);
+    // The matrix is only read from here on, the threads share it
+    CM256DecodeJob job;
+    job.pDecoder = pDecoder;
+    job.matrix = matrix;
+    job.diag_D = NULL;
+    job.rows = rows;
+    job.rowCount = rowCount;
+    job.bEliminated = false;
+    if (rowCount < N)
+    {
+        uint8_t* rowMatrix = matrix + matrixBytes;
+        for (j = 0; j < K + N; j++)
+        {
+            for (i = 0; i < rowCount; i++)
+                rowMatrix[j * rowCount + i] = matrix[j * N + rows[i]];
         }
+        job.matrix = rowMatrix;
     }
+    cm256_parallel_ranges(DecodeInverseSlice, &job, pDecoder->Params.BlockBytes, numThreads);
 
-    if (NULL != dynamicMatrix)
-        free(dynamicMatrix);
+    for (i = 0; i < rowCount; i++)
+    {
+        CM256Block* block = pDecoder->recoveryBlock[rows[i]];
+        block->decodeIndex = block->lrcIndex = pDecoder->ErasuresIndices[rows[i]];
+    }
+
+    free(matrix);
+    return true;
 }
 
-extern int cm256_decode(
-    cm256_encoder_params params, // Encoder params
-    CM256Block* blocks)         // Array of 'originalCount' blocks as described above
+extern bool DecodeInverse(CM256Decoder *pDecoder)
+{
+    return DecodeInverseParallel(pDecoder, NULL, 1);
+}
+
+static int DecodeBlocks(cm256_encoder_params params, CM256Block* blocks, const bool* wanted, bool bEliminated, int numThreads)
 {
     if (params.OriginalCount <= 0 || params.RecoveryCount <= 0 || params.TotalOriginalCount < params.OriginalCount || params.BlockBytes <= 0 || params.FirstElement < 0 || params.FirstElement > params.TotalOriginalCount || params.Step <= 0)
     {
@@ -609,6 +1468,24 @@ extern int cm256_decode(
         return 0;
     }
 
+    // Only the NxN solve is left when the received originals were folded in ahead
+    if (bEliminated)
+    {
+        return DecodeParallel(&state, true, numThreads);
+    }
+
+    // If only some of the erasures are wanted, their rows of the inverse are all it takes
+    if (NULL != wanted)
+    {
+        int i, wantedCount = 0;
+        for (i = 0; i < state.RecoveryCount; i++)
+            wantedCount += wanted[state.ErasuresIndices[i]] ? 1 : 0;
+        if (wantedCount <= 0)
+            return 0;
+        if (wantedCount < state.RecoveryCount && DecodeInverseParallel(&state, wanted, numThreads))
+            return 0;
+    }
+
     // If m=1,
     if (params.RecoveryCount == 1 && state.recoveryBlock[0]->decodeIndex == HOR_DECODE_INDEX(&params) )
     {
@@ -616,7 +1493,85 @@ extern int cm256_decode(
         return 0;
     }
 
-    // Decode for m>1
-    Decode(&state);
-    return 0;
+    // Decode for m>1. Many erasures are cheaper through the explicit inverse,
+    // which passes over the blocks once instead of once per elimination step
+    if (state.RecoveryCount >= CM256_INVERSE_MIN_ERASURES &&
+        state.Params.BlockBytes >= CM256_INVERSE_MIN_BYTES && DecodeInverseParallel(&state, NULL, numThreads))
+        return 0;
+    return DecodeParallel(&state, false, numThreads);
+}
+
+extern void cm256_eliminate(
+    const cm256_encoder_params* pParams, // Encoder params
+    CM256Block* const* recovery,         // Recovery blocks to fold the originals into
+    int recoveryCount,
+    const CM256Block* const* originals,  // Original blocks, by lrcIndex
+    int originalCount)
+{
+    int i, j;
+    void* rows[MAXSHARDS];
+    const void* columns[MAXSHARDS];
+    uint8_t stackMatrix[2048];
+    uint8_t* matrix = stackMatrix;
+
+    if (recoveryCount <= 0 || originalCount <= 0)
+        return;
+    if (recoveryCount * originalCount > (int)sizeof(stackMatrix))
+    {
+        matrix = (uint8_t*)malloc(recoveryCount * originalCount);
+        if (NULL == matrix)
+        {
+            // Fold them one at a time without a matrix
+            for (j = 0; j < originalCount; j++)
+                cm256_eliminate(pParams, recovery, recoveryCount, originals + j, 1);
+            return;
+        }
+    }
+
+    // Same elements as the elimination step of Decode()
+    for (j = 0; j < originalCount; j++)
+    {
+        columns[j] = originals[j]->pData;
+        for (i = 0; i < recoveryCount; i++)
+            matrix[j * recoveryCount + i] = GetMatrixElement(recovery[i]->decodeIndex, pParams->TotalOriginalCount, originals[j]->lrcIndex);
+    }
+    for (i = 0; i < recoveryCount; i++)
+        rows[i] = recovery[i]->pData;
+    MulAddColumns(rows, recoveryCount, columns, originalCount, matrix, pParams->BlockBytes, false);
+
+    if (matrix != stackMatrix)
+        free(matrix);
 }
+
+extern int cm256_decode(
+    cm256_encoder_params params, // Encoder params
+    CM256Block* blocks)         // Array of 'originalCount' blocks as described above
+{
+    return cm256_decode_parallel(params, blocks, 1);
+}
+
+extern int cm256_decode_parallel(
+    cm256_encoder_params params, // Encoder params
+    CM256Block* blocks,          // Array of 'originalCount' blocks as described above
+    int numThreads)              // Most threads to use, including the calling thread
+{
+    return DecodeBlocks(params, blocks, NULL, false, numThreads);
+}
+
+extern int cm256_decode_wanted(
+    cm256_encoder_params params, // Encoder params
+    CM256Block* blocks,          // Array of 'originalCount' blocks as described above
+    const bool* wanted,          // Erased originals to recover, indexed by element. NULL for all
+    int numThreads)              // Most threads to use, including the calling thread
+{
+    return DecodeBlocks(params, blocks, wanted, false, numThreads);
+}
+
+extern int cm256_decode_eliminated(
+    cm256_encoder_params params, // Encoder params
+    CM256Block* blocks,          // Array of 'originalCount' blocks as described above
+    int numThreads)              // Most threads to use, including the calling thread
+{
+    return DecodeBlocks(params, blocks, NULL, true, numThreads);
+}
+
@@ -186,11 +186,137 @@ int cm256_decode(
     cm256_encoder_params params, // Encoder parameters
     CM256Block* blocks);        // Array of 'originalCount' blocks as described above
 
+/*
+ * Decode as cm256_decode(), splitting the bytes of the blocks across up to numThreads threads
+ * including the calling one. The decode matrix is built once and shared by the threads.
+ * Output is the same as cm256_decode()
+ */
+int cm256_decode_parallel(
+    cm256_encoder_params params, // Encoder parameters
+    CM256Block* blocks,          // Array of 'originalCount' blocks as described above
+    int numThreads);             // Most threads to use, including the calling thread
+
+/*
+ * Decode as cm256_decode_parallel(), but only recover the erased originals flagged in 'wanted',
+ * which is indexed by element. The blocks of the other erasures keep their recovery data and Index,
+ * and a NULL 'wanted' recovers all of them
+ */
+int cm256_decode_wanted(
+    cm256_encoder_params params, // Encoder parameters
+    CM256Block* blocks,          // Array of 'originalCount' blocks as described above
+    const bool* wanted,          // Erased originals to recover, indexed by element
+    int numThreads);             // Most threads to use, including the calling thread
+
+/*
+ * Fold original blocks into recovery blocks ahead of decoding, e.g. while the other blocks are
+ * still arriving: recovery[i] += c(i, j) * originals[j] for all j, with the elements of the
+ * recovery blocks' decodeIndex rows. Folding each original in once leaves the recovery block
+ * as cm256_decode_eliminated() expects it
+ */
+void cm256_eliminate(
+    const cm256_encoder_params* pParams, // Encoder parameters
+    CM256Block* const* recovery,         // Recovery blocks to fold the originals into
+    int recoveryCount,
+    const CM256Block* const* originals,  // Original blocks
+    int originalCount);
+
+/*
+ * Decode as cm256_decode_parallel(), for recovery blocks that every original block in 'blocks'
+ * was already folded into by cm256_eliminate(). Only the solve for the erasures is left
+ */
+int cm256_decode_eliminated(
+    cm256_encoder_params params, // Encoder parameters
+    CM256Block* blocks,          // Array of 'originalCount' blocks as described above
+    int numThreads);             // Most threads to use, including the calling thread
+
 
 #ifdef __cplusplus
 }
 #endif
 
+// OriginalCount * (GlobalRecoveryCount + 1) never exceeds 128 * 128, since their sum is below 256
+#define CM256_MAX_PLAN_MATRIX (MAXSHARDS * MAXSHARDS / 4)
+
+/*
+    Encode plan: the LRC geometry and every matrix element needed to encode it.
+    It is filled in once by cm256_plan_init() and only read afterwards, so one
+    plan can serve any number of encodes, from any number of threads.
+    Padding positions [OriginalCount, TotalOriginalCount) are zeros that are
+    never read.
+*/
+typedef struct {
+    CM256LRC Param;                 // BlockBytes is given to each encode instead
+    uint8_t HorCount[MAXSHARDS];    // Number of originals in each horizontal group
+    uint8_t VerCount[MAXHORCOUNT];  // Number of originals in each vertical group
+    uint8_t VerMatrix[MAXSHARDS];   // VerLocalCount matrix elements of each vertical group
+    uint8_t GlobalMatrix[CM256_MAX_PLAN_MATRIX]; // GlobalRecoveryCount + 1 matrix elements of each original
+} CM256EncodePlan;
+
+/*
+ * Fill in an encode plan for the geometry in pParam
+ * return: 0 on success, <0 if the geometry is invalid
+ */
+int cm256_plan_init(CM256EncodePlan* pPlan, const CM256LRC* pParam);
+
+/*
+ * Encode with a plan, output is the same as cm256_encode()
+ * originals: OriginalCount blocks of blockBytes each, padding blocks are not needed
+ * return: 0 on success
+ */
+int cm256_encode_plan(const CM256EncodePlan* pPlan, const CM256Block* originals, int blockBytes, uint8_t* recoveryData);
+
+/*
+ * Encode with a plan, splitting the bytes of the blocks across up to numThreads threads
+ * including the calling one. Output is the same as cm256_encode_plan()
+ * return: 0 on success
+ */
+int cm256_encode_plan_parallel(const CM256EncodePlan* pPlan, const CM256Block* originals, int blockBytes, uint8_t* recoveryData, int numThreads);
+
+/*
+ * Incremental encode with a plan. cm256_encode_plan_begin() writes the index bytes and clears
+ * the recovery blocks, then cm256_encode_plan_add() folds each original block into every recovery
+ * block it contributes to, in any order. Once all OriginalCount blocks have been added exactly
+ * once, recoveryData is the same as the output of cm256_encode_plan()
+ * return: 0 on success
+ */
+int cm256_encode_plan_begin(const CM256EncodePlan* pPlan, int blockBytes, uint8_t* recoveryData);
+int cm256_encode_plan_add(const CM256EncodePlan* pPlan, int originalIndex, const uint8_t* pData, int blockBytes, uint8_t* recoveryData);
+
+/*
+ * Update recovery blocks encoded with a plan in place, after original block originalIndex
+ * changed from pOldData to pNewData. Only the recovery blocks depending on it are written.
+ * return: 0 on success
+ */
+int cm256_encode_plan_update(const CM256EncodePlan* pPlan, int originalIndex, const uint8_t* pOldData, const uint8_t* pNewData, int blockBytes, uint8_t* recoveryData);
+
+// Most threads one call splits its work across
+#define CM256_MAX_THREADS 64
+
+#ifndef CM256_MIN_THREAD_BYTES
+// Bytes of each block a worker thread gets at least, smaller slices cost
+// more to start a thread for than they save
+#define CM256_MIN_THREAD_BYTES (4 * 1024)
+#endif
+
+// Work on bytes [offset, offset + bytes) of every block, or on units [offset, offset + bytes) of other work
+typedef void (*CM256RangeTask)(void* context, int offset, int bytes);
+
+/*
+ * Split bytes [0, blockBytes) into disjoint slices and run task on each of them, in the
+ * calling thread and in up to numThreads - 1 worker threads. Worker threads are shared
+ * by all callers, so concurrent calls never run more of them than there are cores.
+ * Slices are no smaller than a few KB, small blocks are done by the calling thread alone.
+ * return: number of slices the work was split into
+ */
+int cm256_parallel_ranges(CM256RangeTask task, void* context, int blockBytes, int numThreads);
+
+/*
+ * As cm256_parallel_ranges(), for any work split into 'total' units, e.g. stripes of a batch.
+ * Each slice has at least minSlice units, and starts at a multiple of align units.
+ * return: number of slices the work was split into
+ */
+int cm256_parallel_slices(CM256RangeTask task, void* context, int total, int minSlice, int align, int numThreads);
+
 typedef struct {
     // Encode parameters
     cm256_encoder_params Params;
@@ -213,8 +339,45 @@ typedef struct {
 // Decode m=1 case
 void DecodeM1(CM256Decoder *pDecoder);
 
-// Decode for m>1 case
-void Decode(CM256Decoder *pDecoder);
+// Decode for m>1 case, return 0 on success, -4 if out of memory
+int Decode(CM256Decoder *pDecoder);
+
+#ifndef CM256_DEFAULT_CACHE_ENTRIES
+// Decode matrices cached by default, one for each erasure pattern seen recently
+#define CM256_DEFAULT_CACHE_ENTRIES 64
+#endif
+#define CM256_MAX_CACHE_ENTRIES 4096
+
+/*
+ * Set how many decode matrices are cached, 0 disables the cache. The cache is shared by all threads.
+ * return: the number now in use
+ */
+int cm256_cache_configure(int maxEntries);
+
+/*
+ * Get the number of cache hits and misses since start, and the number of matrices cached now.
+ * Any pointer may be NULL
+ */
+void cm256_cache_stats(unsigned long* pHits, unsigned long* pMisses, int* pEntries);
+
+#ifndef CM256_DECODE_TILE_BYTES
+// Bytes of all blocks that Decode() and DecodeM1() finish before moving on, 0 for whole blocks
+#define CM256_DECODE_TILE_BYTES 4096
+#endif
+
+#ifndef CM256_INVERSE_MIN_ERASURES
+// Erasures from which cm256_decode() uses DecodeInverse() instead of Decode()
+#define CM256_INVERSE_MIN_ERASURES 3
+#endif
+
+#ifndef CM256_INVERSE_MIN_BYTES
+// Block size from which the single pass pays for its per-tile overhead
+#define CM256_INVERSE_MIN_BYTES (2 * 1024)
+#endif
+
+// Decode for m>1 case in one pass over the blocks, with the explicit inverse of the recovery rows.
+// Return false if it could not allocate memory, the blocks are untouched then
+bool DecodeInverse(CM256Decoder *pDecoder);
 
 // Generate the LU decomposition of the matrix
 void GenerateLDUDecomposition(CM256Decoder *pDecoder, uint8_t* matrix_L, uint8_t* diag_D, uint8_t* matrix_U);
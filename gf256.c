@@ -169,6 +169,57 @@ static bool gf256_self_test()
         if (m_SelfTestBuffers.A[i] != expectedMul)
             return false;
 
+    // Check the bulk kernels agree with the MUL table for every constant
+    for (j = 2; j < 256; ++j)
+    {
+        for (i = 0; i < kTestBufferBytes; ++i)
+        {
+            m_SelfTestBuffers.A[i] = (uint8_t)(i * 37 + j);
+            m_SelfTestBuffers.B[i] = (uint8_t)(i * 91);
+        }
+        gf256_muladd_mem(m_SelfTestBuffers.A, (uint8_t)j, m_SelfTestBuffers.B, kTestBufferBytes);
+        gf256_mul_mem(m_SelfTestBuffers.C, m_SelfTestBuffers.B, (uint8_t)j, kTestBufferBytes);
+        for (i = 0; i < kTestBufferBytes; ++i)
+        {
+            const uint8_t expected = gf256_mul((uint8_t)(i * 91), (uint8_t)j);
+            if (m_SelfTestBuffers.C[i] != expected ||
+                m_SelfTestBuffers.A[i] != (uint8_t)(expected ^ (uint8_t)(i * 37 + j)))
+                return false;
+        }
+    }
+
+    // Test gf256_dot_mem() and gf256_muladd_multi_mem(): C = A * 0x6c + B * 0xa2
+    {
+        const uint8_t dotY[2] = { 0x6c, 0xa2 };
+        const void * dotX[2] = { m_SelfTestBuffers.A, m_SelfTestBuffers.B };
+        gf256_dot_mem(m_SelfTestBuffers.C, dotY, dotX, 2, kTestBufferBytes);
+        for (i = 0; i < kTestBufferBytes; ++i)
+            if (m_SelfTestBuffers.C[i] != (uint8_t)(gf256_mul(m_SelfTestBuffers.A[i], 0x6c) ^
+                                                     gf256_mul(m_SelfTestBuffers.B[i], 0xa2)))
+                return false;
+        gf256_muladd_multi_mem(m_SelfTestBuffers.C, dotY, dotX, 2, kTestBufferBytes);
+        for (i = 0; i < kTestBufferBytes; ++i)
+            if (m_SelfTestBuffers.C[i] != 0)
+                return false;
+    }
+
+    // Test gf256_muladd_multi_dest_mem(): A += B * 0x6c, C += B * 0xa2
+    {
+        const uint8_t destY[2] = { 0x6c, 0xa2 };
+        void * destZ[2] = { m_SelfTestBuffers.A, m_SelfTestBuffers.C };
+        for (i = 0; i < kTestBufferBytes; ++i)
+        {
+            m_SelfTestBuffers.A[i] = (uint8_t)(i * 37);
+            m_SelfTestBuffers.B[i] = (uint8_t)(i * 91);
+            m_SelfTestBuffers.C[i] = (uint8_t)(i * 13);
+        }
+        gf256_muladd_multi_dest_mem(destZ, destY, 2, m_SelfTestBuffers.B, kTestBufferBytes);
+        for (i = 0; i < kTestBufferBytes; ++i)
+            if (m_SelfTestBuffers.A[i] != (uint8_t)((i * 37) ^ gf256_mul((uint8_t)(i * 91), 0x6c)) ||
+                m_SelfTestBuffers.C[i] != (uint8_t)((i * 13) ^ gf256_mul((uint8_t)(i * 91), 0xa2)))
+                return false;
+    }
+
     if (m_SelfTestBuffers.A[kTestBufferBytes] != 0x5a)
         return false;
     if (m_SelfTestBuffers.B[kTestBufferBytes] != 0x5a)
@@ -216,10 +267,20 @@ static bool CpuHasNeon64 = false;   // And we don't have ASIMD
 #ifdef GF256_TRY_AVX2
 static bool CpuHasAVX2 = false;
 #endif
+#ifdef GF256_TRY_GFNI
+static bool CpuHasGFNI = false;
+#endif
 static bool CpuHasSSSE3 = false;
 
-#define CPUID_EBX_AVX2    0x00000020
-#define CPUID_ECX_SSSE3   0x00000200
+#define CPUID_EBX_AVX2     0x00000020
+#define CPUID_EBX_AVX512F  0x00010000
+#define CPUID_EBX_AVX512BW 0x40000000
+#define CPUID_ECX_GFNI     0x00000100
+#define CPUID_ECX_SSSE3    0x00000200
+#define CPUID_ECX_OSXSAVE  0x08000000
+#define CPUID_ECX_AVX      0x10000000
+#define XCR0_SSE_AVX       0x00000006 // XMM and YMM state enabled by the OS
+#define XCR0_AVX512        0x000000e0 // Opmask and ZMM state enabled by the OS
 
 static void _cpuid(unsigned int cpu_info[4U], const unsigned int cpu_info_type)
 {
@@ -258,6 +319,19 @@ static void _cpuid(unsigned int cpu_info[4U], const unsigned int cpu_info_type)
 #endif
 }
 
+// Read XCR0 to check which register state the OS saves on context switch
+static unsigned int _xgetbv0()
+{
+#if defined(_MSC_VER)
+    return (unsigned int)_xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0" /* xgetbv */ :
+                          "=a" (eax), "=d" (edx) : "c" (0));
+    return eax;
+#endif
+}
+
 #else
 #if defined(LINUX_ARM)
 static void checkLinuxARMNeonCapabilities( bool& cpuHasNeon )
@@ -285,6 +359,9 @@ static void checkLinuxARMNeonCapabilities( bool& cpuHasNeon )
 #endif
 #endif // defined(GF256_TARGET_MOBILE)
 
+// GF256_ISA_* flags found by gf256_architecture_init()
+static unsigned DetectedIsa = 0;
+
 static void gf256_architecture_init()
 {
 #if defined(GF256_TRY_NEON)
@@ -315,13 +392,39 @@ static void gf256_architecture_init()
 #if !defined(GF256_TARGET_MOBILE)
     unsigned int cpu_info[4];
 
+    _cpuid(cpu_info, 0);
+    const unsigned int maxLeaf = cpu_info[0];
+
     _cpuid(cpu_info, 1);
     CpuHasSSSE3 = ((cpu_info[2] & CPUID_ECX_SSSE3) != 0);
 
 #if defined(GF256_TRY_AVX2)
-    _cpuid(cpu_info, 7);
-    CpuHasAVX2 = ((cpu_info[1] & CPUID_EBX_AVX2) != 0);
+    // AVX2 also needs the OS to preserve the upper halves of YMM registers
+    const bool osHasAVX = (cpu_info[2] & (CPUID_ECX_OSXSAVE | CPUID_ECX_AVX)) == (CPUID_ECX_OSXSAVE | CPUID_ECX_AVX) &&
+                          (_xgetbv0() & XCR0_SSE_AVX) == XCR0_SSE_AVX;
+    if (maxLeaf >= 7 && osHasAVX)
+    {
+        _cpuid(cpu_info, 7);
+        CpuHasAVX2 = ((cpu_info[1] & CPUID_EBX_AVX2) != 0);
+
+#if defined(GF256_TRY_GFNI)
+        const unsigned int ebxAVX512 = CPUID_EBX_AVX512F | CPUID_EBX_AVX512BW;
+        CpuHasGFNI = (cpu_info[2] & CPUID_ECX_GFNI) != 0 &&
+                     (cpu_info[1] & ebxAVX512) == ebxAVX512 &&
+                     (_xgetbv0() & XCR0_AVX512) == XCR0_AVX512;
+#endif // GF256_TRY_GFNI
+    }
+#endif // GF256_TRY_AVX2
+
+    DetectedIsa = CpuHasSSSE3 ? GF256_ISA_SSSE3 : 0;
+#if defined(GF256_TRY_AVX2)
+    if (CpuHasAVX2)
+        DetectedIsa |= GF256_ISA_AVX2;
 #endif // GF256_TRY_AVX2
+#if defined(GF256_TRY_GFNI)
+    if (CpuHasGFNI)
+        DetectedIsa |= GF256_ISA_GFNI;
+#endif // GF256_TRY_GFNI
 
     // When AVX2 and SSSE3 are unavailable, Siamese takes 4x longer to decode
     // and 2.6x longer to encode.  Encoding requires a lot more simple XOR ops
@@ -333,6 +436,40 @@ static void gf256_architecture_init()
 }
 
 
+extern unsigned gf256_get_isa()
+{
+    unsigned isa = 0;
+#if !defined(GF256_TARGET_MOBILE)
+    if (CpuHasSSSE3)
+        isa |= GF256_ISA_SSSE3;
+#endif // GF256_TARGET_MOBILE
+#if defined(GF256_TRY_AVX2)
+    if (CpuHasAVX2)
+        isa |= GF256_ISA_AVX2;
+#endif // GF256_TRY_AVX2
+#if defined(GF256_TRY_GFNI)
+    if (CpuHasGFNI)
+        isa |= GF256_ISA_GFNI;
+#endif // GF256_TRY_GFNI
+    return isa;
+}
+
+extern unsigned gf256_set_isa(unsigned mask)
+{
+    mask &= DetectedIsa;
+#if !defined(GF256_TARGET_MOBILE)
+    CpuHasSSSE3 = (mask & GF256_ISA_SSSE3) != 0;
+#endif // GF256_TARGET_MOBILE
+#if defined(GF256_TRY_AVX2)
+    CpuHasAVX2 = (mask & GF256_ISA_AVX2) != 0;
+#endif // GF256_TRY_AVX2
+#if defined(GF256_TRY_GFNI)
+    CpuHasGFNI = (mask & GF256_ISA_GFNI) != 0;
+#endif // GF256_TRY_GFNI
+    return gf256_get_isa();
+}
+
+
 //------------------------------------------------------------------------------
 // Context Object
 
@@ -600,18 +737,42 @@ static void gf256_mul_mem_init()
         _mm_storeu_si128(GF256Ctx.MM128.TABLE_LO_Y + y, table_lo);
         _mm_storeu_si128(GF256Ctx.MM128.TABLE_HI_Y + y, table_hi);
 # ifdef GF256_TRY_AVX2
-        if (CpuHasAVX2)
-        {
-            const GF256_M256 table_lo2 = _mm256_broadcastsi128_si256(table_lo);
-            const GF256_M256 table_hi2 = _mm256_broadcastsi128_si256(table_hi);
-            _mm256_storeu_si256(GF256Ctx.MM256.TABLE_LO_Y + y, table_lo2);
-            _mm256_storeu_si256(GF256Ctx.MM256.TABLE_HI_Y + y, table_hi2);
-        }
+        // Both 128-bit lanes hold the same table, since _mm256_shuffle_epi8 looks up within each lane.
+        // Plain copies keep this function free of AVX2 instructions.
+        memcpy((uint8_t*)(GF256Ctx.MM256.TABLE_LO_Y + y), lo, 16);
+        memcpy((uint8_t*)(GF256Ctx.MM256.TABLE_LO_Y + y) + 16, lo, 16);
+        memcpy((uint8_t*)(GF256Ctx.MM256.TABLE_HI_Y + y), hi, 16);
+        memcpy((uint8_t*)(GF256Ctx.MM256.TABLE_HI_Y + y) + 16, hi, 16);
 # endif // GF256_TRY_AVX2
 #endif // GF256_TARGET_MOBILE
     }
 }
 
+#ifdef GF256_TRY_GFNI
+/*
+    GF2P8AFFINEQB(x, A) computes an 8x8 bit matrix times each byte of x,
+    where bit i of the result is parity(A.byte[7 - i] & x).  Multiplication
+    by a constant y is linear over GF(2), so column j of the matrix is simply
+    the product (1 << j) * y.  This works for any generator polynomial.
+*/
+static void gf256_gfni_init()
+{
+    int y, i, j;
+    for (y = 0; y < 256; ++y)
+    {
+        uint64_t matrix = 0;
+        for (i = 0; i < 8; ++i)
+        {
+            uint8_t row = 0;
+            for (j = 0; j < 8; ++j)
+                row |= (uint8_t)(((gf256_mul((uint8_t)(1 << j), (uint8_t)y) >> i) & 1) << j);
+            matrix |= (uint64_t)row << ((7 - i) * 8);
+        }
+        GF256Ctx.GFNI.AFFINE_Y[y] = matrix;
+    }
+}
+#endif // GF256_TRY_GFNI
+
 #ifdef  TANGCODE
 /*
  *  Initial 128+M recovery matrixes
@@ -686,6 +847,9 @@ extern int gf256_init_(int version)
     gf256_inv_init();
     gf256_sqr_init();
     gf256_mul_mem_init();
+    #ifdef GF256_TRY_GFNI
+        gf256_gfni_init();
+    #endif
     #ifdef TANGCODE
         gf256_128_init();   // Initial 128+M recovery matrixes
     #endif
@@ -697,6 +861,709 @@ extern int gf256_init_(int version)
 }
 
 
+//------------------------------------------------------------------------------
+// x86 SIMD Kernels
+//
+// Each kernel is built for its own instruction set with GF256_TARGET_*, so the
+// rest of the library stays SSE2-only.  They handle as many whole registers as
+// possible and return the number of bytes done; the caller finishes the tail.
+
+#ifdef GF256_TRY_AVX2
+
+static GF256_TARGET_AVX2 int gf256_add_mem_avx2(void * GF256_RESTRICT vx,
+                                                const void * GF256_RESTRICT vy, int bytes)
+{
+    GF256_M256 * GF256_RESTRICT x32 = (GF256_M256 *)(vx);
+    const GF256_M256 * GF256_RESTRICT y32 = (const GF256_M256 *)(vy);
+    const int total = bytes;
+
+    while (bytes >= 128)
+    {
+        GF256_M256 x0 = _mm256_loadu_si256(x32);
+        GF256_M256 y0 = _mm256_loadu_si256(y32);
+        x0 = _mm256_xor_si256(x0, y0);
+        GF256_M256 x1 = _mm256_loadu_si256(x32 + 1);
+        GF256_M256 y1 = _mm256_loadu_si256(y32 + 1);
+        x1 = _mm256_xor_si256(x1, y1);
+        GF256_M256 x2 = _mm256_loadu_si256(x32 + 2);
+        GF256_M256 y2 = _mm256_loadu_si256(y32 + 2);
+        x2 = _mm256_xor_si256(x2, y2);
+        GF256_M256 x3 = _mm256_loadu_si256(x32 + 3);
+        GF256_M256 y3 = _mm256_loadu_si256(y32 + 3);
+        x3 = _mm256_xor_si256(x3, y3);
+
+        _mm256_storeu_si256(x32, x0);
+        _mm256_storeu_si256(x32 + 1, x1);
+        _mm256_storeu_si256(x32 + 2, x2);
+        _mm256_storeu_si256(x32 + 3, x3);
+
+        bytes -= 128, x32 += 4, y32 += 4;
+    }
+
+    // Handle multiples of 32 bytes
+    while (bytes >= 32)
+    {
+        // x[i] = x[i] xor y[i]
+        _mm256_storeu_si256(x32,
+            _mm256_xor_si256(
+                _mm256_loadu_si256(x32),
+                _mm256_loadu_si256(y32)));
+
+        bytes -= 32, ++x32, ++y32;
+    }
+
+    return total - bytes;
+}
+
+static GF256_TARGET_AVX2 int gf256_add2_mem_avx2(void * GF256_RESTRICT vz, const void * GF256_RESTRICT vx,
+                                                 const void * GF256_RESTRICT vy, int bytes)
+{
+    GF256_M256 * GF256_RESTRICT z32 = (GF256_M256 *)(vz);
+    const GF256_M256 * GF256_RESTRICT x32 = (const GF256_M256 *)(vx);
+    const GF256_M256 * GF256_RESTRICT y32 = (const GF256_M256 *)(vy);
+
+    const int count = bytes / 32;
+    int i;
+    for (i = 0; i < count; ++i)
+    {
+        _mm256_storeu_si256(z32 + i,
+            _mm256_xor_si256(
+                _mm256_loadu_si256(z32 + i),
+                _mm256_xor_si256(
+                    _mm256_loadu_si256(x32 + i),
+                    _mm256_loadu_si256(y32 + i))));
+    }
+
+    return count * 32;
+}
+
+static GF256_TARGET_AVX2 int gf256_addset_mem_avx2(void * GF256_RESTRICT vz, const void * GF256_RESTRICT vx,
+                                                   const void * GF256_RESTRICT vy, int bytes)
+{
+    GF256_M256 * GF256_RESTRICT z32 = (GF256_M256 *)(vz);
+    const GF256_M256 * GF256_RESTRICT x32 = (const GF256_M256 *)(vx);
+    const GF256_M256 * GF256_RESTRICT y32 = (const GF256_M256 *)(vy);
+
+    const int count = bytes / 32;
+    int i;
+    for (i = 0; i < count; ++i)
+    {
+        _mm256_storeu_si256(z32 + i,
+            _mm256_xor_si256(
+                _mm256_loadu_si256(x32 + i),
+                _mm256_loadu_si256(y32 + i)));
+    }
+
+    return count * 32;
+}
+
+static GF256_TARGET_AVX2 int gf256_mul_mem_avx2(void * GF256_RESTRICT vz, const void * GF256_RESTRICT vx,
+                                                uint8_t y, int bytes)
+{
+    // Partial product tables; see above
+    const GF256_M256 table_lo_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_LO_Y + y);
+    const GF256_M256 table_hi_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_HI_Y + y);
+
+    // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
+    const GF256_M256 clr_mask = _mm256_set1_epi8(0x0f);
+
+    GF256_M256 * GF256_RESTRICT z32 = (GF256_M256 *)(vz);
+    const GF256_M256 * GF256_RESTRICT x32 = (const GF256_M256 *)(vx);
+    const int total = bytes;
+
+    // Handle multiples of 32 bytes
+    while (bytes >= 32)
+    {
+        // See above comments for details
+        GF256_M256 x0 = _mm256_loadu_si256(x32);
+        GF256_M256 l0 = _mm256_and_si256(x0, clr_mask);
+        x0 = _mm256_srli_epi64(x0, 4);
+        GF256_M256 h0 = _mm256_and_si256(x0, clr_mask);
+        l0 = _mm256_shuffle_epi8(table_lo_y, l0);
+        h0 = _mm256_shuffle_epi8(table_hi_y, h0);
+        _mm256_storeu_si256(z32, _mm256_xor_si256(l0, h0));
+
+        bytes -= 32, ++x32, ++z32;
+    }
+
+    return total - bytes;
+}
+
+static GF256_TARGET_AVX2 int gf256_muladd_mem_avx2(void * GF256_RESTRICT vz, uint8_t y,
+                                                   const void * GF256_RESTRICT vx, int bytes)
+{
+    // Partial product tables; see above
+    const GF256_M256 table_lo_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_LO_Y + y);
+    const GF256_M256 table_hi_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_HI_Y + y);
+
+    // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
+    const GF256_M256 clr_mask = _mm256_set1_epi8(0x0f);
+
+    GF256_M256 * GF256_RESTRICT z32 = (GF256_M256 *)(vz);
+    const GF256_M256 * GF256_RESTRICT x32 = (const GF256_M256 *)(vx);
+    const int total = bytes;
+
+    // On my Reed Solomon codec, the encoder unit test runs in 640 usec without and 550 usec with the optimization (86% of the original time)
+    const int count = bytes / 64;
+    int i;
+    for (i = 0; i < count; ++i)
+    {
+        // See above comments for details
+        GF256_M256 x0 = _mm256_loadu_si256(x32 + i * 2);
+        GF256_M256 l0 = _mm256_and_si256(x0, clr_mask);
+        x0 = _mm256_srli_epi64(x0, 4);
+        const GF256_M256 z0 = _mm256_loadu_si256(z32 + i * 2);
+        GF256_M256 h0 = _mm256_and_si256(x0, clr_mask);
+        l0 = _mm256_shuffle_epi8(table_lo_y, l0);
+        h0 = _mm256_shuffle_epi8(table_hi_y, h0);
+        const GF256_M256 p0 = _mm256_xor_si256(l0, h0);
+        _mm256_storeu_si256(z32 + i * 2, _mm256_xor_si256(p0, z0));
+
+        GF256_M256 x1 = _mm256_loadu_si256(x32 + i * 2 + 1);
+        GF256_M256 l1 = _mm256_and_si256(x1, clr_mask);
+        x1 = _mm256_srli_epi64(x1, 4);
+        const GF256_M256 z1 = _mm256_loadu_si256(z32 + i * 2 + 1);
+        GF256_M256 h1 = _mm256_and_si256(x1, clr_mask);
+        l1 = _mm256_shuffle_epi8(table_lo_y, l1);
+        h1 = _mm256_shuffle_epi8(table_hi_y, h1);
+        const GF256_M256 p1 = _mm256_xor_si256(l1, h1);
+        _mm256_storeu_si256(z32 + i * 2 + 1, _mm256_xor_si256(p1, z1));
+    }
+    bytes -= count * 64;
+    z32 += count * 2;
+    x32 += count * 2;
+
+    if (bytes >= 32)
+    {
+        GF256_M256 x0 = _mm256_loadu_si256(x32);
+        GF256_M256 l0 = _mm256_and_si256(x0, clr_mask);
+        x0 = _mm256_srli_epi64(x0, 4);
+        GF256_M256 h0 = _mm256_and_si256(x0, clr_mask);
+        l0 = _mm256_shuffle_epi8(table_lo_y, l0);
+        h0 = _mm256_shuffle_epi8(table_hi_y, h0);
+        const GF256_M256 p0 = _mm256_xor_si256(l0, h0);
+        const GF256_M256 z0 = _mm256_loadu_si256(z32);
+        _mm256_storeu_si256(z32, _mm256_xor_si256(p0, z0));
+
+        bytes -= 32;
+    }
+
+    return total - bytes;
+}
+
+// Multiply 32 bytes of x by the constant whose nibble tables are given
+static GF256_TARGET_AVX2 GF256_FORCE_INLINE GF256_M256 gf256_product_avx2(
+    GF256_M256 table_lo_y, GF256_M256 table_hi_y, GF256_M256 clr_mask, GF256_M256 x0)
+{
+    const GF256_M256 l0 = _mm256_shuffle_epi8(table_lo_y, _mm256_and_si256(x0, clr_mask));
+    const GF256_M256 h0 = _mm256_shuffle_epi8(table_hi_y, _mm256_and_si256(_mm256_srli_epi64(x0, 4), clr_mask));
+    return _mm256_xor_si256(l0, h0);
+}
+
+static GF256_TARGET_AVX2 int gf256_dot_mem_avx2(uint8_t * GF256_RESTRICT z, const uint8_t * y,
+                                                const void * const * vx, int count,
+                                                int offset, int bytes, bool add)
+{
+    // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
+    const GF256_M256 clr_mask = _mm256_set1_epi8(0x0f);
+    int i;
+
+    // Keep 64 bytes of z in registers while every source is folded in
+    for (; offset + 64 <= bytes; offset += 64)
+    {
+        GF256_M256 s0 = _mm256_setzero_si256(), s1 = _mm256_setzero_si256();
+        if (add)
+        {
+            s0 = _mm256_loadu_si256((const GF256_M256 *)(z + offset));
+            s1 = _mm256_loadu_si256((const GF256_M256 *)(z + offset + 32));
+        }
+
+        for (i = 0; i < count; ++i)
+        {
+            const GF256_M256 table_lo_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_LO_Y + y[i]);
+            const GF256_M256 table_hi_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_HI_Y + y[i]);
+            const uint8_t * x1 = (const uint8_t *)vx[i] + offset;
+
+            s0 = _mm256_xor_si256(s0, gf256_product_avx2(table_lo_y, table_hi_y, clr_mask,
+                                                          _mm256_loadu_si256((const GF256_M256 *)x1)));
+            s1 = _mm256_xor_si256(s1, gf256_product_avx2(table_lo_y, table_hi_y, clr_mask,
+                                                          _mm256_loadu_si256((const GF256_M256 *)(x1 + 32))));
+        }
+
+        _mm256_storeu_si256((GF256_M256 *)(z + offset), s0);
+        _mm256_storeu_si256((GF256_M256 *)(z + offset + 32), s1);
+    }
+
+    if (offset + 32 <= bytes)
+    {
+        GF256_M256 s0 = add ? _mm256_loadu_si256((const GF256_M256 *)(z + offset)) : _mm256_setzero_si256();
+
+        for (i = 0; i < count; ++i)
+        {
+            const GF256_M256 table_lo_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_LO_Y + y[i]);
+            const GF256_M256 table_hi_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_HI_Y + y[i]);
+            const GF256_M256 x0 = _mm256_loadu_si256((const GF256_M256 *)((const uint8_t *)vx[i] + offset));
+
+            s0 = _mm256_xor_si256(s0, gf256_product_avx2(table_lo_y, table_hi_y, clr_mask, x0));
+        }
+
+        _mm256_storeu_si256((GF256_M256 *)(z + offset), s0);
+        offset += 32;
+    }
+
+    return offset;
+}
+
+static GF256_TARGET_AVX2 int gf256_muladd_multi_dest_mem_avx2(void * const * vz, const uint8_t * y, int count,
+                                                              const uint8_t * GF256_RESTRICT x, int offset, int bytes)
+{
+    // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
+    const GF256_M256 clr_mask = _mm256_set1_epi8(0x0f);
+    int i;
+
+    // Split 64 bytes of x into nibbles once, then apply them to every z
+    for (; offset + 64 <= bytes; offset += 64)
+    {
+        GF256_M256 x0 = _mm256_loadu_si256((const GF256_M256 *)(x + offset));
+        GF256_M256 x1 = _mm256_loadu_si256((const GF256_M256 *)(x + offset + 32));
+        const GF256_M256 l0 = _mm256_and_si256(x0, clr_mask);
+        const GF256_M256 l1 = _mm256_and_si256(x1, clr_mask);
+        const GF256_M256 h0 = _mm256_and_si256(_mm256_srli_epi64(x0, 4), clr_mask);
+        const GF256_M256 h1 = _mm256_and_si256(_mm256_srli_epi64(x1, 4), clr_mask);
+
+        for (i = 0; i < count; ++i)
+        {
+            const GF256_M256 table_lo_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_LO_Y + y[i]);
+            const GF256_M256 table_hi_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_HI_Y + y[i]);
+            GF256_M256 * z32 = (GF256_M256 *)((uint8_t *)vz[i] + offset);
+
+            const GF256_M256 p0 = _mm256_xor_si256(_mm256_shuffle_epi8(table_lo_y, l0), _mm256_shuffle_epi8(table_hi_y, h0));
+            const GF256_M256 p1 = _mm256_xor_si256(_mm256_shuffle_epi8(table_lo_y, l1), _mm256_shuffle_epi8(table_hi_y, h1));
+            _mm256_storeu_si256(z32, _mm256_xor_si256(p0, _mm256_loadu_si256(z32)));
+            _mm256_storeu_si256(z32 + 1, _mm256_xor_si256(p1, _mm256_loadu_si256(z32 + 1)));
+        }
+    }
+
+    if (offset + 32 <= bytes)
+    {
+        GF256_M256 x0 = _mm256_loadu_si256((const GF256_M256 *)(x + offset));
+
+        for (i = 0; i < count; ++i)
+        {
+            const GF256_M256 table_lo_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_LO_Y + y[i]);
+            const GF256_M256 table_hi_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_HI_Y + y[i]);
+            GF256_M256 * z32 = (GF256_M256 *)((uint8_t *)vz[i] + offset);
+
+            const GF256_M256 p0 = gf256_product_avx2(table_lo_y, table_hi_y, clr_mask, x0);
+            _mm256_storeu_si256(z32, _mm256_xor_si256(p0, _mm256_loadu_si256(z32)));
+        }
+        offset += 32;
+    }
+
+    return offset;
+}
+
+#endif // GF256_TRY_AVX2
+
+#ifdef GF256_TRY_GFNI
+
+// Byte mask for the first n < 64 bytes of a 512-bit register
+#define GF256_TAIL_MASK(n) (((__mmask64)1 << (n)) - 1)
+
+static GF256_TARGET_GFNI int gf256_mul_mem_gfni(void * GF256_RESTRICT vz, const void * GF256_RESTRICT vx,
+                                                uint8_t y, int bytes)
+{
+    const __m512i matrix = _mm512_set1_epi64((long long)GF256Ctx.GFNI.AFFINE_Y[y]);
+    uint8_t * GF256_RESTRICT z1 = (uint8_t *)(vz);
+    const uint8_t * GF256_RESTRICT x1 = (const uint8_t *)(vx);
+    const int total = bytes;
+
+    while (bytes >= 128)
+    {
+        const __m512i x0 = _mm512_loadu_si512(x1);
+        const __m512i x1v = _mm512_loadu_si512(x1 + 64);
+        _mm512_storeu_si512(z1, _mm512_gf2p8affine_epi64_epi8(x0, matrix, 0));
+        _mm512_storeu_si512(z1 + 64, _mm512_gf2p8affine_epi64_epi8(x1v, matrix, 0));
+
+        bytes -= 128, x1 += 128, z1 += 128;
+    }
+
+    if (bytes >= 64)
+    {
+        const __m512i x0 = _mm512_loadu_si512(x1);
+        _mm512_storeu_si512(z1, _mm512_gf2p8affine_epi64_epi8(x0, matrix, 0));
+
+        bytes -= 64, x1 += 64, z1 += 64;
+    }
+
+    // Masked loads and stores finish the tail without touching bytes past the end
+    if (bytes > 0)
+    {
+        const __mmask64 mask = GF256_TAIL_MASK(bytes);
+        const __m512i x0 = _mm512_maskz_loadu_epi8(mask, x1);
+        _mm512_mask_storeu_epi8(z1, mask, _mm512_gf2p8affine_epi64_epi8(x0, matrix, 0));
+    }
+
+    return total;
+}
+
+static GF256_TARGET_GFNI int gf256_muladd_mem_gfni(void * GF256_RESTRICT vz, uint8_t y,
+                                                   const void * GF256_RESTRICT vx, int bytes)
+{
+    const __m512i matrix = _mm512_set1_epi64((long long)GF256Ctx.GFNI.AFFINE_Y[y]);
+    uint8_t * GF256_RESTRICT z1 = (uint8_t *)(vz);
+    const uint8_t * GF256_RESTRICT x1 = (const uint8_t *)(vx);
+    const int total = bytes;
+
+    while (bytes >= 128)
+    {
+        const __m512i p0 = _mm512_gf2p8affine_epi64_epi8(_mm512_loadu_si512(x1), matrix, 0);
+        const __m512i p1 = _mm512_gf2p8affine_epi64_epi8(_mm512_loadu_si512(x1 + 64), matrix, 0);
+        _mm512_storeu_si512(z1, _mm512_xor_si512(p0, _mm512_loadu_si512(z1)));
+        _mm512_storeu_si512(z1 + 64, _mm512_xor_si512(p1, _mm512_loadu_si512(z1 + 64)));
+
+        bytes -= 128, x1 += 128, z1 += 128;
+    }
+
+    if (bytes >= 64)
+    {
+        const __m512i p0 = _mm512_gf2p8affine_epi64_epi8(_mm512_loadu_si512(x1), matrix, 0);
+        _mm512_storeu_si512(z1, _mm512_xor_si512(p0, _mm512_loadu_si512(z1)));
+
+        bytes -= 64, x1 += 64, z1 += 64;
+    }
+
+    if (bytes > 0)
+    {
+        const __mmask64 mask = GF256_TAIL_MASK(bytes);
+        const __m512i p0 = _mm512_gf2p8affine_epi64_epi8(_mm512_maskz_loadu_epi8(mask, x1), matrix, 0);
+        const __m512i z0 = _mm512_maskz_loadu_epi8(mask, z1);
+        _mm512_mask_storeu_epi8(z1, mask, _mm512_xor_si512(p0, z0));
+    }
+
+    return total;
+}
+
+static GF256_TARGET_GFNI int gf256_dot_mem_gfni(uint8_t * GF256_RESTRICT z, const uint8_t * y,
+                                                const void * const * vx, int count,
+                                                int offset, int bytes, bool add)
+{
+    int i;
+
+    // Keep 256 bytes of z in registers while every source is folded in
+    for (; offset + 256 <= bytes; offset += 256)
+    {
+        __m512i s0 = _mm512_setzero_si512(), s1 = s0, s2 = s0, s3 = s0;
+        if (add)
+        {
+            s0 = _mm512_loadu_si512(z + offset);
+            s1 = _mm512_loadu_si512(z + offset + 64);
+            s2 = _mm512_loadu_si512(z + offset + 128);
+            s3 = _mm512_loadu_si512(z + offset + 192);
+        }
+
+        for (i = 0; i < count; ++i)
+        {
+            const __m512i matrix = _mm512_set1_epi64((long long)GF256Ctx.GFNI.AFFINE_Y[y[i]]);
+            const uint8_t * x1 = (const uint8_t *)vx[i] + offset;
+
+            s0 = _mm512_xor_si512(s0, _mm512_gf2p8affine_epi64_epi8(_mm512_loadu_si512(x1), matrix, 0));
+            s1 = _mm512_xor_si512(s1, _mm512_gf2p8affine_epi64_epi8(_mm512_loadu_si512(x1 + 64), matrix, 0));
+            s2 = _mm512_xor_si512(s2, _mm512_gf2p8affine_epi64_epi8(_mm512_loadu_si512(x1 + 128), matrix, 0));
+            s3 = _mm512_xor_si512(s3, _mm512_gf2p8affine_epi64_epi8(_mm512_loadu_si512(x1 + 192), matrix, 0));
+        }
+
+        _mm512_storeu_si512(z + offset, s0);
+        _mm512_storeu_si512(z + offset + 64, s1);
+        _mm512_storeu_si512(z + offset + 128, s2);
+        _mm512_storeu_si512(z + offset + 192, s3);
+    }
+
+    // Remaining 64-byte registers, the last one masked
+    while (offset < bytes)
+    {
+        const __mmask64 mask = bytes - offset >= 64 ? ~(__mmask64)0 : GF256_TAIL_MASK(bytes - offset);
+        __m512i s0 = add ? _mm512_maskz_loadu_epi8(mask, z + offset) : _mm512_setzero_si512();
+
+        for (i = 0; i < count; ++i)
+        {
+            const __m512i matrix = _mm512_set1_epi64((long long)GF256Ctx.GFNI.AFFINE_Y[y[i]]);
+            const __m512i x0 = _mm512_maskz_loadu_epi8(mask, (const uint8_t *)vx[i] + offset);
+
+            s0 = _mm512_xor_si512(s0, _mm512_gf2p8affine_epi64_epi8(x0, matrix, 0));
+        }
+
+        _mm512_mask_storeu_epi8(z + offset, mask, s0);
+        offset += 64;
+    }
+
+    return bytes;
+}
+
+static GF256_TARGET_GFNI int gf256_muladd_multi_dest_mem_gfni(void * const * vz, const uint8_t * y, int count,
+                                                              const uint8_t * GF256_RESTRICT x, int offset, int bytes)
+{
+    int i;
+
+    // Load 256 bytes of x once, then apply them to every z
+    for (; offset + 256 <= bytes; offset += 256)
+    {
+        const __m512i x0 = _mm512_loadu_si512(x + offset);
+        const __m512i x1 = _mm512_loadu_si512(x + offset + 64);
+        const __m512i x2 = _mm512_loadu_si512(x + offset + 128);
+        const __m512i x3 = _mm512_loadu_si512(x + offset + 192);
+
+        for (i = 0; i < count; ++i)
+        {
+            const __m512i matrix = _mm512_set1_epi64((long long)GF256Ctx.GFNI.AFFINE_Y[y[i]]);
+            uint8_t * z1 = (uint8_t *)vz[i] + offset;
+
+            _mm512_storeu_si512(z1, _mm512_xor_si512(_mm512_loadu_si512(z1),
+                _mm512_gf2p8affine_epi64_epi8(x0, matrix, 0)));
+            _mm512_storeu_si512(z1 + 64, _mm512_xor_si512(_mm512_loadu_si512(z1 + 64),
+                _mm512_gf2p8affine_epi64_epi8(x1, matrix, 0)));
+            _mm512_storeu_si512(z1 + 128, _mm512_xor_si512(_mm512_loadu_si512(z1 + 128),
+                _mm512_gf2p8affine_epi64_epi8(x2, matrix, 0)));
+            _mm512_storeu_si512(z1 + 192, _mm512_xor_si512(_mm512_loadu_si512(z1 + 192),
+                _mm512_gf2p8affine_epi64_epi8(x3, matrix, 0)));
+        }
+    }
+
+    // Remaining 64-byte registers, the last one masked
+    while (offset < bytes)
+    {
+        const __mmask64 mask = bytes - offset >= 64 ? ~(__mmask64)0 : GF256_TAIL_MASK(bytes - offset);
+        const __m512i x0 = _mm512_maskz_loadu_epi8(mask, x + offset);
+
+        for (i = 0; i < count; ++i)
+        {
+            const __m512i matrix = _mm512_set1_epi64((long long)GF256Ctx.GFNI.AFFINE_Y[y[i]]);
+            uint8_t * z1 = (uint8_t *)vz[i] + offset;
+
+            _mm512_mask_storeu_epi8(z1, mask, _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, z1),
+                _mm512_gf2p8affine_epi64_epi8(x0, matrix, 0)));
+        }
+        offset += 64;
+    }
+
+    return bytes;
+}
+
+#endif // GF256_TRY_GFNI
+
+#if !defined(GF256_TARGET_MOBILE)
+
+static GF256_TARGET_SSSE3 int gf256_mul_mem_ssse3(void * GF256_RESTRICT vz, const void * GF256_RESTRICT vx,
+                                                  uint8_t y, int bytes)
+{
+    // Partial product tables; see above
+    const GF256_M128 table_lo_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_LO_Y + y);
+    const GF256_M128 table_hi_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_HI_Y + y);
+
+    // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
+    const GF256_M128 clr_mask = _mm_set1_epi8(0x0f);
+
+    GF256_M128 * GF256_RESTRICT z16 = (GF256_M128 *)(vz);
+    const GF256_M128 * GF256_RESTRICT x16 = (const GF256_M128 *)(vx);
+    const int total = bytes;
+
+    // Handle multiples of 16 bytes
+    while (bytes >= 16)
+    {
+        // See above comments for details
+        GF256_M128 x0 = _mm_loadu_si128(x16);
+        GF256_M128 l0 = _mm_and_si128(x0, clr_mask);
+        x0 = _mm_srli_epi64(x0, 4);
+        GF256_M128 h0 = _mm_and_si128(x0, clr_mask);
+        l0 = _mm_shuffle_epi8(table_lo_y, l0);
+        h0 = _mm_shuffle_epi8(table_hi_y, h0);
+        _mm_storeu_si128(z16, _mm_xor_si128(l0, h0));
+
+        bytes -= 16, ++x16, ++z16;
+    }
+
+    return total - bytes;
+}
+
+static GF256_TARGET_SSSE3 int gf256_muladd_mem_ssse3(void * GF256_RESTRICT vz, uint8_t y,
+                                                     const void * GF256_RESTRICT vx, int bytes)
+{
+    // Partial product tables; see above
+    const GF256_M128 table_lo_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_LO_Y + y);
+    const GF256_M128 table_hi_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_HI_Y + y);
+
+    // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
+    const GF256_M128 clr_mask = _mm_set1_epi8(0x0f);
+
+    GF256_M128 * GF256_RESTRICT z16 = (GF256_M128 *)(vz);
+    const GF256_M128 * GF256_RESTRICT x16 = (const GF256_M128 *)(vx);
+    const int total = bytes;
+
+    // This unroll seems to provide about 7% speed boost when AVX2 is disabled
+    while (bytes >= 32)
+    {
+        bytes -= 32;
+
+        GF256_M128 x1 = _mm_loadu_si128(x16 + 1);
+        GF256_M128 l1 = _mm_and_si128(x1, clr_mask);
+        x1 = _mm_srli_epi64(x1, 4);
+        GF256_M128 h1 = _mm_and_si128(x1, clr_mask);
+        l1 = _mm_shuffle_epi8(table_lo_y, l1);
+        h1 = _mm_shuffle_epi8(table_hi_y, h1);
+        const GF256_M128 z1 = _mm_loadu_si128(z16 + 1);
+
+        GF256_M128 x0 = _mm_loadu_si128(x16);
+        GF256_M128 l0 = _mm_and_si128(x0, clr_mask);
+        x0 = _mm_srli_epi64(x0, 4);
+        GF256_M128 h0 = _mm_and_si128(x0, clr_mask);
+        l0 = _mm_shuffle_epi8(table_lo_y, l0);
+        h0 = _mm_shuffle_epi8(table_hi_y, h0);
+        const GF256_M128 z0 = _mm_loadu_si128(z16);
+
+        const GF256_M128 p1 = _mm_xor_si128(l1, h1);
+        _mm_storeu_si128(z16 + 1, _mm_xor_si128(p1, z1));
+
+        const GF256_M128 p0 = _mm_xor_si128(l0, h0);
+        _mm_storeu_si128(z16, _mm_xor_si128(p0, z0));
+
+        x16 += 2, z16 += 2;
+    }
+
+    // Handle multiples of 16 bytes
+    while (bytes >= 16)
+    {
+        // See above comments for details
+        GF256_M128 x0 = _mm_loadu_si128(x16);
+        GF256_M128 l0 = _mm_and_si128(x0, clr_mask);
+        x0 = _mm_srli_epi64(x0, 4);
+        GF256_M128 h0 = _mm_and_si128(x0, clr_mask);
+        l0 = _mm_shuffle_epi8(table_lo_y, l0);
+        h0 = _mm_shuffle_epi8(table_hi_y, h0);
+        const GF256_M128 p0 = _mm_xor_si128(l0, h0);
+        const GF256_M128 z0 = _mm_loadu_si128(z16);
+        _mm_storeu_si128(z16, _mm_xor_si128(p0, z0));
+
+        bytes -= 16, ++x16, ++z16;
+    }
+
+    return total - bytes;
+}
+
+// Multiply 16 bytes of x by the constant whose nibble tables are given
+static GF256_TARGET_SSSE3 GF256_FORCE_INLINE GF256_M128 gf256_product_ssse3(
+    GF256_M128 table_lo_y, GF256_M128 table_hi_y, GF256_M128 clr_mask, GF256_M128 x0)
+{
+    const GF256_M128 l0 = _mm_shuffle_epi8(table_lo_y, _mm_and_si128(x0, clr_mask));
+    const GF256_M128 h0 = _mm_shuffle_epi8(table_hi_y, _mm_and_si128(_mm_srli_epi64(x0, 4), clr_mask));
+    return _mm_xor_si128(l0, h0);
+}
+
+static GF256_TARGET_SSSE3 int gf256_dot_mem_ssse3(uint8_t * GF256_RESTRICT z, const uint8_t * y,
+                                                  const void * const * vx, int count,
+                                                  int offset, int bytes, bool add)
+{
+    // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
+    const GF256_M128 clr_mask = _mm_set1_epi8(0x0f);
+    int i;
+
+    // Keep 32 bytes of z in registers while every source is folded in
+    for (; offset + 32 <= bytes; offset += 32)
+    {
+        GF256_M128 s0 = _mm_setzero_si128(), s1 = _mm_setzero_si128();
+        if (add)
+        {
+            s0 = _mm_loadu_si128((const GF256_M128 *)(z + offset));
+            s1 = _mm_loadu_si128((const GF256_M128 *)(z + offset + 16));
+        }
+
+        for (i = 0; i < count; ++i)
+        {
+            const GF256_M128 table_lo_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_LO_Y + y[i]);
+            const GF256_M128 table_hi_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_HI_Y + y[i]);
+            const uint8_t * x1 = (const uint8_t *)vx[i] + offset;
+
+            s0 = _mm_xor_si128(s0, gf256_product_ssse3(table_lo_y, table_hi_y, clr_mask,
+                                                        _mm_loadu_si128((const GF256_M128 *)x1)));
+            s1 = _mm_xor_si128(s1, gf256_product_ssse3(table_lo_y, table_hi_y, clr_mask,
+                                                        _mm_loadu_si128((const GF256_M128 *)(x1 + 16))));
+        }
+
+        _mm_storeu_si128((GF256_M128 *)(z + offset), s0);
+        _mm_storeu_si128((GF256_M128 *)(z + offset + 16), s1);
+    }
+
+    if (offset + 16 <= bytes)
+    {
+        GF256_M128 s0 = add ? _mm_loadu_si128((const GF256_M128 *)(z + offset)) : _mm_setzero_si128();
+
+        for (i = 0; i < count; ++i)
+        {
+            const GF256_M128 table_lo_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_LO_Y + y[i]);
+            const GF256_M128 table_hi_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_HI_Y + y[i]);
+            const GF256_M128 x0 = _mm_loadu_si128((const GF256_M128 *)((const uint8_t *)vx[i] + offset));
+
+            s0 = _mm_xor_si128(s0, gf256_product_ssse3(table_lo_y, table_hi_y, clr_mask, x0));
+        }
+
+        _mm_storeu_si128((GF256_M128 *)(z + offset), s0);
+        offset += 16;
+    }
+
+    return offset;
+}
+
+static GF256_TARGET_SSSE3 int gf256_muladd_multi_dest_mem_ssse3(void * const * vz, const uint8_t * y, int count,
+                                                                const uint8_t * GF256_RESTRICT x, int offset, int bytes)
+{
+    // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
+    const GF256_M128 clr_mask = _mm_set1_epi8(0x0f);
+    int i;
+
+    // Split 32 bytes of x into nibbles once, then apply them to every z
+    for (; offset + 32 <= bytes; offset += 32)
+    {
+        GF256_M128 x0 = _mm_loadu_si128((const GF256_M128 *)(x + offset));
+        GF256_M128 x1 = _mm_loadu_si128((const GF256_M128 *)(x + offset + 16));
+        const GF256_M128 l0 = _mm_and_si128(x0, clr_mask);
+        const GF256_M128 l1 = _mm_and_si128(x1, clr_mask);
+        const GF256_M128 h0 = _mm_and_si128(_mm_srli_epi64(x0, 4), clr_mask);
+        const GF256_M128 h1 = _mm_and_si128(_mm_srli_epi64(x1, 4), clr_mask);
+
+        for (i = 0; i < count; ++i)
+        {
+            const GF256_M128 table_lo_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_LO_Y + y[i]);
+            const GF256_M128 table_hi_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_HI_Y + y[i]);
+            GF256_M128 * z16 = (GF256_M128 *)((uint8_t *)vz[i] + offset);
+
+            const GF256_M128 p0 = _mm_xor_si128(_mm_shuffle_epi8(table_lo_y, l0), _mm_shuffle_epi8(table_hi_y, h0));
+            const GF256_M128 p1 = _mm_xor_si128(_mm_shuffle_epi8(table_lo_y, l1), _mm_shuffle_epi8(table_hi_y, h1));
+            _mm_storeu_si128(z16, _mm_xor_si128(p0, _mm_loadu_si128(z16)));
+            _mm_storeu_si128(z16 + 1, _mm_xor_si128(p1, _mm_loadu_si128(z16 + 1)));
+        }
+    }
+
+    if (offset + 16 <= bytes)
+    {
+        GF256_M128 x0 = _mm_loadu_si128((const GF256_M128 *)(x + offset));
+
+        for (i = 0; i < count; ++i)
+        {
+            const GF256_M128 table_lo_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_LO_Y + y[i]);
+            const GF256_M128 table_hi_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_HI_Y + y[i]);
+            GF256_M128 * z16 = (GF256_M128 *)((uint8_t *)vz[i] + offset);
+
+            const GF256_M128 p0 = gf256_product_ssse3(table_lo_y, table_hi_y, clr_mask, x0);
+            _mm_storeu_si128(z16, _mm_xor_si128(p0, _mm_loadu_si128(z16)));
+        }
+        offset += 16;
+    }
+
+    return offset;
+}
+
+#endif // !GF256_TARGET_MOBILE
+
+
 //------------------------------------------------------------------------------
 // Operations
 
@@ -706,8 +1573,8 @@ extern void gf256_add_mem(void * GF256_RESTRICT vx,
     GF256_M128 * GF256_RESTRICT x16 = (GF256_M128 *)(vx);
     const GF256_M128 * GF256_RESTRICT y16 = (const GF256_M128 *)(vy);
 
-    int ii;
 #if defined(GF256_TARGET_MOBILE)
+    int ii;
 # if defined(GF256_TRY_NEON)
     // Handle multiples of 64 bytes
     if (CpuHasNeon)
@@ -765,46 +1632,10 @@ extern void gf256_add_mem(void * GF256_RESTRICT vx,
 # if defined(GF256_TRY_AVX2)
     if (CpuHasAVX2)
     {
-        GF256_M256 * GF256_RESTRICT x32 = (GF256_M256 *)(x16);
-        const GF256_M256 * GF256_RESTRICT y32 = (const GF256_M256 *)(y16);
-
-        while (bytes >= 128)
-        {
-            GF256_M256 x0 = _mm256_loadu_si256(x32);
-            GF256_M256 y0 = _mm256_loadu_si256(y32);
-            x0 = _mm256_xor_si256(x0, y0);
-            GF256_M256 x1 = _mm256_loadu_si256(x32 + 1);
-            GF256_M256 y1 = _mm256_loadu_si256(y32 + 1);
-            x1 = _mm256_xor_si256(x1, y1);
-            GF256_M256 x2 = _mm256_loadu_si256(x32 + 2);
-            GF256_M256 y2 = _mm256_loadu_si256(y32 + 2);
-            x2 = _mm256_xor_si256(x2, y2);
-            GF256_M256 x3 = _mm256_loadu_si256(x32 + 3);
-            GF256_M256 y3 = _mm256_loadu_si256(y32 + 3);
-            x3 = _mm256_xor_si256(x3, y3);
-
-            _mm256_storeu_si256(x32, x0);
-            _mm256_storeu_si256(x32 + 1, x1);
-            _mm256_storeu_si256(x32 + 2, x2);
-            _mm256_storeu_si256(x32 + 3, x3);
-
-            bytes -= 128, x32 += 4, y32 += 4;
-        }
-
-        // Handle multiples of 32 bytes
-        while (bytes >= 32)
-        {
-            // x[i] = x[i] xor y[i]
-            _mm256_storeu_si256(x32,
-                _mm256_xor_si256(
-                    _mm256_loadu_si256(x32),
-                    _mm256_loadu_si256(y32)));
-
-            bytes -= 32, ++x32, ++y32;
-        }
-
-        x16 = (GF256_M128 *)(x32);
-        y16 = (const GF256_M128 *)(y32);
+        const int done = gf256_add_mem_avx2(x16, y16, bytes);
+        x16 = (GF256_M128 *)((uint8_t *)x16 + done);
+        y16 = (const GF256_M128 *)((const uint8_t *)y16 + done);
+        bytes -= done;
     }
     else
 # endif // GF256_TRY_AVX2
@@ -888,8 +1719,8 @@ extern void gf256_add2_mem(void * GF256_RESTRICT vz, const void * GF256_RESTRICT
     const GF256_M128 * GF256_RESTRICT x16 = (const GF256_M128*)(vx);
     const GF256_M128 * GF256_RESTRICT y16 = (const GF256_M128*)(vy);
 
-    int ii;
 #if defined(GF256_TARGET_MOBILE)
+    int ii;
 # if defined(GF256_TRY_NEON)
     // Handle multiples of 64 bytes
     if (CpuHasNeon)
@@ -929,25 +1760,11 @@ extern void gf256_add2_mem(void * GF256_RESTRICT vz, const void * GF256_RESTRICT
 # if defined(GF256_TRY_AVX2)
     if (CpuHasAVX2)
     {
-        GF256_M256 * GF256_RESTRICT z32 = (GF256_M256 *)(z16);
-        const GF256_M256 * GF256_RESTRICT x32 = (const GF256_M256 *)(x16);
-        const GF256_M256 * GF256_RESTRICT y32 = (const GF256_M256 *)(y16);
-
-        const unsigned count = bytes / 32;
-        for ( i = 0; i < count; ++i)
-        {
-            _mm256_storeu_si256(z32 + i,
-                _mm256_xor_si256(
-                    _mm256_loadu_si256(z32 + i),
-                    _mm256_xor_si256(
-                        _mm256_loadu_si256(x32 + i),
-                        _mm256_loadu_si256(y32 + i))));
-        }
-
-        bytes -= count * 32;
-        z16 = (GF256_M128 *)(z32 + count);
-        x16 = (const GF256_M128 *)(x32 + count);
-        y16 = (const GF256_M128 *)(y32 + count);
+        const int done = gf256_add2_mem_avx2(z16, x16, y16, bytes);
+        z16 = (GF256_M128 *)((uint8_t *)z16 + done);
+        x16 = (const GF256_M128 *)((const uint8_t *)x16 + done);
+        y16 = (const GF256_M128 *)((const uint8_t *)y16 + done);
+        bytes -= done;
     }
 # endif // GF256_TRY_AVX2
 
@@ -1067,23 +1884,11 @@ extern void gf256_addset_mem(void * GF256_RESTRICT vz, const void * GF256_RESTRI
 # if defined(GF256_TRY_AVX2)
     if (CpuHasAVX2)
     {
-        GF256_M256 * GF256_RESTRICT z32 = (GF256_M256 *)(z16);
-        const GF256_M256 * GF256_RESTRICT x32 = (const GF256_M256 *)(x16);
-        const GF256_M256 * GF256_RESTRICT y32 = (const GF256_M256 *)(y16);
-
-        const unsigned count = bytes / 32;
-        for ( i = 0; i < count; ++i)
-        {
-            _mm256_storeu_si256(z32 + i,
-                _mm256_xor_si256(
-                    _mm256_loadu_si256(x32 + i),
-                    _mm256_loadu_si256(y32 + i)));
-        }
-
-        bytes -= count * 32;
-        z16 = (GF256_M128 *)(z32 + count);
-        x16 = (const GF256_M128 *)(x32 + count);
-        y16 = (const GF256_M128 *)(y32 + count);
+        const int done = gf256_addset_mem_avx2(z16, x16, y16, bytes);
+        z16 = (GF256_M128 *)((uint8_t *)z16 + done);
+        x16 = (const GF256_M128 *)((const uint8_t *)x16 + done);
+        y16 = (const GF256_M128 *)((const uint8_t *)y16 + done);
+        bytes -= done;
     }
     else
 # endif // GF256_TRY_AVX2
@@ -1201,61 +2006,28 @@ extern void gf256_mul_mem(void * GF256_RESTRICT vz, const void * GF256_RESTRICT
     }
 #endif
 #else
+# if defined(GF256_TRY_GFNI)
+    if (CpuHasGFNI)
+    {
+        gf256_mul_mem_gfni(z16, x16, y, bytes);
+        return;
+    }
+# endif // GF256_TRY_GFNI
 # if defined(GF256_TRY_AVX2)
     if (bytes >= 32 && CpuHasAVX2)
     {
-        // Partial product tables; see above
-        const GF256_M256 table_lo_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_LO_Y + y);
-        const GF256_M256 table_hi_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_HI_Y + y);
-
-        // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
-        const GF256_M256 clr_mask = _mm256_set1_epi8(0x0f);
-
-        GF256_M256 * GF256_RESTRICT z32 = (GF256_M256 *)(vz);
-        const GF256_M256 * GF256_RESTRICT x32 = (const GF256_M256 *)(vx);
-
-        // Handle multiples of 32 bytes
-        do
-        {
-            // See above comments for details
-            GF256_M256 x0 = _mm256_loadu_si256(x32);
-            GF256_M256 l0 = _mm256_and_si256(x0, clr_mask);
-            x0 = _mm256_srli_epi64(x0, 4);
-            GF256_M256 h0 = _mm256_and_si256(x0, clr_mask);
-            l0 = _mm256_shuffle_epi8(table_lo_y, l0);
-            h0 = _mm256_shuffle_epi8(table_hi_y, h0);
-            _mm256_storeu_si256(z32, _mm256_xor_si256(l0, h0));
-
-            bytes -= 32, ++x32, ++z32;
-        } while (bytes >= 32);
-
-        z16 = (GF256_M128 *)(z32);
-        x16 = (const GF256_M128 *)(x32);
+        const int done = gf256_mul_mem_avx2(z16, x16, y, bytes);
+        z16 = (GF256_M128 *)((uint8_t *)z16 + done);
+        x16 = (const GF256_M128 *)((const uint8_t *)x16 + done);
+        bytes -= done;
     }
 # endif // GF256_TRY_AVX2
     if (bytes >= 16 && CpuHasSSSE3)
     {
-        // Partial product tables; see above
-        const GF256_M128 table_lo_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_LO_Y + y);
-        const GF256_M128 table_hi_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_HI_Y + y);
-
-        // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
-        const GF256_M128 clr_mask = _mm_set1_epi8(0x0f);
-
-        // Handle multiples of 16 bytes
-        do
-        {
-            // See above comments for details
-            GF256_M128 x0 = _mm_loadu_si128(x16);
-            GF256_M128 l0 = _mm_and_si128(x0, clr_mask);
-            x0 = _mm_srli_epi64(x0, 4);
-            GF256_M128 h0 = _mm_and_si128(x0, clr_mask);
-            l0 = _mm_shuffle_epi8(table_lo_y, l0);
-            h0 = _mm_shuffle_epi8(table_hi_y, h0);
-            _mm_storeu_si128(z16, _mm_xor_si128(l0, h0));
-
-            bytes -= 16, ++x16, ++z16;
-        } while (bytes >= 16);
+        const int done = gf256_mul_mem_ssse3(z16, x16, y, bytes);
+        z16 = (GF256_M128 *)((uint8_t *)z16 + done);
+        x16 = (const GF256_M128 *)((const uint8_t *)x16 + done);
+        bytes -= done;
     }
 #endif
 
@@ -1349,124 +2121,28 @@ extern void gf256_muladd_mem(void * GF256_RESTRICT vz, uint8_t y,
     }
 #endif
 #else // GF256_TARGET_MOBILE
+# if defined(GF256_TRY_GFNI)
+    if (CpuHasGFNI)
+    {
+        gf256_muladd_mem_gfni(z16, y, x16, bytes);
+        return;
+    }
+# endif // GF256_TRY_GFNI
 # if defined(GF256_TRY_AVX2)
     if (bytes >= 32 && CpuHasAVX2)
     {
-        // Partial product tables; see above
-        const GF256_M256 table_lo_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_LO_Y + y);
-        const GF256_M256 table_hi_y = _mm256_loadu_si256(GF256Ctx.MM256.TABLE_HI_Y + y);
-
-        // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
-        const GF256_M256 clr_mask = _mm256_set1_epi8(0x0f);
-
-        GF256_M256 * GF256_RESTRICT z32 = (GF256_M256 *)(z16);
-        const GF256_M256 * GF256_RESTRICT x32 = (const GF256_M256 *)(x16);
-
-        // On my Reed Solomon codec, the encoder unit test runs in 640 usec without and 550 usec with the optimization (86% of the original time)
-        const unsigned count = bytes / 64;
-        for ( i = 0; i < count; ++i)
-        {
-            // See above comments for details
-            GF256_M256 x0 = _mm256_loadu_si256(x32 + i * 2);
-            GF256_M256 l0 = _mm256_and_si256(x0, clr_mask);
-            x0 = _mm256_srli_epi64(x0, 4);
-            const GF256_M256 z0 = _mm256_loadu_si256(z32 + i * 2);
-            GF256_M256 h0 = _mm256_and_si256(x0, clr_mask);
-            l0 = _mm256_shuffle_epi8(table_lo_y, l0);
-            h0 = _mm256_shuffle_epi8(table_hi_y, h0);
-            const GF256_M256 p0 = _mm256_xor_si256(l0, h0);
-            _mm256_storeu_si256(z32 + i * 2, _mm256_xor_si256(p0, z0));
-
-            GF256_M256 x1 = _mm256_loadu_si256(x32 + i * 2 + 1);
-            GF256_M256 l1 = _mm256_and_si256(x1, clr_mask);
-            x1 = _mm256_srli_epi64(x1, 4);
-            const GF256_M256 z1 = _mm256_loadu_si256(z32 + i * 2 + 1);
-            GF256_M256 h1 = _mm256_and_si256(x1, clr_mask);
-            l1 = _mm256_shuffle_epi8(table_lo_y, l1);
-            h1 = _mm256_shuffle_epi8(table_hi_y, h1);
-            const GF256_M256 p1 = _mm256_xor_si256(l1, h1);
-            _mm256_storeu_si256(z32 + i * 2 + 1, _mm256_xor_si256(p1, z1));
-        }
-        bytes -= count * 64;
-        z32 += count * 2;
-        x32 += count * 2;
-
-        if (bytes >= 32)
-        {
-            GF256_M256 x0 = _mm256_loadu_si256(x32);
-            GF256_M256 l0 = _mm256_and_si256(x0, clr_mask);
-            x0 = _mm256_srli_epi64(x0, 4);
-            GF256_M256 h0 = _mm256_and_si256(x0, clr_mask);
-            l0 = _mm256_shuffle_epi8(table_lo_y, l0);
-            h0 = _mm256_shuffle_epi8(table_hi_y, h0);
-            const GF256_M256 p0 = _mm256_xor_si256(l0, h0);
-            const GF256_M256 z0 = _mm256_loadu_si256(z32);
-            _mm256_storeu_si256(z32, _mm256_xor_si256(p0, z0));
-
-            bytes -= 32;
-            z32++;
-            x32++;
-        }
-
-        z16 = (GF256_M128 *)(z32);
-        x16 = (const GF256_M128 *)(x32);
+        const int done = gf256_muladd_mem_avx2(z16, y, x16, bytes);
+        z16 = (GF256_M128 *)((uint8_t *)z16 + done);
+        x16 = (const GF256_M128 *)((const uint8_t *)x16 + done);
+        bytes -= done;
     }
 # endif // GF256_TRY_AVX2
     if (bytes >= 16 && CpuHasSSSE3)
     {
-        // Partial product tables; see above
-        const GF256_M128 table_lo_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_LO_Y + y);
-        const GF256_M128 table_hi_y = _mm_loadu_si128(GF256Ctx.MM128.TABLE_HI_Y + y);
-
-        // clr_mask = 0x0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f0f
-        const GF256_M128 clr_mask = _mm_set1_epi8(0x0f);
-
-        // This unroll seems to provide about 7% speed boost when AVX2 is disabled
-        while (bytes >= 32)
-        {
-            bytes -= 32;
-
-            GF256_M128 x1 = _mm_loadu_si128(x16 + 1);
-            GF256_M128 l1 = _mm_and_si128(x1, clr_mask);
-            x1 = _mm_srli_epi64(x1, 4);
-            GF256_M128 h1 = _mm_and_si128(x1, clr_mask);
-            l1 = _mm_shuffle_epi8(table_lo_y, l1);
-            h1 = _mm_shuffle_epi8(table_hi_y, h1);
-            const GF256_M128 z1 = _mm_loadu_si128(z16 + 1);
-
-            GF256_M128 x0 = _mm_loadu_si128(x16);
-            GF256_M128 l0 = _mm_and_si128(x0, clr_mask);
-            x0 = _mm_srli_epi64(x0, 4);
-            GF256_M128 h0 = _mm_and_si128(x0, clr_mask);
-            l0 = _mm_shuffle_epi8(table_lo_y, l0);
-            h0 = _mm_shuffle_epi8(table_hi_y, h0);
-            const GF256_M128 z0 = _mm_loadu_si128(z16);
-
-            const GF256_M128 p1 = _mm_xor_si128(l1, h1);
-            _mm_storeu_si128(z16 + 1, _mm_xor_si128(p1, z1));
-
-            const GF256_M128 p0 = _mm_xor_si128(l0, h0);
-            _mm_storeu_si128(z16, _mm_xor_si128(p0, z0));
-
-            x16 += 2, z16 += 2;
-        }
-
-        // Handle multiples of 16 bytes
-        while (bytes >= 16)
-        {
-            // See above comments for details
-            GF256_M128 x0 = _mm_loadu_si128(x16);
-            GF256_M128 l0 = _mm_and_si128(x0, clr_mask);
-            x0 = _mm_srli_epi64(x0, 4);
-            GF256_M128 h0 = _mm_and_si128(x0, clr_mask);
-            l0 = _mm_shuffle_epi8(table_lo_y, l0);
-            h0 = _mm_shuffle_epi8(table_hi_y, h0);
-            const GF256_M128 p0 = _mm_xor_si128(l0, h0);
-            const GF256_M128 z0 = _mm_loadu_si128(z16);
-            _mm_storeu_si128(z16, _mm_xor_si128(p0, z0));
-
-            bytes -= 16, ++x16, ++z16;
-        }
+        const int done = gf256_muladd_mem_ssse3(z16, y, x16, bytes);
+        z16 = (GF256_M128 *)((uint8_t *)z16 + done);
+        x16 = (const GF256_M128 *)((const uint8_t *)x16 + done);
+        bytes -= done;
     }
 #endif // GF256_TARGET_MOBILE
 
@@ -1515,10 +2191,119 @@ extern void gf256_muladd_mem(void * GF256_RESTRICT vz, uint8_t y,
     }
 }
 
+static void gf256_dot_mem_group(uint8_t * GF256_RESTRICT z, const uint8_t * y,
+                                const void * const * vx, int count, int bytes, bool add)
+{
+    int offset = 0, i = 0;
+
+#if !defined(GF256_TARGET_MOBILE)
+# if defined(GF256_TRY_GFNI)
+    if (CpuHasGFNI)
+        offset = gf256_dot_mem_gfni(z, y, vx, count, offset, bytes, add);
+# endif // GF256_TRY_GFNI
+# if defined(GF256_TRY_AVX2)
+    if (bytes - offset >= 32 && CpuHasAVX2)
+        offset = gf256_dot_mem_avx2(z, y, vx, count, offset, bytes, add);
+# endif // GF256_TRY_AVX2
+    if (bytes - offset >= 16 && CpuHasSSSE3)
+        offset = gf256_dot_mem_ssse3(z, y, vx, count, offset, bytes, add);
+#endif // GF256_TARGET_MOBILE
+
+    // Finish the tail (or everything, without x86 SIMD) one source at a time
+    if (offset >= bytes)
+        return;
+    if (!add)
+    {
+        if (count <= 0)
+        {
+            memset(z + offset, 0, bytes - offset);
+            return;
+        }
+        gf256_mul_mem(z + offset, (const uint8_t *)vx[0] + offset, y[0], bytes - offset);
+        i = 1;
+    }
+    for (; i < count; ++i)
+        gf256_muladd_mem(z + offset, y[i], (const uint8_t *)vx[i] + offset, bytes - offset);
+}
+
+#ifndef GF256_DOT_SOURCES
+// Sources folded in per pass.  Streaming many more inputs than this at once
+// defeats the hardware prefetchers, which costs more than re-reading z.
+#define GF256_DOT_SOURCES 8
+#endif
+#ifndef GF256_DOT_TILE
+// Bytes of z per tile, so z stays in L1 cache between groups of sources
+#define GF256_DOT_TILE 4096
+#endif
+
+static void gf256_dot_mem_(uint8_t * GF256_RESTRICT z, const uint8_t * y,
+                           const void * const * vx, int count, int bytes, bool add)
+{
+    const void * tileX[GF256_DOT_SOURCES];
+    int tile, i, j;
+
+    if (count <= GF256_DOT_SOURCES)
+    {
+        gf256_dot_mem_group(z, y, vx, count, bytes, add);
+        return;
+    }
+
+    for (tile = 0; tile < bytes; tile += GF256_DOT_TILE)
+    {
+        const int tileBytes = bytes - tile < GF256_DOT_TILE ? bytes - tile : GF256_DOT_TILE;
+
+        for (i = 0; i < count; i += GF256_DOT_SOURCES)
+        {
+            const int n = count - i < GF256_DOT_SOURCES ? count - i : GF256_DOT_SOURCES;
+
+            for (j = 0; j < n; ++j)
+                tileX[j] = (const uint8_t *)vx[i + j] + tile;
+            gf256_dot_mem_group(z + tile, y + i, tileX, n, tileBytes, add || i > 0);
+        }
+    }
+}
+
+extern void gf256_dot_mem(void * GF256_RESTRICT vz, const uint8_t * y,
+                          const void * const * vx, int count, int bytes)
+{
+    gf256_dot_mem_((uint8_t *)vz, y, vx, count, bytes, false);
+}
+
+extern void gf256_muladd_multi_mem(void * GF256_RESTRICT vz, const uint8_t * y,
+                                   const void * const * vx, int count, int bytes)
+{
+    gf256_dot_mem_((uint8_t *)vz, y, vx, count, bytes, true);
+}
+
+extern void gf256_muladd_multi_dest_mem(void * const * vz, const uint8_t * y, int count,
+                                        const void * GF256_RESTRICT vx, int bytes)
+{
+    const uint8_t * x = (const uint8_t *)vx;
+    int offset = 0, i;
+
+#if !defined(GF256_TARGET_MOBILE)
+# if defined(GF256_TRY_GFNI)
+    if (CpuHasGFNI)
+        offset = gf256_muladd_multi_dest_mem_gfni(vz, y, count, x, offset, bytes);
+# endif // GF256_TRY_GFNI
+# if defined(GF256_TRY_AVX2)
+    if (bytes - offset >= 32 && CpuHasAVX2)
+        offset = gf256_muladd_multi_dest_mem_avx2(vz, y, count, x, offset, bytes);
+# endif // GF256_TRY_AVX2
+    if (bytes - offset >= 16 && CpuHasSSSE3)
+        offset = gf256_muladd_multi_dest_mem_ssse3(vz, y, count, x, offset, bytes);
+#endif // GF256_TARGET_MOBILE
+
+    // Finish the tail (or everything, without x86 SIMD) one destination at a time
+    if (offset < bytes)
+        for (i = 0; i < count; ++i)
+            gf256_muladd_mem((uint8_t *)vz[i] + offset, y[i], x + offset, bytes - offset);
+}
+
 extern void gf256_memswap(void * GF256_RESTRICT vx, void * GF256_RESTRICT vy, int bytes)
 {
-    unsigned ii;
 #if defined(GF256_TARGET_MOBILE)
+    unsigned ii;
     uint64_t * GF256_RESTRICT x16 = (uint64_t *)(vx);
     uint64_t * GF256_RESTRICT y16 = (uint64_t *)(vy);
 
@@ -59,20 +59,23 @@
 #if defined(ANDROID) || defined(IOS) || defined(LINUX_ARM)
     #define GF256_TARGET_MOBILE
 #endif // ANDROID
- #define GF256_TARGET_MOBILE
-#if defined(__AVX2__) //|| (defined (_MSC_VER) && _MSC_VER >= 1900)
+
+// The SSSE3/AVX2 kernels are only built for x86-64, every other target
+// (including 32-bit x86) uses the portable code path.
+#if !defined(__x86_64__) && !defined(_M_X64) && !defined(GF256_TARGET_MOBILE)
+    #define GF256_TARGET_MOBILE
+#endif // !__x86_64__
+
+#if !defined(GF256_TARGET_MOBILE)
+    // AVX2 kernels are always compiled in and selected at runtime from CPUID,
+    // so the library does not need to be built with -mavx2
     #define GF256_TRY_AVX2 /* 256-bit */
-//    #include <immintrin.h>
+    #define GF256_TRY_GFNI /* 512-bit GF2P8AFFINEQB, needs AVX-512BW */
+    #include <immintrin.h> // SSE2, SSSE3: _mm_shuffle_epi8, AVX2
     #define GF256_ALIGN_BYTES 32
-#else // __AVX2__
+#else // GF256_TARGET_MOBILE
     #define GF256_ALIGN_BYTES 16
-#endif // __AVX2__
-
-#if !defined(GF256_TARGET_MOBILE)
-    // Note: MSVC currently only supports SSSE3 but not AVX2
-    //#include <tmmintrin.h> // SSSE3: _mm_shuffle_epi8
-    #include <emmintrin.h> // SSE2
-#endif // !GF256_TARGET_MOBILE
+#endif // GF256_TARGET_MOBILE
 
 #if defined(HAVE_ARM_NEON_H)
     #include <arm_neon.h>
@@ -112,6 +115,18 @@
     #define GF256_FORCE_INLINE inline __attribute__((always_inline))
 #endif
 
+// Compiler-specific keywords to build one function for a newer instruction set
+// than the rest of the file.  The caller must check the CPU supports it first.
+#if defined(_MSC_VER) || defined(GF256_TARGET_MOBILE)
+    #define GF256_TARGET_SSSE3
+    #define GF256_TARGET_AVX2
+    #define GF256_TARGET_GFNI
+#else
+    #define GF256_TARGET_SSSE3 __attribute__((target("ssse3")))
+    #define GF256_TARGET_AVX2 __attribute__((target("avx2")))
+    #define GF256_TARGET_GFNI __attribute__((target("gfni,avx512f,avx512bw")))
+#endif
+
 // Compiler-specific alignment keyword
 // Note: Alignment only matters for ARM NEON where it should be 16
 #ifdef _MSC_VER
@@ -161,6 +176,14 @@ typedef struct
         GF256_ALIGNED GF256_M256 TABLE_HI_Y[256];
     } MM256;
 #endif // GF256_TRY_AVX2
+#ifdef GF256_TRY_GFNI
+    /// 8x8 bit matrix for each y, such that GF2P8AFFINEQB(x, AFFINE_Y[y]) = x * y
+    /// in our field.  GF2P8MULB cannot be used since it is fixed to the AES polynomial.
+    struct
+    {
+        uint64_t AFFINE_Y[256];
+    } GFNI;
+#endif // GF256_TRY_GFNI
 
     /// Mul/Div/Inv/Sqr tables
     uint8_t GF256_MUL_TABLE[256 * 256];
@@ -208,6 +231,24 @@ extern gf256_ctx GF256Ctx;
 int gf256_init_(int version);
 #define gf256_init() gf256_init_(GF256_VERSION)
 
+/// Instruction set extensions used by the bulk memory operations
+#define GF256_ISA_SSSE3 0x01
+#define GF256_ISA_AVX2  0x02
+#define GF256_ISA_GFNI  0x04 /* GFNI with AVX-512BW */
+
+/// Returns the GF256_ISA_* flags selected by gf256_init()
+unsigned gf256_get_isa();
+
+/**
+    Restrict the bulk memory operations to the GF256_ISA_* flags in mask,
+    e.g. to benchmark one kernel against another.  Flags the CPU does not
+    support are ignored.  Not thread-safe: call it before any other thread
+    uses the library.
+
+    Returns the flags now in use.
+*/
+unsigned gf256_set_isa(unsigned mask);
+
 
 //------------------------------------------------------------------------------
 // Math Operations
@@ -268,6 +309,21 @@ void gf256_mul_mem(void * GF256_RESTRICT vz,
 void gf256_muladd_mem(void * GF256_RESTRICT vz, uint8_t y,
                              const void * GF256_RESTRICT vx, int bytes);
 
+/// Performs "z[] = x_0[] * y[0] + ... + x_{count-1}[] * y[count-1]" bulk memory operation.
+/// Each chunk of z is held in registers while all the sources are folded in,
+/// so z is written once instead of once per source.  z must not overlap any x_i.
+void gf256_dot_mem(void * GF256_RESTRICT vz, const uint8_t * y,
+                   const void * const * vx, int count, int bytes);
+
+/// Performs "z[] += x_0[] * y[0] + ... + x_{count-1}[] * y[count-1]" bulk memory operation
+void gf256_muladd_multi_mem(void * GF256_RESTRICT vz, const uint8_t * y,
+                            const void * const * vx, int count, int bytes);
+
+/// Performs "z_i[] += x[] * y[i]" for i = 0 ... count-1 bulk memory operation.
+/// Each chunk of x is loaded once and applied to every z_i.  No z_i may overlap x.
+void gf256_muladd_multi_dest_mem(void * const * vz, const uint8_t * y, int count,
+                                 const void * GF256_RESTRICT vx, int bytes);
+
 /// Performs "x[] /= y" bulk memory operation
 static GF256_FORCE_INLINE void gf256_div_mem(void * GF256_RESTRICT vz,
                                              const void * GF256_RESTRICT vx, uint8_t y, int bytes)
@@ -9,6 +9,7 @@ package lrcpkg
  #cgo amd64 CFLAGS: -mssse3
  #cgo arm arm64 CFLAGS: -DLINUX_ARM=1 -DGF256_TARGET_MOBILE
  #cgo LDFLAGS: -lm
+ #cgo linux LDFLAGS: -lpthread
  #include <stdlib.h>
  #include "./YTLRC.h"
  #include "./cm256.h"
@@ -19,7 +20,14 @@ import "unsafe"
 import (
 //     "fmt"
      "container/list"
+     "sync"
 )
+
+// LRC_OneShardForRebuild reads the shards of the global decode in place until
+// the rebuild is done, so the copy of each one is kept with its handle and freed once
+// AddShardData returns the rebuilt data or by FreeHandle
+var shardBufsLock sync.Mutex
+var shardBufs = make(map[unsafe.Pointer][]unsafe.Pointer)
 //var datalist[] C.char *
 func (s Shardsinfo)LRCinit(n int16) (int16){
      stat := C.LRC_Initial(C.short(13))
@@ -70,20 +78,23 @@ func (s Shardsinfo)GetNeededShardList(handle unsafe.Pointer)(*list.List,int16){
 
 func (s Shardsinfo)AddShardData(handle unsafe.Pointer,sdata []byte)(int16){
      var stat C.short
-     var j uint32
-     j=0
-     temp := (*C.char)(C.malloc(C.size_t(16384)))
-  //   fmt.Println("len=%d",len(sdata))
-     for i:=C.uint(0);i < C.uint(len(sdata));i++{
-        *(*C.char)(unsafe.Pointer(uintptr(unsafe.Pointer(temp)) + uintptr(i)))=C.char(sdata[j])
-        j++
+     if (len(sdata) == 0){
+        return -1
      }
-   
+     temp := C.CBytes(sdata)
+  //   fmt.Println("len=%d",len(sdata))
+     shardBufsLock.Lock()
+     shardBufs[handle] = append(shardBufs[handle], temp)
+     shardBufsLock.Unlock()
+
      //fmt.Println(*(*C.char)(unsafe.Pointer(temp)))
     // fmt.Println("ahahahahahah")
-     stat = C.LRC_OneShardForRebuild(handle,unsafe.Pointer(temp))
+     stat = C.LRC_OneShardForRebuild(handle,temp)
     // stat = C.LRC_OneShard(C.short(handle),unsafe.Pointer(&sdata[0]))
-     C.free(unsafe.Pointer(temp))
+     if (stat > 0){
+        // Rebuilt, the shards are not read any more
+        freeShardBufs(handle)
+     }
      return int16(stat)
 }
 
@@ -110,4 +121,14 @@ func (s Shardsinfo)FreeHandle(sdinf *Shardsinfo){
      }
     */
      C.LRC_FreeHandle(sdinf.Handle)
+     freeShardBufs(sdinf.Handle)
+}
+
+func freeShardBufs(handle unsafe.Pointer){
+     shardBufsLock.Lock()
+     for _, temp := range shardBufs[handle] {
+         C.free(temp)
+     }
+     delete(shardBufs, handle)
+     shardBufsLock.Unlock()
 }
@@ -43,6 +43,8 @@
 #include "../cm256.h"
 #include "../YTLRC.h"
 
+short GetHorLocalCount(short originalCount); // Internal to YTLRC.c
+
 #include <Windows.h>
 
 static double GetPerfFrequencyInverse()
@@ -336,6 +338,240 @@ bool FinerPerfTimingTest()
     return true;
 }
 
+/* Every kernel of every ISA against gf256_mul() byte by byte, for odd lengths, unaligned buffers and all coefficients */
+bool KernelMatchTest()
+{
+    static const unsigned isaList[4] = {
+        0, GF256_ISA_SSSE3, GF256_ISA_SSSE3 | GF256_ISA_AVX2, GF256_ISA_SSSE3 | GF256_ISA_AVX2 | GF256_ISA_GFNI
+    };
+    static const char *isaName[4] = { "scalar", "SSSE3", "AVX2", "GFNI" };
+    static const int lengths[] = { 1, 15, 17, 31, 33, 63, 65, 127, 129, 255, 257, 1023 };
+    static const int counts[] = { 1, 2, 3, 5, 8, 9 };
+    enum { MAX_BYTES = 1024, MAX_COUNT = 9 };
+    int i, k, l, n, c, b;
+
+    if (gf256_init())
+        return false;
+    printf("----- Start test GF(256) kernels against gf256_mul() -------------\n");
+
+    const unsigned detected = gf256_get_isa();
+    uint8_t *buf = (uint8_t *)malloc(3 * MAX_COUNT * (MAX_BYTES + 1));
+    if (NULL == buf)
+        return false;
+    /* Sources at odd addresses, then destinations, then the expected results */
+    uint8_t *x[MAX_COUNT], *z[MAX_COUNT], *e[MAX_COUNT];
+    for (i = 0; i < MAX_COUNT; i++) {
+        x[i] = buf + i * (MAX_BYTES + 1) + 1;
+        z[i] = buf + (MAX_COUNT + i) * (MAX_BYTES + 1) + 1;
+        e[i] = buf + (2 * MAX_COUNT + i) * (MAX_BYTES + 1) + 1;
+    }
+    uint8_t *expected = e[0];
+    for (i = 0; i < MAX_COUNT * (MAX_BYTES + 1); i++)
+        buf[i] = (uint8_t)rand();
+
+    for (k = 0; k < 4; k++) {
+        if (gf256_set_isa(isaList[k]) != isaList[k])
+            continue;   // Not supported by this CPU
+        for (l = 0; l < (int)(sizeof(lengths) / sizeof(lengths[0])); l++) {
+            const int bytes = lengths[l];
+            for (c = 0; c < 256; c++) {
+                const uint8_t y = (uint8_t)c;
+
+                gf256_mul_mem(z[0], x[0], y, bytes);
+                for (b = 0; b < bytes && z[0][b] == gf256_mul(x[0][b], y); b++);
+                if (b < bytes) {
+                    printf("%s gf256_mul_mem of %d bytes by %d differs at byte %d\n", isaName[k], bytes, c, b);
+                    return false;
+                }
+
+                for (b = 0; b < bytes; b++)
+                    expected[b] = z[1][b] ^ gf256_mul(x[0][b], y);
+                gf256_muladd_mem(z[1], y, x[0], bytes);
+                if (memcmp(z[1], expected, bytes) != 0) {
+                    printf("%s gf256_muladd_mem of %d bytes by %d error\n", isaName[k], bytes, c);
+                    return false;
+                }
+
+                /* Each source or destination takes every coefficient over the loop of c */
+                for (n = 0; n < (int)(sizeof(counts) / sizeof(counts[0])); n++) {
+                    const int count = counts[n];
+                    uint8_t ys[MAX_COUNT];
+                    for (i = 0; i < count; i++)
+                        ys[i] = (uint8_t)(c + 37 * i);
+
+                    memset(expected, 0, bytes);
+                    for (i = 0; i < count; i++)
+                        for (b = 0; b < bytes; b++)
+                            expected[b] ^= gf256_mul(x[i][b], ys[i]);
+                    gf256_dot_mem(z[0], ys, (const void * const *)x, count, bytes);
+                    if (memcmp(z[0], expected, bytes) != 0) {
+                        printf("%s gf256_dot_mem of %d sources of %d bytes, first coefficient %d error\n", isaName[k], count, bytes, c);
+                        return false;
+                    }
+                    for (b = 0; b < bytes; b++)
+                        expected[b] ^= z[1][b];
+                    gf256_muladd_multi_mem(z[1], ys, (const void * const *)x, count, bytes);
+                    if (memcmp(z[1], expected, bytes) != 0) {
+                        printf("%s gf256_muladd_multi_mem of %d sources of %d bytes, first coefficient %d error\n", isaName[k], count, bytes, c);
+                        return false;
+                    }
+
+                    for (i = 0; i < count; i++)
+                        for (b = 0; b < bytes; b++)
+                            e[i][b] = z[i][b] ^ gf256_mul(x[0][b], ys[i]);
+                    gf256_muladd_multi_dest_mem((void * const *)z, ys, count, x[0], bytes);
+                    for (i = 0; i < count && memcmp(z[i], e[i], bytes) == 0; i++);
+                    if (i < count) {
+                        printf("%s gf256_muladd_multi_dest_mem of %d destinations of %d bytes, first coefficient %d error at %d\n", isaName[k], count, bytes, c, i);
+                        return false;
+                    }
+                }
+            }
+        }
+        printf("%s kernels OK\n", isaName[k]);
+    }
+
+    gf256_set_isa(detected);
+    free(buf);
+    return true;
+}
+
+bool KernelPerfTesting(int numLoops, int shardSize)
+{
+    static const unsigned isaList[4] = {
+        0, GF256_ISA_SSSE3, GF256_ISA_SSSE3 | GF256_ISA_AVX2, GF256_ISA_SSSE3 | GF256_ISA_AVX2 | GF256_ISA_GFNI
+    };
+    static const char *isaName[4] = { "scalar", "SSSE3", "AVX2", "GFNI" };
+    int i, j, k;
+
+    if (gf256_init())
+        return false;
+
+    const unsigned detected = gf256_get_isa();
+    uint8_t *x = (uint8_t *)malloc(shardSize);
+    uint8_t *z = (uint8_t *)malloc(shardSize);
+    uint8_t *expected = (uint8_t *)malloc(shardSize);
+    for (i = 0; i < shardSize; i++)
+        x[i] = (uint8_t)rand();
+
+    for (k = 0; k < 4; k++) {
+        if (gf256_set_isa(isaList[k]) != isaList[k])
+            continue;   // Not supported by this CPU
+
+        LARGE_INTEGER t0, t1, t2;
+        memset(z, 0, shardSize);
+        QueryPerformanceCounter(&t0);
+        for (j = 0; j < numLoops; j++)
+            gf256_muladd_mem(z, (uint8_t)(j | 2), x, shardSize);
+        QueryPerformanceCounter(&t1);
+        for (j = 0; j < numLoops; j++)
+            gf256_mul_mem(z, x, (uint8_t)(j | 2), shardSize);
+        QueryPerformanceCounter(&t2);
+
+        double muladdUsec = (t1.QuadPart - t0.QuadPart) * GetPerfFrequencyInverse() * 1000000.;
+        double mulUsec = (t2.QuadPart - t1.QuadPart) * GetPerfFrequencyInverse() * 1000000.;
+        printf("%s: %d bytes, muladd %lf MBps, mul %lf MBps\n", isaName[k], shardSize,
+               (double)shardSize * numLoops / muladdUsec, (double)shardSize * numLoops / mulUsec);
+
+        // Every kernel must produce the scalar result
+        if (k == 0)
+            memcpy(expected, z, shardSize);
+        else if (memcmp(expected, z, shardSize) != 0) {
+            printf("%s kernel mismatch\n", isaName[k]);
+            return false;
+        }
+    }
+
+    gf256_set_isa(detected);
+    free(x);
+    free(z);
+    free(expected);
+    return true;
+}
+
+/* Cost of LRC_Decode for each shard of small size, the decode process is bookkeeping rather than GF(256) math */
+bool IngestPerfTesting(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops)
+{
+    static const int shardSizes[3] = { 17, 65, 257 };
+    int i, j, k, lost, originalCount;
+
+    if ( minOriginalCount <= 1 || maxOriginalCount >= MAXSHARDS - recoveryCount - 40 )
+        return false;
+    if ( !LRC_Initial(recoveryCount) )
+        return false;
+
+    uint8_t *orig_data = (uint8_t *)malloc(MAXSHARDS * 257);
+    uint8_t *recoveryData = (uint8_t *)malloc(MAXSHARDS * 257);
+    uint8_t *decodedData = (uint8_t *)malloc(MAXSHARDS * 256);
+    const uint8_t *order[MAXSHARDS];
+    CM256Block orgBlocks[MAXSHARDS], decodedBlocks[MAXSHARDS];
+
+    for (k = 0; k < 3; k++) {
+        int shardSize = shardSizes[k];
+        for (originalCount = minOriginalCount; originalCount <= maxOriginalCount; originalCount++) {
+            for (i = 0; i < originalCount; i++) {
+                orig_data[i * shardSize] = i;   // Index byte
+                orgBlocks[i].pData = orig_data + i * shardSize + 1;
+                decodedBlocks[i].pData = decodedData + i * (shardSize - 1);
+                decodedBlocks[i].lrcIndex = i;
+            }
+            InitializeData(orgBlocks, originalCount, originalCount, shardSize - 1);
+            const void *shards[MAXSHARDS];
+            for (i = 0; i < originalCount; i++)
+                shards[i] = orig_data + i * shardSize;
+            short n = LRC_Encode(shards, originalCount, shardSize, recoveryData);
+            if ( n <= 0 ) {
+                printf("Encoder error\n");
+                return false;
+            }
+
+            /* All originals but one of every 13 are collected first, they are recovered by local groups */
+            for (lost = 0; lost <= 1; lost++) {
+                int count = 0;
+                for (i = 0; i < originalCount; i++) {
+                    if ( !lost || i % 13 != 3 )
+                        order[count++] = orig_data + i * shardSize;
+                }
+                for (i = 0; i < n; i++)
+                    order[count++] = recoveryData + i * shardSize;
+
+                long numShards = 0;
+                LARGE_INTEGER t0, t1;
+                QueryPerformanceCounter(&t0);
+                for (j = 0; j < numLoops * 100; j++) {
+                    void *hDecode = LRC_BeginDecode(originalCount, shardSize, decodedData);
+                    if ( NULL == hDecode ) {
+                        printf("Begin decode error\n");
+                        return false;
+                    }
+                    short ret = 0;
+                    for (i = 0; i < count && 0 == ret; i++, numShards++)
+                        ret = LRC_Decode(hDecode, order[i]);
+                    LRC_FreeHandle(hDecode);
+                    if ( ret <= 0 ) {
+                        printf("Decoder error\n");
+                        return false;
+                    }
+                }
+                QueryPerformanceCounter(&t1);
+
+                double nsec = (t1.QuadPart - t0.QuadPart) * GetPerfFrequencyInverse() * 1000000000.;
+                printf("Ingest: %d bytes per block, k = %d, lost = %d : %lf nsec per shard\n", shardSize - 1, originalCount,
+                       lost ? (originalCount + 9) / 13 : 0, nsec / numShards);
+                if ( !ValidateSolution(decodedBlocks, originalCount, shardSize - 1) ) {
+                    printf("Solution invalid");
+                    return false;
+                }
+            }
+        }
+    }
+
+    free(orig_data);
+    free(recoveryData);
+    free(decodedData);
+    return true;
+}
+
 bool BulkPerfTesting(int minOriginalCount, int maxOriginalCount, int minRecoveryCount, int maxRecoveryCount)
 {
     int i, ii, j;
@@ -666,6 +902,13 @@ bool RebuildTest(int minOriginalCount, int maxOriginalCount, int probability, in
         free (rebuilddata);
         return false;
     }
+    /* Each shard is given in a copy, kept until the rebuild is done and scrambled then */
+    uint8_t * copybuf = malloc(MAXSHARDS * shardSize);
+    if (NULL == copybuf) {
+        free (shardbuf);
+        free (rebuilddata);
+        return false;
+    }
     uint8_t *shards[MAXSHARDS];
     for (i = 0; i < MAXSHARDS; i++)
         shards[i] = shardbuf + i * shardSize;
@@ -706,7 +949,9 @@ bool RebuildTest(int minOriginalCount, int maxOriginalCount, int probability, in
                         continue;
                     }
 
-                    ret = LRC_OneShardForRebuild(handle, shards[index]);
+                    uint8_t *copy = copybuf + index * shardSize;
+                    memcpy(copy, shards[index], shardSize);
+                    ret = LRC_OneShardForRebuild(handle, copy);
                     if (ret > 0) {
                         printf("Rebuild Completed ...... ");
                         bRebuildOK = true;
@@ -719,6 +964,7 @@ bool RebuildTest(int minOriginalCount, int maxOriginalCount, int probability, in
                 }
             }
             LRC_FreeHandle(handle);
+            memset(copybuf, 0xA5, MAXSHARDS * shardSize);
             if (bRebuildOK) {
                 if (memcmp(shards[iLost], rebuilddata, shardSize) == 0)
                     printf("Verify data OK\n");
@@ -732,56 +978,1286 @@ bool RebuildTest(int minOriginalCount, int maxOriginalCount, int probability, in
             }
         }
    }
+   free(copybuf);
+   free(shardbuf);
+   free(rebuilddata);
    return true;
 }
 
-int main(int argc, const char *argv[])
+bool MultiRebuildTest(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops, int shardSize)
 {
-    bool bTest[10] = {false, false, false, false};
-    int minOriginalCount = 128;
-    int maxOriginalCount = 128;
-    int recoveryCount = 12;
-    int numLoops = 20;
-    int shardSize = 16 * 1024;
-    argc -= 3;
-    if (argc > 1) {
-        int argv1;
-        sscanf(argv[1], "%d", &argv1);
-        while (argv1 > 0) {
-            bTest[argv1 % 10] = true;
-            argv1 /= 10;
+    int i, j, k, iLoop, originalCount;
+    if ( !LRC_Initial(recoveryCount) ) {
+        printf("   LRC_Initial failed\n");
+        return false;
+    }
+    printf("----- Start test LRC_BeginRebuildMulti with shardSize=%d -------------\n", shardSize);
+    uint8_t * rebuilddata = malloc(8 * shardSize);
+    if (NULL == rebuilddata)
+        return false;
+    uint8_t * shardbuf = malloc(MAXSHARDS * shardSize);
+    if (NULL == shardbuf) {
+        free (rebuilddata);
+        return false;
+    }
+    uint8_t *shards[MAXSHARDS];
+    void *rebuilt[8];
+    for (i = 0; i < MAXSHARDS; i++)
+        shards[i] = shardbuf + i * shardSize;
+    for (i = 0; i < 8; i++)
+        rebuilt[i] = rebuilddata + i * shardSize;
+    for (originalCount = minOriginalCount; originalCount <= maxOriginalCount; originalCount++) {
+        for (iLoop = 0; iLoop < numLoops; iLoop++) {
+            /* Prepare test data */
+            for (i = 0; i < originalCount; i++) {
+                shards[i][0] = i;
+                for (j = 1; j < shardSize; j++)
+                    shards[i][j] = rand();
+            }
+            short numRecovery = LRC_Encode((const void **)shards, originalCount, shardSize, shardbuf + originalCount * shardSize);
+
+            /* Lost shards cluster in one horizonal and one vertical group now and then, to chain local repairs */
+            uint8_t lost[8];
+            bool bLost[MAXSHARDS] = {false};
+            short numLost = 2 + rand() % 6;
+            for (k = 0; k < numLost; ) {
+                int iLost = rand() % 2 ? rand() % (originalCount + numRecovery) : (rand() % 8) * 8 + rand() % 8;
+                if (iLost >= originalCount + numRecovery || bLost[iLost])
+                    continue;
+                bLost[iLost] = true;
+                lost[k++] = iLost;
+            }
+            void *handle = LRC_BeginRebuildMulti(originalCount, lost, numLost, shardSize, rebuilt);
+            if (NULL == handle) {
+                printf("LRC_BeginRebuildMulti failed\n");
+                return false;
+            }
+            printf("%d data shards test %d: Lost %d shards:", originalCount, iLoop, numLost);
+            for (k = 0; k < numLost; k++)
+                printf(" %d", lost[k]);
+
+            uint8_t needlist[256];
+            short n, ret = 0;
+            int numFetched = 0;
+            while ( ret <= 0 && (n = LRC_NextRequestList(handle, needlist)) > 0 ) {
+                for (i = 0; i < n && ret <= 0; i++) {
+                    ret = LRC_OneShardForRebuild(handle, shards[needlist[i]]);
+                    numFetched++;
+                    if (ret < 0) {
+                        printf("\nadd shard %d to rebuilder error %d\n", needlist[i], ret);
+                        return false;
+                    }
+                }
+            }
+            LRC_FreeHandle(handle);
+            if (ret <= 0) {
+                printf("\nRebuild failed(not enough shards to rebuild)\n");
+                return false;
+            }
+            for (k = 0; k < numLost; k++) {
+                if (memcmp(shards[lost[k]], rebuilt[k], shardSize) != 0) {
+                    printf("\nRebuild data error of shard %d\n", lost[k]);
+                    return false;
+                }
+            }
+            printf(", %d shards fetched, verify data OK\n", numFetched);
         }
     }
-    if (argc > 2)
-        sscanf(argv[2], "%d", &minOriginalCount);
-    if (argc > 3)
-        sscanf(argv[3], "%d", &maxOriginalCount);
-    if (argc > 4)
-        sscanf(argv[4], "%d", &recoveryCount);
-    if (argc > 5)
-        sscanf(argv[5], "%d", &numLoops);
-    if (argc > 6)
-        sscanf(argv[6], "%d", &shardSize);
+    free(shardbuf);
+    free(rebuilddata);
+    return true;
+}
 
-    if ( bTest[0] ) {
-       if (!ExampleFileUsage())
-            return(1);
-        if (!CheckMemSwap())
-           return(4);
-        if (!FinerPerfTimingTest())
-            return(2);
+bool CostRebuildTest(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops, int shardSize)
+{
+    int i, j, iLoop, originalCount;
+    if ( !LRC_Initial(recoveryCount) ) {
+        printf("   LRC_Initial failed\n");
+        return false;
     }
-    if ( bTest[1] ) {
-        if ( !BulkPerfTesting(minOriginalCount, maxOriginalCount, recoveryCount, recoveryCount+2) )
-            return 3;
+    printf("----- Start test LRC_SetRebuildCosts with shardSize=%d -------------\n", shardSize);
+    uint8_t * rebuilddata = malloc(shardSize);
+    if (NULL == rebuilddata)
+        return false;
+    uint8_t * shardbuf = malloc(MAXSHARDS * shardSize);
+    if (NULL == shardbuf) {
+        free (rebuilddata);
+        return false;
     }
-    if ( bTest[2] ) {
-        if (!LRCTesting(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
-            return(4);
+    uint8_t *shards[MAXSHARDS];
+    unsigned short costs[MAXSHARDS];
+    for (i = 0; i < MAXSHARDS; i++)
+        shards[i] = shardbuf + i * shardSize;
+    for (originalCount = minOriginalCount; originalCount <= maxOriginalCount; originalCount++) {
+        for (iLoop = 0; iLoop < numLoops; iLoop++) {
+            /* Prepare test data */
+            for (i = 0; i < originalCount; i++) {
+                shards[i][0] = i;
+                for (j = 1; j < shardSize; j++)
+                    shards[i][j] = rand();
+            }
+            short numRecovery = LRC_Encode((const void **)shards, originalCount, shardSize, shardbuf + originalCount * shardSize);
+
+            /* A third of the shards are in the other site, a few can not be fetched */
+            for (i = 0; i < originalCount + numRecovery; i++)
+                costs[i] = rand() % 20 == 0 ? LRC_COST_UNAVAILABLE : rand() % 3 == 0 ? 10 : 1;
+            short iLost = rand() % (originalCount + numRecovery);
+            void *handle = LRC_BeginRebuild(originalCount, iLost, shardSize, rebuilddata);
+            if (NULL == handle || LRC_SetRebuildCosts(handle, costs) != 0) {
+                printf("LRC_SetRebuildCosts failed\n");
+                return false;
+            }
+
+            uint8_t needlist[256];
+            short n, ret = 0;
+            int cost = 0;
+            while ( ret <= 0 && (n = LRC_NextRequestList(handle, needlist)) > 0 ) {
+                for (i = 0; i < n && ret <= 0; i++) {
+                    if (LRC_COST_UNAVAILABLE == costs[needlist[i]]) {
+                        printf("LRC_NextRequestList requests unavailable shard %d\n", needlist[i]);
+                        return false;
+                    }
+                    cost += costs[needlist[i]];
+                    ret = LRC_OneShardForRebuild(handle, shards[needlist[i]]);
+                    if (ret < 0) {
+                        printf("add shard %d to rebuilder error %d\n", needlist[i], ret);
+                        return false;
+                    }
+                }
+            }
+            LRC_FreeHandle(handle);
+            if (ret <= 0) {
+                /* Lost shards of a local group may be unavailable at the same time */
+                printf("%d data shards test %d: Lost shard %d, not enough shards to rebuild\n", originalCount, iLoop, iLost);
+                continue;
+            }
+            if (memcmp(shards[iLost], rebuilddata, shardSize) != 0) {
+                printf("Rebuild data error of shard %d\n", iLost);
+                return false;
+            }
+            printf("%d data shards test %d: Lost shard %d, cost %d, verify data OK\n", originalCount, iLoop, iLost, cost);
+        }
     }
-    if ( bTest[3] ) {
-        if (!RebuildTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
-            return(4);
+    free(shardbuf);
+    free(rebuilddata);
+    return true;
+}
+
+bool HedgedRebuildTest(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops, int shardSize)
+{
+    int i, j, iLoop, originalCount;
+    if ( !LRC_Initial(recoveryCount) ) {
+        printf("   LRC_Initial failed\n");
+        return false;
+    }
+    printf("----- Start test LRC_SetRebuildHedge with shardSize=%d -------------\n", shardSize);
+    uint8_t * rebuilddata = malloc(shardSize);
+    if (NULL == rebuilddata)
+        return false;
+    uint8_t * shardbuf = malloc(MAXSHARDS * shardSize);
+    if (NULL == shardbuf) {
+        free (rebuilddata);
+        return false;
+    }
+    uint8_t *shards[MAXSHARDS];
+    unsigned short costs[MAXSHARDS];
+    for (i = 0; i < MAXSHARDS; i++)
+        shards[i] = shardbuf + i * shardSize;
+    for (originalCount = minOriginalCount; originalCount <= maxOriginalCount; originalCount++) {
+        for (iLoop = 0; iLoop < numLoops; iLoop++) {
+            /* Prepare test data */
+            for (i = 0; i < originalCount; i++) {
+                shards[i][0] = i;
+                for (j = 1; j < shardSize; j++)
+                    shards[i][j] = rand();
+            }
+            short numRecovery = LRC_Encode((const void **)shards, originalCount, shardSize, shardbuf + originalCount * shardSize);
+
+            short iLost = rand() % (originalCount + numRecovery);
+            void *handle = LRC_BeginRebuild(originalCount, iLost, shardSize, rebuilddata);
+            if (NULL == handle || LRC_SetRebuildHedge(handle, 2) != 0) {
+                printf("LRC_SetRebuildHedge failed\n");
+                return false;
+            }
+            /* Every other test hedges the cheapest requests */
+            for (i = 0; i < originalCount + numRecovery; i++)
+                costs[i] = rand() % 3 == 0 ? 10 : 1;
+            if (iLoop % 2 != 0 && LRC_SetRebuildCosts(handle, costs) != 0) {
+                printf("LRC_SetRebuildCosts failed\n");
+                return false;
+            }
+
+            /* Shards arrive in random order, a few slow ones of the first list never arrive */
+            uint8_t needlist[256];
+            short n, ret = 0;
+            int arrived = 0, round = 0;
+            while ( ret <= 0 && (n = LRC_NextRequestList(handle, needlist)) > 0 ) {
+                for (i = n - 1; i > 0; i--) {
+                    j = rand() % (i + 1);
+                    uint8_t t = needlist[i];
+                    needlist[i] = needlist[j];
+                    needlist[j] = t;
+                }
+                for (i = 0; i < n && ret <= 0; i++) {
+                    if (0 == round && rand() % 8 == 0)
+                        continue;
+                    arrived++;
+                    ret = LRC_OneShardForRebuild(handle, shards[needlist[i]]);
+                    if (ret < 0) {
+                        printf("add shard %d to rebuilder error %d\n", needlist[i], ret);
+                        return false;
+                    }
+                }
+                round++;
+            }
+            LRC_FreeHandle(handle);
+            if (ret <= 0) {
+                printf("%d data shards test %d: Lost shard %d, not enough shards to rebuild\n", originalCount, iLoop, iLost);
+                continue;
+            }
+            if (memcmp(shards[iLost], rebuilddata, shardSize) != 0) {
+                printf("Rebuild data error of shard %d\n", iLost);
+                return false;
+            }
+            printf("%d data shards test %d: Lost shard %d, %d shards arrived, verify data OK\n", originalCount, iLoop, iLost, arrived);
+        }
+    }
+    free(shardbuf);
+    free(rebuilddata);
+    return true;
+}
+
+/* Geometry of an LRC stripe as LRC_Encode sets it up, without index bytes */
+static void StripeParam(CM256LRC *pParam, int originalCount, int globalRecoveryCount, int blockBytes)
+{
+    pParam->BlockBytes = blockBytes;
+    pParam->bIndexByte = false;
+    pParam->OriginalCount = originalCount;
+    pParam->GlobalRecoveryCount = globalRecoveryCount;
+    pParam->HorLocalCount = GetHorLocalCount(originalCount);
+    pParam->VerLocalCount = (originalCount + pParam->HorLocalCount - 1) / pParam->HorLocalCount;
+    pParam->TotalOriginalCount = pParam->HorLocalCount * pParam->VerLocalCount;
+    pParam->FirstHorRecoveryIndex = 0;
+    pParam->FirstVerRecoveryIndex = pParam->VerLocalCount;
+    pParam->FirstGlobalRecoveryIndex = pParam->VerLocalCount + pParam->HorLocalCount;
+    pParam->LocalRecoveryOfGlobalRecoveryIndex = pParam->FirstGlobalRecoveryIndex + pParam->GlobalRecoveryCount;
+    pParam->TotalRecoveryCount = pParam->LocalRecoveryOfGlobalRecoveryIndex + 1;
+}
+
+/*
+ * Recovery blocks of a stripe computed one whole block at a time by CM256EncodeBlock, as cm256_encode did
+ * before it went by byte ranges. The padding originals are read from pZero
+ */
+static void EncodeByBlocks(const CM256LRC *pParam, const CM256Block *originals, uint8_t *pZero, uint8_t *recoveryData)
+{
+    CM256Block blocks[MAXSHARDS];
+    cm256_encoder_params params;
+    int i;
+    for (i = 0; i < pParam->TotalOriginalCount; i++)
+        blocks[i].pData = i < pParam->OriginalCount ? originals[i].pData : pZero;
+    params.TotalOriginalCount = pParam->TotalOriginalCount;
+    params.BlockBytes = pParam->BlockBytes;
+    params.RecoveryCount = 1;
+    uint8_t *pLocalOfGlobal = recoveryData + pParam->LocalRecoveryOfGlobalRecoveryIndex * pParam->BlockBytes;
+    memset(pLocalOfGlobal, 0, pParam->BlockBytes);
+    for (i = 0; i < pParam->LocalRecoveryOfGlobalRecoveryIndex; i++) {
+        uint8_t *pRecovery = recoveryData + i * pParam->BlockBytes;
+        if (i < pParam->FirstVerRecoveryIndex) {
+            params.OriginalCount = pParam->HorLocalCount;
+            params.FirstElement = (i - pParam->FirstHorRecoveryIndex) * pParam->HorLocalCount;
+            params.Step = 1;
+            CM256EncodeBlock(params, blocks, params.TotalOriginalCount, pRecovery);
+        } else if (i < pParam->FirstGlobalRecoveryIndex) {
+            params.OriginalCount = pParam->VerLocalCount;
+            params.FirstElement = i - pParam->FirstVerRecoveryIndex;
+            params.Step = pParam->HorLocalCount;
+            CM256EncodeBlock(params, blocks, params.TotalOriginalCount + 1, pRecovery);
+        } else {
+            params.OriginalCount = pParam->OriginalCount;
+            params.FirstElement = 0;
+            params.Step = 1;
+            CM256EncodeBlock(params, blocks, params.TotalOriginalCount + i - pParam->FirstGlobalRecoveryIndex + 2, pRecovery);
+            gf256_add_mem(pLocalOfGlobal, pRecovery, pParam->BlockBytes);
+        }
+    }
+}
+
+bool EncodeRangeTest(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops)
+{
+    /* The byte ranges of cm256_encode are multiples of 1 KB, these cross them with a short last one */
+    static const int sizes[] = { 1, 1025, 4097, 65539 };
+    const int maxBytes = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+    int i, j, s, iLoop, originalCount;
+
+    if (cm256_init() || minOriginalCount < 1 || maxOriginalCount > 230)
+        return false;
+    printf("----- Start test cm256_encode by byte ranges against one block at a time -------------\n");
+    uint8_t *databuf = malloc((2 * MAXSHARDS + 1) * maxBytes);
+    if (NULL == databuf)
+        return false;
+    uint8_t *pZero = databuf + 2 * MAXSHARDS * maxBytes;
+    memset(pZero, 0, maxBytes);
+    CM256Block blocks[MAXSHARDS];
+    for (originalCount = minOriginalCount; originalCount <= maxOriginalCount; originalCount++) {
+        for (s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+            CM256LRC paramLRC;
+            StripeParam(&paramLRC, originalCount, recoveryCount, sizes[s]);
+            if (paramLRC.TotalOriginalCount + paramLRC.TotalRecoveryCount > MAXSHARDS)
+                break; // Too many blocks for cm256_encode
+            uint8_t *recoveryData = databuf + paramLRC.TotalOriginalCount * sizes[s];
+            uint8_t *expected = recoveryData + paramLRC.TotalRecoveryCount * sizes[s];
+            for (iLoop = 0; iLoop < numLoops; iLoop++) {
+                for (i = 0; i < paramLRC.TotalOriginalCount; i++) {
+                    blocks[i].pData = i < originalCount ? databuf + i * sizes[s] : pZero;
+                    for (j = 0; j < sizes[s] && i < originalCount; j++)
+                        blocks[i].pData[j] = rand();
+                }
+                EncodeByBlocks(&paramLRC, blocks, pZero, expected);
+                if (cm256_encode(paramLRC, blocks, recoveryData) != 0 ||
+                    memcmp(recoveryData, expected, paramLRC.TotalRecoveryCount * sizes[s]) != 0) {
+                    printf("%d data shards test %d: cm256_encode of %d bytes differs from one block at a time\n", originalCount, iLoop, sizes[s]);
+                    return false;
+                }
+            }
+            printf("%d data shards: %d bytes, verify data OK\n", originalCount, sizes[s]);
+        }
+    }
+    free(databuf);
+    return true;
+}
+
+/*
+ * Scaffolding of the LRC tests: LRC_Initial, then one buffer of numShards shards of shardSize bytes,
+ * shards[] points at the first MAXSHARDS of them for the originals and recovery shards of a stripe
+ * return: the buffer to free at the end, NULL if something wrong
+ */
+static uint8_t *BeginStripeTest(const char *name, int recoveryCount, int shardSize, int numShards, uint8_t **shards)
+{
+    int i;
+    if ( !LRC_Initial(recoveryCount) ) {
+        printf("   LRC_Initial failed\n");
+        return NULL;
+    }
+    printf("----- Start test %s with shardSize=%d -------------\n", name, shardSize);
+    uint8_t *buf = malloc(numShards * shardSize);
+    if (NULL == buf)
+        return NULL;
+    for (i = 0; i < MAXSHARDS; i++)
+        shards[i] = buf + i * shardSize;
+    return buf;
+}
+
+/* Random originals with their index bytes, encoded by LRC_Encode, return the number of recovery shards */
+static short EncodeStripe(uint8_t **shards, int originalCount, int shardSize, void *pRecoveryData)
+{
+    int i, j;
+    for (i = 0; i < originalCount; i++) {
+        shards[i][0] = i;
+        for (j = 1; j < shardSize; j++)
+            shards[i][j] = rand();
+    }
+    return LRC_Encode((const void **)shards, originalCount, shardSize, pRecoveryData);
+}
+
+/* Shards first, first + 1, ... first + count - 1 in random order */
+static void ShuffleShards(uint8_t *order, int first, int count)
+{
+    int i, j;
+    for (i = 0; i < count; i++)
+        order[i] = first + i;
+    for (i = count - 1; i > 0; i--) {
+        j = rand() % (i + 1);
+        uint8_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+}
+
+/* First original that is not decoded as encoded, shardSize - 1 bytes each from pDecoded, -1 if all are */
+static int FirstDecodeError(const uint8_t *pDecoded, uint8_t **shards, int originalCount, int shardSize)
+{
+    int i;
+    for (i = 0; i < originalCount; i++) {
+        if (memcmp(pDecoded + i * (shardSize - 1), shards[i] + 1, shardSize - 1) != 0)
+            return i;
+    }
+    return -1;
+}
+
+bool EncodePlanTest(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops, int shardSize)
+{
+    int iLoop, originalCount;
+    uint8_t *shards[MAXSHARDS];
+    uint8_t *shardbuf = BeginStripeTest("LRC_EncodeWithPlan", recoveryCount, shardSize, 3 * MAXSHARDS, shards);
+    if (NULL == shardbuf)
+        return false;
+    uint8_t *recoverydata = shardbuf + MAXSHARDS * shardSize;
+    uint8_t *expected = recoverydata + MAXSHARDS * shardSize;
+    for (originalCount = minOriginalCount; originalCount <= maxOriginalCount; originalCount++) {
+        /* The plan is reused by all stripes of the geometry */
+        void *hPlan = LRC_CreateEncodePlan(originalCount);
+        for (iLoop = 0; iLoop < numLoops; iLoop++) {
+            short numRecovery = EncodeStripe(shards, originalCount, shardSize, expected);
+            if (NULL == hPlan) {
+                if (numRecovery > 0) {
+                    printf("LRC_CreateEncodePlan failed\n");
+                    return false;
+                }
+                break; // Too many shards for a stripe
+            }
+            memset(recoverydata, 0xA5, MAXSHARDS * shardSize);
+            if (LRC_EncodeWithPlan(hPlan, (const void **)shards, shardSize, recoverydata) != numRecovery ||
+                memcmp(recoverydata, expected, numRecovery * shardSize) != 0) {
+                printf("%d data shards test %d: LRC_EncodeWithPlan differs from LRC_Encode\n", originalCount, iLoop);
+                return false;
+            }
+        }
+        if (NULL == hPlan)
+            continue;
+        LRC_FreeHandle(hPlan);
+        printf("%d data shards: %d stripes encoded with plan, verify data OK\n", originalCount, numLoops);
+    }
+    free(shardbuf);
+    return true;
+}
+
+/*
+ * Decode without the lost shards, from the originals and then numRecovery recovery shards from firstRecovery on
+ * return: the last return of LRC_Decode, <0 if something wrong
+ */
+static short DecodeWithout(uint8_t **shards, int originalCount, int shardSize, uint8_t *pDecoded, const uint8_t *lost, int numLost,
+                           int firstRecovery, int numRecovery)
+{
+    int i, j;
+    short ret = 0;
+    void *handle = LRC_BeginDecode(originalCount, shardSize, pDecoded);
+    if (NULL == handle)
+        return -1;
+    for (i = 0; i < originalCount + numRecovery && 0 == ret; i++) {
+        int index = i < originalCount ? i : firstRecovery + i - originalCount;
+        for (j = 0; j < numLost && lost[j] != index; j++);
+        if (j == numLost)
+            ret = LRC_Decode(handle, shards[index]);
+    }
+    LRC_FreeHandle(handle);
+    return ret;
+}
+
+bool PaddingTest(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops, int shardSize)
+{
+    int i, j, t, iLoop, originalCount;
+    uint8_t *shards[MAXSHARDS];
+    uint8_t *shardbuf = BeginStripeTest("padding shards", recoveryCount, shardSize, 3 * MAXSHARDS + 2, shards);
+    if (NULL == shardbuf || cm256_init())
+        return false;
+    uint8_t *expected = shardbuf + MAXSHARDS * shardSize; // Also the decoded data
+    uint8_t *recoverydata = expected + MAXSHARDS * shardSize;
+    uint8_t *pZero = recoverydata + MAXSHARDS * shardSize;
+    uint8_t *rebuilddata = pZero + shardSize;
+    memset(pZero, 0, shardSize);
+    CM256Block blocks[MAXSHARDS];
+    for (originalCount = minOriginalCount; originalCount <= maxOriginalCount; originalCount++) {
+        CM256LRC paramLRC;
+        StripeParam(&paramLRC, originalCount, recoveryCount - 2, shardSize - 1); // As LRC_Initial(recoveryCount)
+        const int H = paramLRC.HorLocalCount, V = paramLRC.VerLocalCount, r = originalCount % H;
+        if (0 == r)
+            continue; // No padding
+        for (iLoop = 0; iLoop < numLoops; iLoop++) {
+            short numRecovery = EncodeStripe(shards, originalCount, shardSize, shards[originalCount]);
+            if (numRecovery <= 0)
+                break; // Too many shards for a stripe
+
+            /* cm256_encode gets no padding blocks at all, it must encode as if they were zeros */
+            for (i = 0; i < paramLRC.TotalOriginalCount; i++)
+                blocks[i].pData = i < originalCount ? shards[i] + 1 : NULL;
+            EncodeByBlocks(&paramLRC, blocks, pZero, expected);
+            if (cm256_encode(paramLRC, blocks, recoverydata) != 0 ||
+                memcmp(recoverydata, expected, paramLRC.TotalRecoveryCount * paramLRC.BlockBytes) != 0) {
+                printf("%d data shards test %d: cm256_encode without padding blocks differs from zero padding\n", originalCount, iLoop);
+                return false;
+            }
+            for (i = 0; i < numRecovery; i++) {
+                if (memcmp(shards[originalCount + i] + 1, expected + i * paramLRC.BlockBytes, paramLRC.BlockBytes) != 0) {
+                    printf("%d data shards test %d: LRC_Encode recovery shard %d differs from zero padding\n", originalCount, iLoop, i);
+                    return false;
+                }
+            }
+
+            /* Decode by the short last horizontal group, then by two short vertical groups */
+            uint8_t lost[2] = {originalCount - 1, 0};
+            if (DecodeWithout(shards, originalCount, shardSize, expected, lost, 1, originalCount, V) <= 0 ||
+                FirstDecodeError(expected, shards, originalCount, shardSize) >= 0) {
+                printf("%d data shards test %d: decode of shard %d by its horizontal group error\n", originalCount, iLoop, lost[0]);
+                return false;
+            }
+            lost[0] = (V - 2) * H + r;
+            lost[1] = lost[0] + 1;
+            if (V >= 2 && r + 2 <= H &&
+                (DecodeWithout(shards, originalCount, shardSize, expected, lost, 2, originalCount + V, H) <= 0 ||
+                 FirstDecodeError(expected, shards, originalCount, shardSize) >= 0)) {
+                printf("%d data shards test %d: decode of shards %d and %d by vertical groups error\n", originalCount, iLoop, lost[0], lost[1]);
+                return false;
+            }
+
+            /*
+             * Rebuild the shards of the last horizontal group, its recovery shard and the vertical recovery
+             * shards, with all requested shards and then without the first one requested
+             */
+            for (t = (V - 1) * H; t < originalCount + V + H; t++) {
+                if (t == originalCount)
+                    t = originalCount + V - 1;
+                for (j = 0; j < 2; j++) {
+                    void *handle = LRC_BeginRebuild(originalCount, t, shardSize, rebuilddata);
+                    if (NULL == handle) {
+                        printf("LRC_BeginRebuild failed\n");
+                        return false;
+                    }
+                    uint8_t needlist[MAXSHARDS];
+                    short n, ret = 0;
+                    bool bSkip = 1 == j;
+                    while (0 == ret && (n = LRC_NextRequestList(handle, needlist)) > 0) {
+                        for (i = 0; i < n && 0 == ret; i++) {
+                            if (bSkip)
+                                bSkip = false;
+                            else
+                                ret = LRC_OneShardForRebuild(handle, shards[needlist[i]]);
+                        }
+                    }
+                    LRC_FreeHandle(handle);
+                    if (ret <= 0 || memcmp(shards[t], rebuilddata, shardSize) != 0) {
+                        printf("%d data shards test %d: rebuild of shard %d error %d\n", originalCount, iLoop, t, ret);
+                        return false;
+                    }
+                }
+            }
+            printf("%d data shards test %d: %d padding shards, verify data OK\n", originalCount, iLoop, paramLRC.TotalOriginalCount - originalCount);
+        }
+    }
+    free(shardbuf);
+    return true;
+}
+
+bool EncodeParallelTest(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops, int shardSize)
+{
+    int j, iLoop, originalCount;
+    const short threads[] = {1, 2, 4, 7};
+    uint8_t *shards[MAXSHARDS];
+    uint8_t *shardbuf = BeginStripeTest("LRC_EncodeParallel and LRC_EncodeWithPlanParallel", recoveryCount, shardSize, 3 * MAXSHARDS, shards);
+    if (NULL == shardbuf)
+        return false;
+    uint8_t *recoverydata = shardbuf + MAXSHARDS * shardSize;
+    uint8_t *expected = recoverydata + MAXSHARDS * shardSize;
+    for (originalCount = minOriginalCount; originalCount <= maxOriginalCount; originalCount++) {
+        void *hPlan = LRC_CreateEncodePlan(originalCount);
+        for (iLoop = 0; iLoop < numLoops && NULL != hPlan; iLoop++) {
+            short numRecovery = EncodeStripe(shards, originalCount, shardSize, expected);
+
+            /* Any number of threads gives the output of LRC_Encode */
+            for (j = 0; j < (int)(sizeof(threads) / sizeof(threads[0])); j++) {
+                memset(recoverydata, 0xA5, numRecovery * shardSize);
+                if (LRC_EncodeParallel((const void **)shards, originalCount, shardSize, recoverydata, threads[j]) != numRecovery ||
+                    memcmp(recoverydata, expected, numRecovery * shardSize) != 0) {
+                    printf("%d data shards test %d: LRC_EncodeParallel with %d threads differs from LRC_Encode\n", originalCount, iLoop, threads[j]);
+                    return false;
+                }
+                memset(recoverydata, 0xA5, numRecovery * shardSize);
+                if (LRC_EncodeWithPlanParallel(hPlan, (const void **)shards, shardSize, recoverydata, threads[j]) != numRecovery ||
+                    memcmp(recoverydata, expected, numRecovery * shardSize) != 0) {
+                    printf("%d data shards test %d: LRC_EncodeWithPlanParallel with %d threads differs from LRC_Encode\n", originalCount, iLoop, threads[j]);
+                    return false;
+                }
+            }
+        }
+        if (NULL == hPlan)
+            continue; // Too many shards for a stripe
+        LRC_FreeHandle(hPlan);
+        printf("%d data shards: %d stripes encoded with 1 to %d threads, verify data OK\n", originalCount, numLoops, threads[sizeof(threads) / sizeof(threads[0]) - 1]);
+    }
+    free(shardbuf);
+    return true;
+}
+
+#define BATCH_TEST_STRIPES 5
+bool EncodeBatchTest(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops, int shardSize)
+{
+    int i, j, k, iLoop, originalCount;
+    const short threads[] = {1, 4};
+    uint8_t *shards[BATCH_TEST_STRIPES][MAXSHARDS];
+    uint8_t *shardbuf = BeginStripeTest("LRC_EncodeBatch", recoveryCount, shardSize, 3 * BATCH_TEST_STRIPES * MAXSHARDS, shards[0]);
+    if (NULL == shardbuf)
+        return false;
+    const void **stripes[BATCH_TEST_STRIPES];
+    void *recovery[BATCH_TEST_STRIPES];
+    uint8_t *expected[BATCH_TEST_STRIPES];
+    for (k = 0; k < BATCH_TEST_STRIPES; k++) {
+        for (i = 0; i < MAXSHARDS; i++)
+            shards[k][i] = shardbuf + (k * MAXSHARDS + i) * shardSize;
+        stripes[k] = (const void **)shards[k];
+        recovery[k] = shardbuf + (BATCH_TEST_STRIPES + k) * MAXSHARDS * shardSize;
+        expected[k] = shardbuf + (2 * BATCH_TEST_STRIPES + k) * MAXSHARDS * shardSize;
+    }
+    for (originalCount = minOriginalCount; originalCount <= maxOriginalCount; originalCount++) {
+        for (iLoop = 0; iLoop < numLoops; iLoop++) {
+            /* Each stripe has its own data, the batch gives the output of LRC_Encode for each one */
+            short numRecovery = 0;
+            short stripeCount = 1 + rand() % BATCH_TEST_STRIPES;
+            for (k = 0; k < stripeCount; k++)
+                numRecovery = EncodeStripe(shards[k], originalCount, shardSize, expected[k]);
+            if (numRecovery <= 0) {
+                if (LRC_EncodeBatch(stripes, stripeCount, originalCount, shardSize, recovery, 1) > 0) {
+                    printf("%d data shards: LRC_EncodeBatch encodes a stripe LRC_Encode fails with\n", originalCount);
+                    return false;
+                }
+                break; // Too many shards for a stripe
+            }
+            for (j = 0; j < (int)(sizeof(threads) / sizeof(threads[0])); j++) {
+                for (k = 0; k < stripeCount; k++)
+                    memset(recovery[k], 0xA5, numRecovery * shardSize);
+                if (LRC_EncodeBatch(stripes, stripeCount, originalCount, shardSize, recovery, threads[j]) != numRecovery) {
+                    printf("%d data shards test %d: LRC_EncodeBatch with %d threads failed\n", originalCount, iLoop, threads[j]);
+                    return false;
+                }
+                for (k = 0; k < stripeCount; k++) {
+                    if (memcmp(recovery[k], expected[k], numRecovery * shardSize) != 0) {
+                        printf("%d data shards test %d: stripe %d of LRC_EncodeBatch with %d threads differs from LRC_Encode\n", originalCount, iLoop, k, threads[j]);
+                        return false;
+                    }
+                }
+            }
+            printf("%d data shards test %d: %d stripes, verify data OK\n", originalCount, iLoop, stripeCount);
+        }
+    }
+    free(shardbuf);
+    return true;
+}
+
+bool IncrementalEncodeTest(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops, int shardSize)
+{
+    int i, j, iLoop, originalCount;
+    uint8_t *shards[MAXSHARDS];
+    uint8_t *shardbuf = BeginStripeTest("LRC_BeginEncode and LRC_OneShardForEncode", recoveryCount, shardSize, 3 * MAXSHARDS + 1, shards);
+    if (NULL == shardbuf)
+        return false;
+    uint8_t *copy = shardbuf + MAXSHARDS * shardSize;
+    uint8_t *recoverydata = copy + shardSize;
+    uint8_t *expected = recoverydata + MAXSHARDS * shardSize;
+    for (originalCount = minOriginalCount; originalCount <= maxOriginalCount; originalCount++) {
+        for (iLoop = 0; iLoop < numLoops; iLoop++) {
+            short numRecovery = EncodeStripe(shards, originalCount, shardSize, expected);
+            memset(recoverydata, 0xA5, MAXSHARDS * shardSize);
+            void *handle = LRC_BeginEncode(originalCount, shardSize, recoverydata);
+            if (NULL == handle) {
+                if (numRecovery > 0) {
+                    printf("LRC_BeginEncode failed\n");
+                    return false;
+                }
+                break; // Too many shards for a stripe
+            }
+
+            /* Shards arrive in random order, one of them twice, each in a buffer scrambled right after */
+            uint8_t order[MAXSHARDS + 1];
+            ShuffleShards(order, 0, originalCount);
+            j = rand() % originalCount;
+            memmove(order + j + 1, order + j, originalCount - j);
+            order[j] = order[rand() % (j + 1)];
+            bool bGiven[MAXSHARDS] = {false};
+            short ret, numGiven = 0;
+            for (i = 0; i <= originalCount; i++) {
+                if (!bGiven[order[i]]) {
+                    bGiven[order[i]] = true;
+                    numGiven++;
+                }
+                memcpy(copy, shards[order[i]], shardSize);
+                ret = LRC_OneShardForEncode(handle, copy);
+                memset(copy + 1, 0x5A, shardSize - 1);
+                if (ret != (numGiven < originalCount ? 0 : numRecovery)) {
+                    printf("%d data shards test %d: LRC_OneShardForEncode returns %d for shard %d\n", originalCount, iLoop, ret, i);
+                    return false;
+                }
+            }
+            LRC_FreeHandle(handle);
+            if (memcmp(recoverydata, expected, numRecovery * shardSize) != 0) {
+                printf("%d data shards test %d: incremental encode differs from LRC_Encode\n", originalCount, iLoop);
+                return false;
+            }
+            printf("%d data shards test %d: shard %d given twice, verify data OK\n", originalCount, iLoop, order[j]);
+        }
+    }
+    free(shardbuf);
+    return true;
+}
+
+bool UpdateParityTest(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops, int shardSize)
+{
+    int i, j, k, iLoop, originalCount;
+    uint8_t *shards[MAXSHARDS];
+    uint8_t *shardbuf = BeginStripeTest("LRC_UpdateParity", recoveryCount, shardSize, 3 * MAXSHARDS + 1, shards);
+    if (NULL == shardbuf)
+        return false;
+    uint8_t *newShard = shardbuf + MAXSHARDS * shardSize;
+    uint8_t *recoverydata = newShard + shardSize;
+    uint8_t *expected = recoverydata + MAXSHARDS * shardSize;
+    for (originalCount = minOriginalCount; originalCount <= maxOriginalCount; originalCount++) {
+        for (iLoop = 0; iLoop < numLoops; iLoop++) {
+            short numRecovery = EncodeStripe(shards, originalCount, shardSize, recoverydata);
+            if (numRecovery <= 0)
+                break; // Too many shards for a stripe
+
+            /* Rewrite random shards one after another, the same one now and then */
+            short numUpdates = 1 + rand() % 8;
+            for (k = 0; k < numUpdates; k++) {
+                i = rand() % originalCount;
+                newShard[0] = i;
+                for (j = 1; j < shardSize; j++)
+                    newShard[j] = rand();
+                if (LRC_UpdateParity(originalCount, shardSize, shards[i], newShard, recoverydata) != numRecovery) {
+                    printf("%d data shards test %d: LRC_UpdateParity of shard %d failed\n", originalCount, iLoop, i);
+                    return false;
+                }
+                memcpy(shards[i], newShard, shardSize);
+            }
+            LRC_Encode((const void **)shards, originalCount, shardSize, expected);
+            if (memcmp(recoverydata, expected, numRecovery * shardSize) != 0) {
+                printf("%d data shards test %d: updated recovery shards differ from LRC_Encode\n", originalCount, iLoop);
+                return false;
+            }
+            printf("%d data shards test %d: %d updates, verify data OK\n", originalCount, iLoop, numUpdates);
+        }
+    }
+    free(shardbuf);
+    return true;
+}
+
+/*
+ * Blocks of one erasure pattern for cm256 decode: received originals in place, each erased one replaced by
+ * a fresh copy of a global recovery block
+ */
+static void PrepareErasures(CM256Block *blocks, uint8_t **originals, int originalCount, uint8_t **recovery, uint8_t *work, int blockBytes,
+                            const uint8_t *erasures, const uint8_t *rows, int numErasures)
+{
+    int i;
+    for (i = 0; i < originalCount; i++) {
+        blocks[i].pData = originals[i];
+        blocks[i].lrcIndex = blocks[i].decodeIndex = i;
+    }
+    for (i = 0; i < numErasures; i++) {
+        memcpy(work + i * blockBytes, recovery[rows[i]], blockBytes);
+        blocks[erasures[i]].pData = work + i * blockBytes;
+        blocks[erasures[i]].lrcIndex = blocks[erasures[i]].decodeIndex = originalCount + 2 + rows[i];
+    }
+}
+
+static bool VerifyErasures(const CM256Block *blocks, uint8_t **originals, int originalCount, int blockBytes)
+{
+    int i;
+    for (i = 0; i < originalCount; i++) {
+        if (blocks[i].lrcIndex >= originalCount || memcmp(blocks[i].pData, originals[blocks[i].lrcIndex], blockBytes) != 0)
+            return false;
+    }
+    return true;
+}
+
+bool DecodePathTest(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops, int shardSize)
+{
+    int i, j, iLoop, originalCount;
+    const int tileBytes = CM256_DECODE_TILE_BYTES > 0 ? CM256_DECODE_TILE_BYTES : shardSize;
+    /* Each stripe has blocks of one of these sizes, a shard or across the tiles of the LU decode with a short last one */
+    const int sizes[4] = {shardSize - 1, tileBytes + 1, 2 * tileBytes - 1, 1};
+    const int maxBytes = shardSize - 1 > 2 * tileBytes - 1 ? shardSize - 1 : 2 * tileBytes - 1;
+    printf("----- Start test cm256 decode paths with shardSize=%d and tileBytes=%d -------------\n", shardSize, tileBytes);
+    if (cm256_init() || recoveryCount <= 0 || recoveryCount > 64)
+        return false;
+    uint8_t * databuf = malloc((MAXSHARDS + 2 * 64) * maxBytes);
+    if (NULL == databuf)
+        return false;
+    uint8_t *originals[MAXSHARDS], *recovery[64];
+    CM256Block blocks[MAXSHARDS];
+    CM256Decoder state;
+    for (originalCount = minOriginalCount < 2 ? 2 : minOriginalCount; originalCount <= maxOriginalCount && originalCount + recoveryCount + 2 <= MAXSHARDS; originalCount++) {
+        const int blockBytes = sizes[originalCount % 4];
+        uint8_t *work = databuf + (MAXSHARDS + 64) * blockBytes;
+        for (i = 0; i < MAXSHARDS; i++)
+            originals[i] = databuf + i * blockBytes;
+        for (i = 0; i < recoveryCount; i++)
+            recovery[i] = databuf + (MAXSHARDS + i) * blockBytes;
+
+        /* Global recovery blocks of the originals */
+        cm256_encoder_params params;
+        params.TotalOriginalCount = params.OriginalCount = originalCount;
+        params.FirstElement = 0;
+        params.Step = 1;
+        params.BlockBytes = blockBytes;
+        for (i = 0; i < originalCount; i++) {
+            blocks[i].pData = originals[i];
+            for (j = 0; j < blockBytes; j++)
+                originals[i][j] = rand();
+        }
+        for (i = 0; i < recoveryCount; i++)
+            CM256EncodeBlock(params, blocks, originalCount + 2 + i, recovery[i]);
+
+        for (iLoop = 0; iLoop < numLoops; iLoop++) {
+            /* Random erasures, each replaced by a random recovery block */
+            uint8_t erasures[64], rows[64];
+            bool bUsed[MAXSHARDS] = {false};
+            int numErasures = 1 + rand() % (originalCount < recoveryCount ? originalCount : recoveryCount);
+            for (i = 0; i < numErasures; ) {
+                erasures[i] = rand() % originalCount;
+                if (!bUsed[erasures[i]])
+                    bUsed[erasures[i]] = true, i++;
+            }
+            memset(bUsed, 0, sizeof(bUsed));
+            for (i = 0; i < numErasures; ) {
+                rows[i] = rand() % recoveryCount;
+                if (!bUsed[rows[i]])
+                    bUsed[rows[i]] = true, i++;
+            }
+            params.RecoveryCount = numErasures;
+
+            /* Elimination by LU, one tile at a time */
+            PrepareErasures(blocks, originals, originalCount, recovery, work, blockBytes, erasures, rows, numErasures);
+            if (!DecoderInitialize(&state, &params, blocks)) {
+                printf("DecoderInitialize failed\n");
+                return false;
+            }
+            if (Decode(&state) != 0 || !VerifyErasures(blocks, originals, originalCount, blockBytes)) {
+                printf("%d originals test %d: LU decode of %d erasures error\n", originalCount, iLoop, numErasures);
+                return false;
+            }
+
+            /* Explicit inverse */
+            PrepareErasures(blocks, originals, originalCount, recovery, work, blockBytes, erasures, rows, numErasures);
+            if (!DecoderInitialize(&state, &params, blocks) || !DecodeInverse(&state) ||
+                !VerifyErasures(blocks, originals, originalCount, blockBytes)) {
+                printf("%d originals test %d: inverse decode of %d erasures error\n", originalCount, iLoop, numErasures);
+                return false;
+            }
+
+            /* The same erasures with two received originals swapped in the blocks, the cached matrices do not fit them */
+            int a, b;
+            for (a = 0; a < originalCount && blocks[a].lrcIndex >= originalCount; a++);
+            for (b = originalCount - 1; b > a && blocks[b].lrcIndex >= originalCount; b--);
+            if (b > a) {
+                for (j = 0; j < 2; j++) {
+                    PrepareErasures(blocks, originals, originalCount, recovery, work, blockBytes, erasures, rows, numErasures);
+                    CM256Block t = blocks[a];
+                    blocks[a] = blocks[b];
+                    blocks[b] = t;
+                    if (!DecoderInitialize(&state, &params, blocks)) {
+                        printf("DecoderInitialize failed\n");
+                        return false;
+                    }
+                    if (0 == j ? Decode(&state) != 0 : !DecodeInverse(&state)) {
+                        printf("%d originals test %d: %s decode of swapped blocks failed\n", originalCount, iLoop, 0 == j ? "LU" : "inverse");
+                        return false;
+                    }
+                    if (!VerifyErasures(blocks, originals, originalCount, blockBytes)) {
+                        printf("%d originals test %d: %s decode of %d erasures with blocks %d and %d swapped error\n", originalCount, iLoop, 0 == j ? "LU" : "inverse", numErasures, a, b);
+                        return false;
+                    }
+                }
+            }
+
+            /* Whichever cm256_decode picks, without the cache and with it on several threads */
+            LRC_SetDecodeCacheSize(0);
+            PrepareErasures(blocks, originals, originalCount, recovery, work, blockBytes, erasures, rows, numErasures);
+            if (cm256_decode(params, blocks) != 0 || !VerifyErasures(blocks, originals, originalCount, blockBytes)) {
+                printf("%d originals test %d: cm256_decode of %d erasures without cache error\n", originalCount, iLoop, numErasures);
+                return false;
+            }
+            LRC_SetDecodeCacheSize(CM256_DEFAULT_CACHE_ENTRIES);
+            for (j = 0; j < 2; j++) {
+                PrepareErasures(blocks, originals, originalCount, recovery, work, blockBytes, erasures, rows, numErasures);
+                if (cm256_decode_parallel(params, blocks, 1 + j * 3) != 0 || !VerifyErasures(blocks, originals, originalCount, blockBytes)) {
+                    printf("%d originals test %d: cm256_decode_parallel of %d erasures on %d threads error\n", originalCount, iLoop, numErasures, 1 + j * 3);
+                    return false;
+                }
+            }
+            printf("%d originals test %d: %d erasures of %d bytes, verify data OK\n", originalCount, iLoop, numErasures, blockBytes);
+        }
+
+        /* A cache of two matrices: the second decode of a pattern hits, the third pattern evicts the first */
+        uint8_t erasures[2] = {0, 1}, rows[3][2] = {{0, 1}, {1, 0}, {0, 2}};
+        unsigned long hits, misses, hits2, misses2;
+        short entries;
+        if (recoveryCount < 3)
+            continue;
+        params.RecoveryCount = 2;
+        LRC_SetDecodeCacheSize(2);
+        LRC_GetDecodeCacheStats(&hits, &misses, &entries);
+        for (j = 0; j < 4; j++) {
+            i = j < 3 ? j : 0;
+            PrepareErasures(blocks, originals, originalCount, recovery, work, blockBytes, erasures, rows[i], 2);
+            if (cm256_decode(params, blocks) != 0 || !VerifyErasures(blocks, originals, originalCount, blockBytes)) {
+                printf("%d originals: cm256_decode with cache of 2 error\n", originalCount);
+                return false;
+            }
+            PrepareErasures(blocks, originals, originalCount, recovery, work, blockBytes, erasures, rows[i], 2);
+            if (cm256_decode(params, blocks) != 0 || !VerifyErasures(blocks, originals, originalCount, blockBytes)) {
+                printf("%d originals: cm256_decode from cache error\n", originalCount);
+                return false;
+            }
+        }
+        LRC_GetDecodeCacheStats(&hits2, &misses2, &entries);
+        LRC_SetDecodeCacheSize(CM256_DEFAULT_CACHE_ENTRIES);
+        if (hits2 - hits != 4 || misses2 - misses != 4 || entries != 2) {
+            printf("%d originals: cache of 2 has %lu hits, %lu misses and %d entries, expected 4, 4 and 2\n", originalCount, hits2 - hits, misses2 - misses, entries);
+            return false;
+        }
+    }
+    free(databuf);
+    return true;
+}
+
+bool DecodeWantedTest(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops, int shardSize)
+{
+    int i, j, iLoop, originalCount;
+    uint8_t *shards[MAXSHARDS];
+    uint8_t *shardbuf = BeginStripeTest("LRC_SetDecodeWanted", recoveryCount, shardSize, 2 * MAXSHARDS, shards);
+    if (NULL == shardbuf)
+        return false;
+    uint8_t *decodedata = shardbuf + MAXSHARDS * shardSize;
+    for (originalCount = minOriginalCount; originalCount <= maxOriginalCount; originalCount++) {
+        for (iLoop = 0; iLoop < numLoops; iLoop++) {
+            short numRecovery = EncodeStripe(shards, originalCount, shardSize, shards[originalCount]);
+
+            /* A few wanted originals, shards arrive in random order */
+            uint8_t wanted[8];
+            short numWanted = 1 + rand() % (originalCount < 8 ? originalCount : 8);
+            for (i = 0; i < numWanted; i++)
+                wanted[i] = rand() % originalCount;
+            uint8_t order[MAXSHARDS];
+            ShuffleShards(order, 0, originalCount + numRecovery);
+            void *handle = LRC_BeginDecode(originalCount, shardSize, decodedata);
+            if (NULL == handle || LRC_SetDecodeWanted(handle, wanted, numWanted) != 0) {
+                printf("LRC_SetDecodeWanted failed\n");
+                return false;
+            }
+            short ret = 0;
+            for (i = 0; i < originalCount + numRecovery && 0 == ret; i++)
+                ret = LRC_Decode(handle, shards[order[i]]);
+            if (ret <= 0) {
+                printf("%d data shards test %d: decode error %d after %d shards\n", originalCount, iLoop, ret, i);
+                return false;
+            }
+            for (j = 0; j < numWanted; j++) {
+                const uint8_t *pShard = LRC_GetDecodedShard(handle, wanted[j]);
+                if (memcmp(decodedata + wanted[j] * (shardSize - 1), shards[wanted[j]] + 1, shardSize - 1) != 0 ||
+                    NULL == pShard || memcmp(pShard, shards[wanted[j]] + 1, shardSize - 1) != 0) {
+                    printf("Decoded data error of wanted shard %d\n", wanted[j]);
+                    return false;
+                }
+            }
+            LRC_FreeHandle(handle);
+            printf("%d data shards test %d: %d wanted, %d shards collected, verify data OK\n", originalCount, iLoop, numWanted, i);
+        }
+    }
+    free(shardbuf);
+    return true;
+}
+
+bool RangeTest(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops, int shardSize)
+{
+    int i, iLoop, originalCount;
+    uint8_t *shards[MAXSHARDS], *fragments[MAXSHARDS];
+    uint8_t *shardbuf = BeginStripeTest("LRC_BeginDecodeRange and LRC_BeginRebuildRange", recoveryCount, shardSize, 3 * MAXSHARDS, shards);
+    if (NULL == shardbuf)
+        return false;
+    uint8_t *decodedata = shardbuf + 2 * MAXSHARDS * shardSize;
+    for (i = 0; i < MAXSHARDS; i++)
+        fragments[i] = shardbuf + (MAXSHARDS + i) * shardSize;
+    for (originalCount = minOriginalCount; originalCount <= maxOriginalCount; originalCount++) {
+        for (iLoop = 0; iLoop < numLoops; iLoop++) {
+            short numRecovery = EncodeStripe(shards, originalCount, shardSize, shards[originalCount]);
+
+            /* Fragments are the index byte and the range of shard data */
+            unsigned long offset = rand() % (shardSize - 1);
+            unsigned long length = 1 + rand() % (shardSize - 1 - offset);
+            for (i = 0; i < originalCount + numRecovery; i++) {
+                fragments[i][0] = shards[i][0];
+                memcpy(fragments[i] + 1, shards[i] + 1 + offset, length);
+            }
+
+            /* Decode the range from fragments in random order */
+            uint8_t order[MAXSHARDS];
+            ShuffleShards(order, 0, originalCount + numRecovery);
+            void *handle = LRC_BeginDecodeRange(originalCount, shardSize, offset, length, decodedata);
+            if (NULL == handle) {
+                printf("LRC_BeginDecodeRange failed\n");
+                return false;
+            }
+            short ret = 0;
+            for (i = 0; i < originalCount + numRecovery && 0 == ret; i++)
+                ret = LRC_Decode(handle, fragments[order[i]]);
+            LRC_FreeHandle(handle);
+            if (ret <= 0) {
+                printf("%d data shards test %d: range decode error %d\n", originalCount, iLoop, ret);
+                return false;
+            }
+            for (i = 0; i < originalCount; i++) {
+                if (memcmp(decodedata + i * length, fragments[i] + 1, length) != 0) {
+                    printf("Range decode data error of shard %d, offset %lu, length %lu\n", i, offset, length);
+                    return false;
+                }
+            }
+
+            /* Rebuild the range of a lost shard, a few requested fragments do not come */
+            short iLost = rand() % (originalCount + numRecovery);
+            handle = LRC_BeginRebuildRange(originalCount, iLost, shardSize, offset, length, decodedata);
+            if (NULL == handle) {
+                printf("LRC_BeginRebuildRange failed\n");
+                return false;
+            }
+            uint8_t needlist[256];
+            short n;
+            ret = 0;
+            while ( ret <= 0 && (n = LRC_NextRequestList(handle, needlist)) > 0 ) {
+                for (i = 0; i < n && ret <= 0; i++) {
+                    if (n < originalCount && rand() % 10 == 0)
+                        continue;
+                    ret = LRC_OneShardForRebuild(handle, fragments[needlist[i]]);
+                    if (ret < 0) {
+                        printf("add fragment %d to rebuilder error %d\n", needlist[i], ret);
+                        return false;
+                    }
+                }
+            }
+            LRC_FreeHandle(handle);
+            if (ret <= 0) {
+                printf("%d data shards test %d: Lost shard %d, not enough fragments to rebuild\n", originalCount, iLoop, iLost);
+                return false;
+            }
+            if (memcmp(decodedata, fragments[iLost], length + 1) != 0) {
+                printf("Range rebuild data error of shard %d, offset %lu, length %lu\n", iLost, offset, length);
+                return false;
+            }
+            printf("%d data shards test %d: offset %lu, length %lu, lost shard %d, verify data OK\n", originalCount, iLoop, offset, length, iLost);
+        }
+    }
+    free(shardbuf);
+    return true;
+}
+
+bool DecodeOutputsTest(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops, int shardSize)
+{
+    int i, iLoop, originalCount;
+    uint8_t *shards[MAXSHARDS];
+    void *outputs[MAXSHARDS];
+    uint8_t *shardbuf = BeginStripeTest("LRC_SetDecodeOutputs and LRC_SetDecodeBorrow", recoveryCount, shardSize, 3 * MAXSHARDS, shards);
+    if (NULL == shardbuf)
+        return false;
+    uint8_t *decodedata = shardbuf + MAXSHARDS * shardSize;
+    for (i = 0; i < MAXSHARDS; i++)
+        outputs[i] = decodedata + (MAXSHARDS + i) * shardSize;
+    for (originalCount = minOriginalCount; originalCount <= maxOriginalCount; originalCount++) {
+        for (iLoop = 0; iLoop < numLoops; iLoop++) {
+            short numRecovery = EncodeStripe(shards, originalCount, shardSize, shards[originalCount]);
+
+            /* Separate outputs, borrowed originals, or both */
+            bool bOutputs = iLoop % 3 != 1;
+            bool bBorrow = iLoop % 3 != 0;
+            void *handle = LRC_BeginDecode(originalCount, shardSize, decodedata);
+            if (NULL == handle || (bOutputs && LRC_SetDecodeOutputs(handle, outputs) != 0) || (bBorrow && LRC_SetDecodeBorrow(handle) != 0)) {
+                printf("LRC_SetDecodeOutputs or LRC_SetDecodeBorrow failed\n");
+                return false;
+            }
+            uint8_t order[MAXSHARDS];
+            bool bGiven[MAXSHARDS] = {false};
+            ShuffleShards(order, 0, originalCount + numRecovery);
+            short ret = 0;
+            for (i = 0; i < originalCount + numRecovery && 0 == ret; i++) {
+                bGiven[order[i]] = true;
+                ret = LRC_Decode(handle, shards[order[i]]);
+            }
+            if (ret <= 0) {
+                printf("%d data shards test %d: decode error %d\n", originalCount, iLoop, ret);
+                return false;
+            }
+
+            /* Borrowed originals stay where they were given, the others are written to their outputs */
+            for (i = 0; i < originalCount; i++) {
+                const uint8_t *pShard = LRC_GetDecodedShard(handle, i);
+                const uint8_t *pOutput = bOutputs ? outputs[i] : decodedata + i * (shardSize - 1);
+                if (NULL == pShard || memcmp(pShard, shards[i] + 1, shardSize - 1) != 0 ||
+                    (!(bBorrow && bGiven[i]) && memcmp(pOutput, shards[i] + 1, shardSize - 1) != 0)) {
+                    printf("Decoded data error of shard %d, outputs %d, borrow %d\n", i, bOutputs, bBorrow);
+                    return false;
+                }
+            }
+            LRC_FreeHandle(handle);
+            printf("%d data shards test %d: outputs %d, borrow %d, verify data OK\n", originalCount, iLoop, bOutputs, bBorrow);
+        }
+    }
+    free(shardbuf);
+    return true;
+}
+
+bool ProgressiveDecodeTest(int minOriginalCount, int maxOriginalCount, int recoveryCount, int numLoops, int shardSize)
+{
+    int i, iLoop, originalCount;
+    uint8_t *shards[MAXSHARDS];
+    uint8_t *shardbuf = BeginStripeTest("LRC_SetDecodeProgressive", recoveryCount, shardSize, 2 * MAXSHARDS, shards);
+    if (NULL == shardbuf)
+        return false;
+    uint8_t *decodedata = shardbuf + MAXSHARDS * shardSize;
+    for (originalCount = minOriginalCount; originalCount <= maxOriginalCount; originalCount++) {
+        for (iLoop = 0; iLoop < numLoops; iLoop++) {
+            short numRecovery = EncodeStripe(shards, originalCount, shardSize, shards[originalCount]);
+
+            /* Originals first with a few of them lost and recovery shards last, or all in random order */
+            uint8_t order[MAXSHARDS];
+            int numLost = iLoop % 2 ? 0 : rand() % (recoveryCount - 1);
+            if (iLoop % 2)
+                ShuffleShards(order, 0, originalCount + numRecovery);
+            else {
+                ShuffleShards(order, 0, originalCount);
+                ShuffleShards(order + originalCount, originalCount, numRecovery);
+            }
+            short numRows = rand() % (recoveryCount + 1);
+            void *handle = LRC_BeginDecode(originalCount, shardSize, decodedata);
+            if (NULL == handle || LRC_SetDecodeProgressive(handle, numRows) != 0) {
+                printf("LRC_SetDecodeProgressive failed\n");
+                return false;
+            }
+            short ret = 0;
+            for (i = 0; i < originalCount + numRecovery && 0 == ret; i++) {
+                if (i < originalCount && i >= originalCount - numLost)
+                    continue; // The last originals are lost
+                ret = LRC_Decode(handle, shards[order[i]]);
+            }
+            LRC_FreeHandle(handle);
+            if (ret <= 0) {
+                printf("%d data shards test %d: decode error %d, %d lost\n", originalCount, iLoop, ret, numLost);
+                return false;
+            }
+            i = FirstDecodeError(decodedata, shards, originalCount, shardSize);
+            if (i >= 0) {
+                printf("Decoded data error of shard %d, %d rows folded ahead\n", i, numRows);
+                return false;
+            }
+            printf("%d data shards test %d: %d rows folded ahead, %d lost, verify data OK\n", originalCount, iLoop, numRows, numLost);
+        }
+    }
+    free(shardbuf);
+    return true;
+}
+
+int main(int argc, const char *argv[])
+{
+    bool bTest[36] = {false};
+    int minOriginalCount = 128;
+    int maxOriginalCount = 128;
+    int recoveryCount = 12;
+    int numLoops = 20;
+    int shardSize = 16 * 1024;
+    argc -= 3;
+    if (argc > 1) {
+        /* One character for each test, 0-9 and then a-z for tests 10-35 */
+        const char *pTest;
+        for (pTest = argv[1]; *pTest; pTest++) {
+            if (*pTest >= '0' && *pTest <= '9')
+                bTest[*pTest - '0'] = true;
+            else if (*pTest >= 'a' && *pTest <= 'z')
+                bTest[*pTest - 'a' + 10] = true;
+        }
+    }
+    if (argc > 2)
+        sscanf(argv[2], "%d", &minOriginalCount);
+    if (argc > 3)
+        sscanf(argv[3], "%d", &maxOriginalCount);
+    if (argc > 4)
+        sscanf(argv[4], "%d", &recoveryCount);
+    if (argc > 5)
+        sscanf(argv[5], "%d", &numLoops);
+    if (argc > 6)
+        sscanf(argv[6], "%d", &shardSize);
+
+    if ( bTest[0] ) {
+       if (!ExampleFileUsage())
+            return(1);
+        if (!CheckMemSwap())
+           return(4);
+        if (!FinerPerfTimingTest())
+            return(2);
+    }
+    if ( bTest[1] ) {
+        if ( !BulkPerfTesting(minOriginalCount, maxOriginalCount, recoveryCount, recoveryCount+2) )
+            return 3;
+    }
+    if ( bTest[2] ) {
+        if (!LRCTesting(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(4);
+    }
+    if ( bTest[3] ) {
+        if (!RebuildTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(4);
+    }
+    if ( bTest[4] ) {
+        if (!KernelMatchTest() || !KernelPerfTesting(numLoops * 1000, shardSize))
+            return(5);
+    }
+    if ( bTest[5] ) {
+        if (!EncodeRangeTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops))
+            return(6);
+    }
+    if ( bTest[6] ) {
+        if (!EncodePlanTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(7);
+    }
+    if ( bTest[7] ) {
+        if (!PaddingTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(8);
+    }
+    if ( bTest[8] ) {
+        if (!EncodeParallelTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(9);
+    }
+    if ( bTest[9] ) {
+        if (!EncodeBatchTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(10);
+    }
+    if ( bTest[10] ) {
+        if (!IncrementalEncodeTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(11);
+    }
+    if ( bTest[11] ) {
+        if (!UpdateParityTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(12);
+    }
+    if ( bTest[12] ) {
+        if (!DecodePathTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(13);
+    }
+    if ( bTest[13] ) {
+        if (!DecodeWantedTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(14);
+    }
+    if ( bTest[14] ) {
+        if (!RangeTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(15);
+    }
+    if ( bTest[15] ) {
+        if (!DecodeOutputsTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(16);
+    }
+    if ( bTest[16] ) {
+        if (!ProgressiveDecodeTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(17);
+    }
+    if ( bTest[17] ) {
+        if (!IngestPerfTesting(minOriginalCount, maxOriginalCount, recoveryCount, numLoops))
+            return(18);
+    }
+    if ( bTest[18] ) {
+        if (!MultiRebuildTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(19);
+    }
+    if ( bTest[19] ) {
+        if (!CostRebuildTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(20);
+    }
+    if ( bTest[20] ) {
+        if (!HedgedRebuildTest(minOriginalCount, maxOriginalCount, recoveryCount, numLoops, shardSize))
+            return(21);
     }
 
     return 0;